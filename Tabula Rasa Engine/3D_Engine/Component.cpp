@@ -1,4 +1,5 @@
 #include "Component.h"
+#include "trSceneSnapshot.h"
 #include "trApp.h"
 #include <algorithm>
 
@@ -39,9 +40,8 @@ bool Component::Disable()
 	return true;
 }
 
-bool Component::Save(JSON_Object* component_obj) const
+void Component::Capture(trSnapshotRecord& record) const
 {
-	return true;
 }
 
 bool Component::Load(const JSON_Object * component_obj)
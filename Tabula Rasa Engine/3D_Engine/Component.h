@@ -6,6 +6,10 @@
 
 class GameObject;
 class Resource;
+class trSnapshotRecord;
+
+// Bit of a component type in GameObject signatures
+#define COMPONENT_BIT(type) (1u << (uint)(type))
 
 
 class Component
@@ -20,7 +24,9 @@ public:
 		COMPONENT_MATERIAL,
 		COMPONENT_CAMERA,
 		COMPONENT_BONE,
-		COMPONENT_ANIMATION
+		COMPONENT_ANIMATION,
+
+		COMPONENT_TYPE_COUNT
 	};
 
 public:
@@ -34,7 +40,8 @@ public:
 	virtual bool Update(float dt);
 	virtual bool Disable();
 
-	virtual bool Save(JSON_Object* component_obj)const;
+	// Everything Save writes, as plain data. The snapshot builds the JSON from it.
+	virtual void Capture(trSnapshotRecord& record)const;
 	virtual bool Load(const JSON_Object* component_obj);
 
 	UID GetUUID()const;
@@ -1,4 +1,5 @@
 #include "ComponentAnimation.h"
+#include "trSceneSnapshot.h"
 
 #include "ComponentMesh.h"
 #include "trApp.h"
@@ -13,6 +14,8 @@
 #include "AnimationImporter.h"
 #include "trAnimation.h"
 
+TR_POOLED_CLASS_IMPL(ComponentAnimation)
+
 ComponentAnimation::ComponentAnimation(GameObject * embedded_game_object) :
 	Component(embedded_game_object, Component::component_type::COMPONENT_ANIMATION)
 {
@@ -31,13 +34,11 @@ ComponentAnimation::~ComponentAnimation()
 		//res->Release();
 }
 
-bool ComponentAnimation::Save(JSON_Object* component_obj) const
+void ComponentAnimation::Capture(trSnapshotRecord& record) const
 {
-	//todo: get resource path etc
 	const Resource* res = this->GetResource();
-	if(res)
-		json_object_set_string(component_obj, "path", res->GetExportedFile());
-	return true;
+	if (res)
+		record.AddString("path", res->GetExportedFile());
 }
 
 bool ComponentAnimation::Load(const JSON_Object * component_obj)
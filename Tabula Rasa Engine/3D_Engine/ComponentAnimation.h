@@ -2,17 +2,19 @@
 #define __COMPONENT_ANIMATION_H__
 
 #include "Component.h"
+#include "trPool.h"
 
 
 class ComponentAnimation : public Component
 {
+	TR_POOLED_CLASS(ComponentAnimation)
 public:
 
 	ComponentAnimation(GameObject* embedded_game_object);
 	ComponentAnimation(GameObject* embedded_game_object, UID resource);
 	~ComponentAnimation();
 
-	bool Save(JSON_Object* component_obj)const;
+	void Capture(trSnapshotRecord& record)const;
 	bool Load(const JSON_Object* component_obj);
 
 	bool SetResource(UID resource);
@@ -1,4 +1,5 @@
 #include "ComponentBone.h"
+#include "trSceneSnapshot.h"
 
 #include "ComponentMesh.h"
 #include "trApp.h"
@@ -12,6 +13,8 @@
 #include "ResourceBone.h"
 #include "BoneImporter.h"
 
+TR_POOLED_CLASS_IMPL(ComponentBone)
+
 ComponentBone::ComponentBone(GameObject * embedded_game_object) :
 	Component(embedded_game_object, Component::component_type::COMPONENT_BONE)
 {
@@ -30,13 +33,11 @@ ComponentBone::~ComponentBone()
 		res->Release();
 }
 
-bool ComponentBone::Save(JSON_Object* component_obj) const
+void ComponentBone::Capture(trSnapshotRecord& record) const
 {
-	//todo: get resource path etc
 	const Resource* res = this->GetResource();
-	if(res)
-		json_object_set_string(component_obj, "path", res->GetExportedFile());
-	return true;
+	if (res)
+		record.AddString("path", res->GetExportedFile());
 }
 
 bool ComponentBone::Load(const JSON_Object * component_obj)
@@ -2,18 +2,20 @@
 #define __COMPONENT_BONE_H__
 
 #include "Component.h"
+#include "trPool.h"
 
 class ComponentMesh;
 
 class ComponentBone : public Component
 {
+	TR_POOLED_CLASS(ComponentBone)
 public:
 
 	ComponentBone(GameObject* embedded_game_object);
 	ComponentBone(GameObject* embedded_game_object, UID resource);
 	~ComponentBone();
 
-	bool Save(JSON_Object* component_obj)const;
+	void Capture(trSnapshotRecord& record)const;
 	bool Load(const JSON_Object* component_obj);
 
 	bool SetResource(UID resource);
@@ -1,12 +1,16 @@
 #include "ComponentCamera.h"
+#include "trSceneSnapshot.h"
 #include "MathGeoLib/Geometry/Frustum.h"
 
 #include "GameObject.h"
+#include "Quadtree.h"
 
 #include "trApp.h"
 #include "trEditor.h"
 #include "trWindow.h"
 
+TR_POOLED_CLASS_IMPL(ComponentCamera)
+
 #define ASPECT_RATIO 1.3f
 
 ComponentCamera::ComponentCamera(GameObject * embedded_game_object):
@@ -33,22 +37,14 @@ ComponentCamera::~ComponentCamera()
 {
 }
 
-bool ComponentCamera::Save(JSON_Object* component_obj) const
+void ComponentCamera::Capture(trSnapshotRecord& record) const
 {
-	JSON_Value* component_value = json_value_init_array();
-	JSON_Array* translation_array = json_value_get_array(component_value);
-	json_object_set_value(component_obj, "F_Position", component_value);
-	json_array_append_number(translation_array, frustum.pos.x);
-	json_array_append_number(translation_array, frustum.pos.y);
-	json_array_append_number(translation_array, frustum.pos.z);
-
-	json_object_set_boolean(component_obj, "F_Culling", frustum_culling);
-	json_object_set_number(component_obj, "F_Near", frustum.nearPlaneDistance);
-	json_object_set_number(component_obj, "F_Far", frustum.farPlaneDistance);
-	json_object_set_number(component_obj, "F_HorizontalFov", frustum.horizontalFov);
-	json_object_set_number(component_obj, "F_VerticalFov", frustum.verticalFov);
-
-	return true;
+	record.AddArray("F_Position", frustum.pos.ptr(), 3u);
+	record.AddBool("F_Culling", frustum_culling);
+	record.AddNumber("F_Near", frustum.nearPlaneDistance);
+	record.AddNumber("F_Far", frustum.farPlaneDistance);
+	record.AddNumber("F_HorizontalFov", frustum.horizontalFov);
+	record.AddNumber("F_VerticalFov", frustum.verticalFov);
 }
 
 bool ComponentCamera::Load(const JSON_Object * component_obj)
@@ -117,31 +113,11 @@ void ComponentCamera::SetUpFov(float new_v_fov)
 
 bool ComponentCamera::FrustumContainsAaBox(const AABB & ref_box)
 {
-	float3 aabb_corners[8];
-	int total_in = 0;
-	ref_box.GetCornerPoints(aabb_corners);
-
-	for (int p = 0; p < 6; ++p) { // Planes of the frustum
-		int corners_outside = 8;
-		int point_in = 1;
-		
-		for (int i = 0; i < 8; ++i) { // each corner of the AABB
-
-			if (frustum.GetPlane(p).IsOnPositiveSide(aabb_corners[i])) {
-				point_in = 0;
-				--corners_outside;
-			}
-		}
-
-		if(corners_outside == 0) // totally in
-			return false;
-
-		total_in += point_in;
-	}
-	//if (iTotalIn == 6)// TODO: maybe is usefull ...
-		//return true;
+	// Center against extents per plane instead of the 8 corners, batches go through trFrustumCuller
+	Plane planes[6];
+	frustum.GetPlanes(planes);
 
-	return true;
+	return QuadtreeNode::TestAaBox(ref_box, planes) != FRUSTUM_OUTSIDE;
 }
 
 // -----------------------------------------------------------------
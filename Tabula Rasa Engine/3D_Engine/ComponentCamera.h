@@ -2,18 +2,20 @@
 #define __COMPONENT_CAMERA_H__
 
 #include "Component.h"
+#include "trPool.h"
 #include "MathGeoLib/MathGeoLib.h"
 
 
 class ComponentCamera : public Component
 {
+	TR_POOLED_CLASS(ComponentCamera)
 
 public:
 
 	ComponentCamera(GameObject* embedded_game_object);
 	~ComponentCamera();
 
-	bool Save(JSON_Object* component_obj)const;
+	void Capture(trSnapshotRecord& record)const;
 	bool Load(const JSON_Object* component_obj);
 
 	bool PreUpdate(float dt);
@@ -1,4 +1,5 @@
 #include "ComponentMaterial.h"
+#include "trSceneSnapshot.h"
 #include "trApp.h"
 #include "MaterialImporter.h"
 #include "trFileSystem.h"
@@ -6,6 +7,8 @@
 #include "Resource.h"
 #include "ResourceTexture.h"
 
+TR_POOLED_CLASS_IMPL(ComponentMaterial)
+
 ComponentMaterial::ComponentMaterial(GameObject * embedded_game_object) :
 Component(embedded_game_object, Component::component_type::COMPONENT_MATERIAL)
 {
@@ -18,12 +21,11 @@ ComponentMaterial::~ComponentMaterial()
 		//res->Release();
 }
 
-bool ComponentMaterial::Save(JSON_Object* component_obj) const
+void ComponentMaterial::Capture(trSnapshotRecord& record) const
 {
 	const Resource* res = this->GetResource();
-	if(res)
-		json_object_set_string(component_obj, "path", res->GetExportedFile());
-	return true;
+	if (res)
+		record.AddString("path", res->GetExportedFile());
 }
 
 bool ComponentMaterial::Load(const JSON_Object * component_obj)
@@ -44,7 +46,7 @@ bool ComponentMaterial::Load(const JSON_Object * component_obj)
 			uid_force.erase(extension);
 		UID uid = static_cast<unsigned int>(std::stoul(uid_force));
 
-		SetResource(App->resources->material_importer->LoadImageFromPath(file_path, uid));
+		SetResource(App->resources->GetMaterialImporter()->LoadImageFromPath(file_path, uid));
 	}
 
 	return ret;
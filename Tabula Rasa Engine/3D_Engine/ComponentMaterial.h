@@ -2,17 +2,19 @@
 #define __COMPONENT_MATERIAL_H__
 
 #include "Component.h"
+#include "trPool.h"
 #include "MathGeoLib/MathGeoLib.h"
 
 class ComponentMaterial : public Component
 {
+	TR_POOLED_CLASS(ComponentMaterial)
 
 public:
 
 	ComponentMaterial(GameObject* embedded_game_object);
 	~ComponentMaterial();
 
-	bool Save(JSON_Object* component_obj)const;
+	void Capture(trSnapshotRecord& record)const;
 	bool Load(const JSON_Object* component_obj);
 
 	void SetAmbientColor(float4 ambient_color);
@@ -1,4 +1,5 @@
 #include "ComponentMesh.h"
+#include "trSceneSnapshot.h"
 
 #include "trApp.h"
 #include "trResources.h"
@@ -13,6 +14,8 @@
 
 #include "ComponentBone.h"
 
+TR_POOLED_CLASS_IMPL(ComponentMesh)
+
 ComponentMesh::ComponentMesh(GameObject * embedded_game_object) : 
 	Component(embedded_game_object, Component::component_type::COMPONENT_MESH)
 {
@@ -33,20 +36,17 @@ ComponentMesh::~ComponentMesh()
 
 bool ComponentMesh::Start()
 {
-	if (root_bone)
-		AttachBones(root_bone);
+	if (GameObject* root_bone_go = App->main_scene->GetGameObject(root_bone))
+		AttachBones(root_bone_go);
 	return true;
 }
 
-bool ComponentMesh::Save(JSON_Object* component_obj) const
+void ComponentMesh::Capture(trSnapshotRecord& record) const
 {
-	//todo: get resource path etc
 	const Resource* res = this->GetResource();
-	if (res) {
-		json_object_set_string(component_obj, "path", res->GetExportedFile());
-	}
-	json_object_set_number(component_obj, "root_bone", root_bones_uid);
-	return true;
+	if (res)
+		record.AddString("path", res->GetExportedFile());
+	record.AddNumber("root_bone", root_bones_uid);
 }
 
 bool ComponentMesh::Load(const JSON_Object * component_obj)
@@ -70,10 +70,11 @@ bool ComponentMesh::Load(const JSON_Object * component_obj)
 			uid_force.erase(extension);
 		UID uid = static_cast<unsigned int>(std::stoul(uid_force));
 
-		SetResource(App->resources->mesh_importer->GenerateResourceFromFile(file_path, uid));
+		SetResource(App->resources->GetSceneImporter()->GenerateResourceFromFile(file_path, uid));
 	}
 
-	root_bone = RecursiveFindGO(App->main_scene->GetRoot());
+	GameObject* root_bone_go = App->main_scene->FindGoByUUID(root_bones_uid);
+	root_bone = root_bone_go != nullptr ? root_bone_go->GetHandle() : GameObjectHandle();
 
 	return ret;
 }
@@ -91,8 +92,8 @@ bool ComponentMesh::SetResource(UID resource)
 		uint num_references = mesh_res->LoadToMemory();
 
 	if (mesh_res) {
-		embedded_go->bounding_box = AABB(float3(0.f, 0.f, 0.f), float3(0.f, 0.f, 0.f));
-		embedded_go->bounding_box.Enclose((float3*)mesh_res->vertices, mesh_res->vertex_size / 3);
+		embedded_go->bounding_box = mesh_res->local_aabb;
+		embedded_go->MarkBoundsDirty();
 	}
 
 	return true;
@@ -106,7 +107,7 @@ void ComponentMesh::AttachBones(const GameObject* go)
 	if (bones.size() > 0)
 	{
 		DetachBones();
-		root_bones = go;
+		root_bone = go->GetHandle();
 		attached_bones = bones;
 
 		ResourceMesh* res = (ResourceMesh*)this->GetResource();
@@ -163,17 +164,3 @@ void ComponentMesh::RecursiveFindBones(const GameObject * go, std::vector<Compon
 	for (std::list<GameObject*>::const_iterator it = go->childs.begin(); it != go->childs.end(); ++it)
 		RecursiveFindBones(*it, output);
 }
-
-GameObject* ComponentMesh::RecursiveFindGO(GameObject * go)
-{
-	if (go->GetUUID() == this->root_bones_uid)
-		return go;
-
-	for (std::list<GameObject*>::iterator it = go->childs.begin(); it != go->childs.end(); ++it) {
-		GameObject* go_to_return = RecursiveFindGO((*it));
-		if (go_to_return)
-			return go_to_return;
-	}
-
-	return nullptr;
-}
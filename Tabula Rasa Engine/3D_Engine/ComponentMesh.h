@@ -2,6 +2,8 @@
 #define __COMPONENT_MESH_H__
 
 #include "Component.h"
+#include "trPool.h"
+#include "GameObjectHandle.h"
 #include "MathGeoLib/MathGeoLib.h"
 
 class ResourceMesh;
@@ -9,6 +11,7 @@ class ComponentBone;
 
 class ComponentMesh : public Component
 {
+	TR_POOLED_CLASS(ComponentMesh)
 public:
 
 	ComponentMesh(GameObject* embedded_game_object);
@@ -17,7 +20,7 @@ public:
 
 	bool Start();
 
-	bool Save(JSON_Object* component_obj)const;
+	void Capture(trSnapshotRecord& record)const;
 	bool Load(const JSON_Object* component_obj);
 
 	bool SetResource(UID resource);
@@ -30,13 +33,10 @@ public:
 
 	void RecursiveFindBones(const GameObject * go, std::vector<ComponentBone*>& found) const;
 
-	GameObject* RecursiveFindGO(GameObject* go);
-	
 
 public:
-	GameObject* root_bone = nullptr;
+	GameObjectHandle root_bone;
 	uint root_bones_uid = 0;
-	const GameObject* root_bones = nullptr;
 
 	std::vector<ComponentBone*> attached_bones;
 };
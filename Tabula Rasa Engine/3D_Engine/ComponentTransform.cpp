@@ -1,59 +1,59 @@
 #include "ComponentTransform.h"
+#include "trSceneSnapshot.h"
 #include "GameObject.h"
 
 #include "trApp.h"
 #include "trMainScene.h"
 
+TR_POOLED_CLASS_IMPL(ComponentTransform)
 
-ComponentTransform::ComponentTransform(GameObject* embedded_game_object): Component(embedded_game_object, Component::component_type::COMPONENT_TRANSFORM),
-position(float3::zero), scale(float3(1.f, 1.f, 1.f)), rotation(Quat::identity)
-{
 
+ComponentTransform::ComponentTransform(GameObject* embedded_game_object): Component(embedded_game_object, Component::component_type::COMPONENT_TRANSFORM)
+{
+	CreateHandle(float3::zero, float3(1.f, 1.f, 1.f), Quat::identity);
 }
 
 ComponentTransform::ComponentTransform(GameObject* embedded_game_object, const float3 & translation, const float3 & scale, const Quat & rotation) :
-	Component(embedded_game_object, Component::component_type::COMPONENT_TRANSFORM),
-	position(translation), scale(scale), rotation(rotation)
+	Component(embedded_game_object, Component::component_type::COMPONENT_TRANSFORM)
 {
-
+	CreateHandle(translation, scale, rotation);
 }
 
 ComponentTransform::~ComponentTransform()
 {
+	if (handle != INVALID_TRANSFORM)
+		App->transforms.Destroy(handle);
 }
 
-bool ComponentTransform::Save(JSON_Object* component_obj) const
+void ComponentTransform::CreateHandle(const float3& translation, const float3& scale, const Quat& rotation)
 {
-	// Translation
-	JSON_Value* component_value = json_value_init_array();
-	JSON_Array* translation_array = json_value_get_array(component_value);
-	json_object_set_value(component_obj, "Translation", component_value);
-	json_array_append_number(translation_array, position.x);
-	json_array_append_number(translation_array, position.y);
-	json_array_append_number(translation_array, position.z);
+	TransformHandle parent_handle = INVALID_TRANSFORM;
+	GameObject* parent = embedded_go->GetParent();
+	if (parent != nullptr && parent->GetTransform() != nullptr)
+		parent_handle = parent->GetTransform()->GetHandle();
 
-	// Scale
-	component_value = json_value_init_array();
-	JSON_Array* scale_array = json_value_get_array(component_value);
-	json_object_set_value(component_obj, "Scale", component_value);
-	json_array_append_number(scale_array, scale.x);
-	json_array_append_number(scale_array, scale.y);
-	json_array_append_number(scale_array, scale.z);
-	
-	// Rotation
-	component_value = json_value_init_array();
-	JSON_Array* rotation_array = json_value_get_array(component_value);
-	json_object_set_value(component_obj, "Rotation", component_value);
-	json_array_append_number(rotation_array, rotation.w);
-	json_array_append_number(rotation_array, rotation.x);
-	json_array_append_number(rotation_array, rotation.y);
-	json_array_append_number(rotation_array, rotation.z);
+	handle = App->transforms.Create(parent_handle, translation, rotation, scale);
+}
 
-	return true;
+void ComponentTransform::Capture(trSnapshotRecord& record) const
+{
+	float3 position = GetTranslation();
+	float3 scale = GetScale();
+	Quat rotation = GetRotation();
+
+	// Rotation is saved w first
+	float rotation_wxyz[4] = { rotation.w, rotation.x, rotation.y, rotation.z };
+
+	record.AddArray("Translation", position.ptr(), 3u);
+	record.AddArray("Scale", scale.ptr(), 3u);
+	record.AddArray("Rotation", rotation_wxyz, 4u);
 }
 
 bool ComponentTransform::Load(const JSON_Object * component_obj)
 {
+	float3 position, scale;
+	Quat rotation;
+
 	// Translation
 	JSON_Array* array = json_object_get_array(component_obj, "Translation");
 	JSON_Value* value = json_array_get_value(array, 0);
@@ -83,23 +83,20 @@ bool ComponentTransform::Load(const JSON_Object * component_obj)
 	value = json_array_get_value(array, 3);
 	rotation.z = json_value_get_number(value);
 
+	App->transforms.SetLocal(handle, position, rotation, scale);
+
 	return true;
 }
 
 void ComponentTransform::Setup(const float3 & translation, const float3 & scale, const Quat & rotation, bool importing)
 {
-	this->position = translation;
-	this->scale = scale;
-	this->rotation = rotation;
+	App->transforms.SetLocal(handle, translation, rotation, scale);
 
-	this->local_matrix = float4x4::FromTRS(this->position, this->rotation, this->scale);
-
-	embedded_go->RecalculateBoundingBox();
+	embedded_go->MarkBoundsDirty();
 	
-	if (embedded_go->is_static && !importing) {
-		App->main_scene->EraseGoInQuadtree(embedded_go);
+	// Stays in the quadtree, the bounds pass moves it
+	if (!importing)
 		embedded_go->is_static = false;
-	}
 }
 
 void ComponentTransform::SetupFromGlobalMatrix(float4x4 global_matrix)
@@ -116,71 +113,83 @@ void ComponentTransform::SetupFromGlobalMatrix(float4x4 global_matrix)
 	else
 		new_local_mat = global_matrix;
 
-	new_local_mat.Decompose(position, rotation, scale);
-	Setup(position, scale, rotation);
+	float3 new_position, new_scale;
+	Quat new_rotation;
+	new_local_mat.Decompose(new_position, new_rotation, new_scale);
+	Setup(new_position, new_scale, new_rotation);
 }
 
-const float3 & ComponentTransform::GetTranslation() const
+float3 ComponentTransform::GetTranslation() const
 {
-	return position;
+	return App->transforms.GetPosition(handle);
 }
 
-const float3 & ComponentTransform::GetScale() const
+float3 ComponentTransform::GetScale() const
 {
-	return scale;
+	return App->transforms.GetScale(handle);
 }
 
-const Quat & ComponentTransform::GetRotation() const
+Quat ComponentTransform::GetRotation() const
 {
-	return rotation;
+	return App->transforms.GetRotation(handle);
 }
 
 void ComponentTransform::GetLocalPosition(float3 * position, float3 * scale, Quat * rot) const
 {
-	*position = this->position;
-	*scale = this->scale;
-	*rot = this->rotation;
+	*position = GetTranslation();
+	*scale = GetScale();
+	*rot = GetRotation();
 }
 
 float4x4 ComponentTransform::GetMatrix()
 {
-	local_matrix = float4x4::FromTRS(position, rotation, scale);
-
-	if (embedded_go->GetParent() != nullptr) {
-			float4x4 parent_matrix = embedded_go->GetParent()->GetTransform()->GetMatrix();
-			//parent_matrix = parent_matrix.Transposed();
-			global_matrix = parent_matrix * local_matrix;
-			return global_matrix;
-	}
-	else
-		return local_matrix;
+	// Usually already clean after the batched pass, otherwise only the dirty parents are calculated
+	return App->transforms.GetWorldMatrix(handle);
 }
 
 float4x4 ComponentTransform::GetLocal()
 {
-	return float4x4::FromTRS(position, rotation, scale);
+	return App->transforms.GetLocalMatrix(handle);
 }
 
-void ComponentTransform::SetPosition(const float3 position)
+void ComponentTransform::MarkDirty()
 {
-	this->position = position;
+	App->transforms.MarkDirty(handle);
+}
 
-	this->local_matrix = float4x4::FromTRS(this->position, this->rotation, this->scale);
-	embedded_go->RecalculateBoundingBox();
+bool ComponentTransform::IsDirty() const
+{
+	return App->transforms.IsDirty(handle);
 }
 
-void ComponentTransform::SetScale(const float3 scale)
+TransformHandle ComponentTransform::GetHandle() const
 {
-	this->scale = scale;
+	return handle;
+}
+
+float4x4 ComponentTransform::GetInterpolatedMatrix(float alpha)
+{
+	// Nothing to blend with a variable timestep
+	if (!App->IsFixedTimestep())
+		return GetMatrix();
 
-	this->local_matrix = float4x4::FromTRS(this->position, this->rotation, this->scale);
-	embedded_go->RecalculateBoundingBox();
+	return App->transforms.GetInterpolatedWorldMatrix(handle, alpha);
 }
 
-void ComponentTransform::SetRotation(const Quat rot)
+void ComponentTransform::SetPosition(const float3 position)
+{
+	App->transforms.SetLocal(handle, position, GetRotation(), GetScale());
+	embedded_go->MarkBoundsDirty();
+}
+
+void ComponentTransform::SetScale(const float3 scale)
 {
-	this->rotation = rot;
+	App->transforms.SetLocal(handle, GetTranslation(), GetRotation(), scale);
+	embedded_go->MarkBoundsDirty();
+}
 
-	this->local_matrix = float4x4::FromTRS(this->position, this->rotation, this->scale);
-	embedded_go->RecalculateBoundingBox();
+void ComponentTransform::SetRotation(const Quat rot)
+{
+	App->transforms.SetLocal(handle, GetTranslation(), rot, GetScale());
+	embedded_go->MarkBoundsDirty();
 }
\ No newline at end of file
@@ -3,29 +3,42 @@
 
 #include "MathGeoLib/MathGeoLib.h"
 #include "Component.h"
+#include "trPool.h"
+#include "trTransformSystem.h"
 
 class ComponentTransform : public Component
 {
+	TR_POOLED_CLASS(ComponentTransform)
 public:
 	ComponentTransform(){}
 	ComponentTransform(GameObject* embedded_game_object);
 	ComponentTransform(GameObject* embedded_game_object, const float3& translation, const float3& scale, const Quat& rotation);
 	~ComponentTransform();
 
-	bool Save(JSON_Object* component_obj)const;
+	void Capture(trSnapshotRecord& record)const;
 	bool Load(const JSON_Object* component_obj);
 
 	void Setup(const float3& translation, const float3& scale, const Quat& rotation, bool importing = false);
 	void SetupFromGlobalMatrix(float4x4 global_matrix);
 
-	const float3& GetTranslation()const;
-	const float3& GetScale()const;
-	const Quat& GetRotation()const;
+	// By value, the storage moves when transforms are created or destroyed
+	float3 GetTranslation()const;
+	float3 GetScale()const;
+	Quat GetRotation()const;
 
 	void GetLocalPosition(float3* position, float3* scale, Quat* rot) const;
 
-	float4x4 GetMatrix(); // Returns global (or local if have no parent)
-	float4x4 GetLocal(); // Returns local
+	float4x4 GetMatrix(); // Returns global (or local if have no parent), cached
+	float4x4 GetLocal(); // Returns local, cached
+
+	// World matrix of this transform and its childs must be recalculated (moved or reparented)
+	void MarkDirty();
+	bool IsDirty() const;
+
+	TransformHandle GetHandle() const;
+
+	// Global matrix between the state before the last fixed tick and the current one, cached by App->transforms
+	float4x4 GetInterpolatedMatrix(float alpha);
 
 	void SetPosition(const float3 position);
 	void SetScale(const float3 scale);
@@ -33,12 +46,12 @@ public:
 
 private:
 
-	float3 position = float3::zero;
-	float3 scale = float3::zero;
-	Quat rotation = Quat::identity;
+	void CreateHandle(const float3& translation, const float3& scale, const Quat& rotation);
+
+private:
 
-	float4x4 local_matrix;
-	float4x4 global_matrix;
+	// Local TRS, matrices and the state before the last fixed tick live in App->transforms
+	TransformHandle handle = INVALID_TRANSFORM;
 
 };
 
@@ -1,12 +1,17 @@
 #ifndef __EVENT_H__
 #define __EVENT_H__
 
+#include "trDefs.h"
+
+class GameObject;
+
 class Event {
 
 public:
 	enum event_type {
 		NONE,
-		GAMEOBJECT_DESTROYED
+		GAMEOBJECT_DESTROYED,
+		EVENT_TYPE_COUNT
 	};
 
 public:
@@ -15,11 +20,23 @@ public:
 
 	Event(event_type type) :type(type) {}
 
+	Event(event_type type, UID uid, const GameObject* game_object = nullptr) :type(type), uid(uid), game_object(game_object) {}
+
 	const event_type GetType() const { return type; }
 
+	// Two events with the same type and payload are the same event
+	bool operator==(const Event& other) const { return type == other.type && uid == other.uid && game_object == other.game_object; }
+
+public:
+
+	UID uid = 0u;
+
+	// Identity only: by the time a GAMEOBJECT_DESTROYED is delivered the object is already released
+	const GameObject* game_object = nullptr;
+
 private:
 	event_type type = event_type::NONE;
 
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -1,4 +1,5 @@
 #include "GameObject.h"
+#include "trSceneSnapshot.h"
 #include <list>
 
 #include "trApp.h"
@@ -17,6 +18,8 @@
 
 #include "Event.h"
 
+TR_POOLED_CLASS_IMPL(GameObject)
+
 // ---------------------------------------------------------
 GameObject::GameObject()
 {}
@@ -36,6 +39,9 @@ GameObject::GameObject(const char * name, GameObject * parent)
 
 	this->is_static = true;
 
+	handle = App->main_scene->CreateHandle(this);
+	App->main_scene->IndexGo(this);
+
 	if (parent != nullptr) {// if is not root
 		//CreateComponent(Component::component_type::COMPONENT_TRANSFORM);
 		parent->childs.push_back(this);
@@ -49,6 +55,15 @@ GameObject::GameObject(const char * name, GameObject * parent)
 // ---------------------------------------------------------
 GameObject::~GameObject()
 {
+	App->main_scene->UnindexGo(this);
+	App->main_scene->DestroyHandle(handle);
+	if (bounds_slot != BOUNDS_NO_SLOT)
+		App->main_scene->CancelBoundsUpdate(this);
+	if (quadtree_node != nullptr)
+		App->main_scene->quadtree.Remove(this);
+	if (bvh_slot != BVH_NO_SLOT)
+		App->main_scene->bvh.Remove(this);
+
 	for (std::list<Component*>::iterator it = components.begin(); it != components.end(); it++)
 		RELEASE(*it);
 
@@ -71,51 +86,27 @@ bool GameObject::Update(float dt)
 
 bool GameObject::Save(JSON_Array* array)const
 {
-	JSON_Value* root_value = nullptr;
-	JSON_Object* root_obj = nullptr;
-	root_value = json_value_init_object();
-	root_obj = json_value_get_object(root_value);
-
-	// TODO check duplicate error
-
-	// GO info
-	json_object_set_number(root_obj, "UUID", uuid);
-	json_object_set_number(root_obj, "ParentUUID", (parent) ? parent->GetUUID() : 0);
-	json_object_set_string(root_obj, "Name", name.c_str());
-
-	// COMPONENTS info
-	JSON_Value* array_value = json_value_init_array();
-	JSON_Array * components_array = json_value_get_array(array_value);
-
-	json_object_set_value(root_obj, "Components", array_value);
-
-	for (std::list<Component*>::const_iterator it = components.begin(); it != components.end(); ++it)
-	{
-		JSON_Value* component_value = nullptr;
-		JSON_Object* component_obj = nullptr;
-		component_value = json_value_init_object();
-		component_obj = json_value_get_object(component_value);
-
-		json_object_set_number(component_obj, "Type", (*it)->GetType()); // Would be cool if instead of number we write the string ...
-
-		(*it)->Save(component_obj);
-
-		json_array_append_value(components_array, json_value_deep_copy(component_value));
-	}
-
-	json_array_append_value(array, json_value_deep_copy(root_value));
-
-	// Iterate for all children
-	for (std::list<GameObject*>::const_iterator it = childs.begin(); it != childs.end(); ++it)
-		(*it)->Save(array);
+	// Same path as the scene saved on the io thread
+	trSceneSnapshot snapshot;
+	snapshot.Capture(this);
+	snapshot.Write(array);
 
 	return true;
 }
 
+void GameObject::Capture(trSnapshotRecord& record) const
+{
+	record.AddNumber("UUID", uuid);
+	record.AddNumber("ParentUUID", (parent) ? parent->GetUUID() : 0);
+	record.AddString("Name", name.c_str());
+}
+
 bool GameObject::Load(JSON_Object * go_obj, std::map<GameObject*, UID>& uuid_relations)
 {
 	JSON_Value* go_value = json_object_get_value(go_obj, "UUID");
+	App->main_scene->UnindexGo(this);
 	uuid = json_value_get_number(go_value);
+	App->main_scene->IndexGo(this);
 
 	go_value = json_object_get_value(go_obj, "ParentUUID");
 	uuid_relations[this] = json_value_get_number(go_value);
@@ -151,7 +142,7 @@ bool GameObject::Load(JSON_Object * go_obj, std::map<GameObject*, UID>& uuid_rel
 	Quat rotation = Quat::identity;
 	this->transform->GetLocalPosition(&position, &scale, &rotation);
 	this->GetTransform()->Setup(position, scale, rotation);*/
-	this->RecalculateBoundingBox();
+	this->MarkBoundsDirty();
 
 	return true;
 }
@@ -189,6 +180,7 @@ Component * GameObject::CreateComponent(Component::component_type type)
 	}
 
 	this->components.push_back(tmp_component);
+	AddToSlot(tmp_component);
 
 	return tmp_component;
 }
@@ -218,17 +210,46 @@ Component * GameObject::CreateComponent(Component::component_type type,  Compone
 	}
 
 	this->components.push_back(tmp_component);
+	AddToSlot(tmp_component);
 
 	return tmp_component;
 }
 
-Component * GameObject::FindComponentByType(Component::component_type type)
+Component * GameObject::FindComponentByType(Component::component_type type) const
 {
-	for (std::list<Component*>::iterator co_it = components.begin(); co_it != components.end(); co_it++) {
-		if ((*co_it)->GetType() == type)
-			return (*co_it);
+	if (type >= Component::COMPONENT_TYPE_COUNT)
+		return nullptr;
+
+	return component_slots[type];
+}
+
+bool GameObject::HasComponent(Component::component_type type) const
+{
+	return (signature & COMPONENT_BIT(type)) != 0u;
+}
+
+bool GameObject::HasComponents(uint signature) const
+{
+	return (this->signature & signature) == signature;
+}
+
+uint GameObject::GetSignature() const
+{
+	return signature;
+}
+
+void GameObject::AddToSlot(Component* component)
+{
+	if (component == nullptr)
+		return;
+
+	// Keeps the first one, like the old list walk did
+	Component::component_type type = component->GetType();
+	if (component_slots[type] == nullptr)
+	{
+		component_slots[type] = component;
+		signature |= COMPONENT_BIT(type);
 	}
-	return nullptr;
 }
 
 GameObject * GameObject::GetParent() const
@@ -252,6 +273,11 @@ void GameObject::SetParent(GameObject * new_parent, bool force_transform_calc)
 	if (new_parent)
 		new_parent->childs.push_back(this);
 
+	TransformHandle parent_handle = INVALID_TRANSFORM;
+	if (new_parent != nullptr && new_parent->GetTransform() != nullptr)
+		parent_handle = new_parent->GetTransform()->GetHandle();
+	App->transforms.SetParent(transform->GetHandle(), parent_handle);
+
 	if (force_transform_calc)
 	{
 		float4x4 parent_global_matrix = new_parent->GetTransform()->GetMatrix();
@@ -264,7 +290,7 @@ void GameObject::SetParent(GameObject * new_parent, bool force_transform_calc)
 		transform->Setup(translation, scale, rotation);
 	}
 
-	this->RecalculateBoundingBox();
+	this->MarkBoundsDirty();
 }
 
 const char * GameObject::GetName() const
@@ -282,6 +308,11 @@ ComponentTransform * GameObject::GetTransform() const
 	return transform;
 }
 
+GameObjectHandle GameObject::GetHandle() const
+{
+	return handle;
+}
+
 UID GameObject::GetUUID() const
 {
 	return uuid;
@@ -289,31 +320,51 @@ UID GameObject::GetUUID() const
 
 void GameObject::RecalculateBoundingBox()
 {
-	ComponentMesh* mesh_co = (ComponentMesh*)FindComponentByType(Component::component_type::COMPONENT_MESH);
-	
-	if (mesh_co != nullptr) {
-		bounding_box.SetNegativeInfinity();
+	UpdateBoundingBox();
 
-		ResourceMesh* mesh = (ResourceMesh*)mesh_co->GetResource();
+	for (std::list<GameObject*>::iterator it = childs.begin(); it != childs.end(); it++)
+		(*it)->RecalculateBoundingBox();
+}
 
-		if(mesh)
-			bounding_box.Enclose((float3*)mesh->vertices, mesh->vertex_size / 3);
-	
-		OBB obb(bounding_box);
-		obb.Transform(transform->GetMatrix());
+void GameObject::MarkBoundsDirty()
+{
+	// Already dirty means the whole subtree is
+	if (bounds_dirty)
+		return;
 
-		bounding_box = obb.MinimalEnclosingAABB();
-	}
-	else { // GO without mesh
+	bounds_dirty = true;
+
+	if (bounds_slot == BOUNDS_NO_SLOT)
+		App->main_scene->QueueBoundsUpdate(this);
+
+	for (std::list<GameObject*>::iterator it = childs.begin(); it != childs.end(); it++)
+		(*it)->MarkBoundsDirty();
+}
+
+void GameObject::UpdateBoundingBox()
+{
+	ComponentMesh* mesh_co = (ComponentMesh*)FindComponentByType(Component::component_type::COMPONENT_MESH);
+
+	ResourceMesh* mesh = mesh_co != nullptr ? (ResourceMesh*)mesh_co->GetResource() : nullptr;
+
+	if (mesh_co != nullptr && mesh == nullptr)
 		bounding_box.SetNegativeInfinity();
-		bounding_box = AABB(float3(-1.f, -1.f, -1.f), float3(1.f, 1.f, 1.f));
-		OBB obb(bounding_box);
-		obb.Transform(transform->GetMatrix());
-		bounding_box = obb.MinimalEnclosingAABB();
+	else
+	{
+		if (mesh != nullptr)
+			bounding_box = mesh->local_aabb;
+		else // GO without mesh
+			bounding_box = AABB(float3(-1.f, -1.f, -1.f), float3(1.f, 1.f, 1.f));
+
+		// Center and extents through the matrix, no corners or OBB needed
+		bounding_box.TransformAsAABB(transform->GetMatrix());
 	}
 
-	for (std::list<GameObject*>::iterator it = childs.begin(); it != childs.end(); it++)
-		(*it)->RecalculateBoundingBox();
+	// Changes node only if it left the loose box of the current one
+	if (quadtree_node != nullptr)
+		App->main_scene->quadtree.Update(this);
+	if (bvh_slot != BVH_NO_SLOT)
+		App->main_scene->bvh.Update(this);
 }
 
 bool GameObject::IsActive() const
@@ -321,24 +372,12 @@ bool GameObject::IsActive() const
 	return this->active;
 }
 
-void GameObject::DestroyGameObjectsIfNeeded()
+void GameObject::PublishDestroyed() const
 {
-	for (std::list<GameObject*>::iterator it = childs.begin(); it != childs.end();)
-	{
-		if ((*it)->to_destroy)
-		{
-			RELEASE(*it);
-			it = childs.erase(it);
-			// TODO notify to all modules
-			Event tmp_event(Event::event_type::GAMEOBJECT_DESTROYED);
-			App->SendTheCarrierPigeon(tmp_event);
-		}
-		else // Keep iterating childs
-		{
-			(*it)->DestroyGameObjectsIfNeeded();
-			it++;
-		}
-	}
+	App->event_bus.Publish(Event(Event::GAMEOBJECT_DESTROYED, uuid, this));
+
+	for (std::list<GameObject*>::const_iterator it = childs.begin(); it != childs.end(); it++)
+		(*it)->PublishDestroyed();
 }
 
 // ---------------------------------------------------------
\ No newline at end of file
@@ -2,9 +2,12 @@
 #define __GAMEOBJECT_H__
 
 #include "trDefs.h"
+#include "trPool.h"
 
 #include "Component.h"
 #include "ComponentTransform.h"
+#include "GameObjectHandle.h"
+#include "SceneBVH.h"
 
 #include "MathGeoLib/MathGeoLib.h"
 #include "ParsonJson/parson.h"
@@ -13,8 +16,14 @@
 #include <list>
 #include <map>
 
+#define BOUNDS_NO_SLOT 0xFFFFFFFF
+
+class QuadtreeNode;
+
 class GameObject
 {
+
+	TR_POOLED_CLASS(GameObject)
 public:
 	GameObject();
 	GameObject(const char* name, GameObject* parent);
@@ -23,14 +32,22 @@ public:
 	bool PreUpdate(float dt);
 	bool Update(float dt);
 
+	// The object and its childs, through trSceneSnapshot
 	bool Save(JSON_Array* array)const;
+	// UUID, parent and name as plain data, the components capture themselves
+	void Capture(trSnapshotRecord& record)const;
 	bool Load(JSON_Object* go_obj, std::map<GameObject*, UID>& uuid_relations);
 
 	Component* CreateComponent(Component::component_type type);
 	Component* CreateComponent(Component::component_type type, Component* component);
 
-	// finds and returns the first component of the type sended
-	Component* FindComponentByType(Component::component_type type);
+	// finds and returns the first component of the type sended, O(1)
+	Component* FindComponentByType(Component::component_type type) const;
+	bool HasComponent(Component::component_type type) const;
+
+	// True if every type in the mask (COMPONENT_BIT ORed) is present
+	bool HasComponents(uint signature) const;
+	uint GetSignature() const;
 
 	// getters/setters stuff
 	GameObject* GetParent() const;
@@ -39,12 +56,25 @@ public:
 	void SetName(const char* name);
 	ComponentTransform* GetTransform()const;
 	UID GetUUID()const;
+	GameObjectHandle GetHandle()const;
 
+	// Right away, for this object and its childs
 	void RecalculateBoundingBox();
 
+	// Deferred to the batched pass of the frame (trMainScene::UpdateBoundingBoxes), childs included
+	void MarkBoundsDirty();
+
+	// World box from the cached local one (Arvo), childs not included
+	void UpdateBoundingBox();
+
 	bool IsActive()const;
 
-	void DestroyGameObjectsIfNeeded();
+	// Queues a GAMEOBJECT_DESTROYED for this object and its childs
+	void PublishDestroyed() const;
+
+private:
+
+	void AddToSlot(Component* component);
 
 private:
 
@@ -53,6 +83,11 @@ private:
 	GameObject* parent = nullptr;
 	ComponentTransform* transform = nullptr; //Always should have one
 	UID uuid = 0u;
+	GameObjectHandle handle;
+
+	// First component of each type, the list keeps all of them
+	Component* component_slots[Component::COMPONENT_TYPE_COUNT] = {};
+	uint signature = 0u;
 
 public:
 
@@ -64,9 +99,17 @@ public:
 	bool to_destroy = false;
 	bool is_static = false;
 
-	bool in_camera = false;
 	bool is_active = true;
 
+	// A dirty box always has dirty childs, only the batched pass cleans them
+	bool bounds_dirty = false;
+	uint bounds_slot = BOUNDS_NO_SLOT; // in trMainScene::dirty_bounds while queued
+
+	// Node of trMainScene::quadtree holding it, nullptr if not indexed
+	QuadtreeNode* quadtree_node = nullptr;
+	uint quadtree_slot = 0u; // in quadtree_node->objects_inside
+	uint bvh_slot = BVH_NO_SLOT; // in trMainScene::bvh
+
 };
 
 #endif // __GAMEOBJECT_H__
\ No newline at end of file
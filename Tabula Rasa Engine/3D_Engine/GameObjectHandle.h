@@ -0,0 +1,22 @@
+#ifndef __GAMEOBJECT_HANDLE_H__
+#define __GAMEOBJECT_HANDLE_H__
+
+#include "trDefs.h"
+
+#define INVALID_GO_INDEX 0xFFFFFFFF
+
+// Weak reference to a GameObject: slot in the scene table plus the generation of the slot
+// when the handle was taken. Destroying the object bumps the generation, so a stale handle
+// resolves to nullptr in O(1) (trMainScene::GetGameObject).
+struct GameObjectHandle
+{
+	uint index = INVALID_GO_INDEX;
+	uint generation = 0u;
+
+	bool IsNull() const { return index == INVALID_GO_INDEX; }
+
+	bool operator==(const GameObjectHandle& other) const { return index == other.index && generation == other.generation; }
+	bool operator!=(const GameObjectHandle& other) const { return !(*this == other); }
+};
+
+#endif // __GAMEOBJECT_HANDLE_H__
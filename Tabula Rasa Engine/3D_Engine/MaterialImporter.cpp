@@ -25,11 +25,15 @@ MaterialImporter::MaterialImporter()
 		TR_LOG("trTexture: DevIL version is different ... exiting!");
 	}
 
-	ilutRenderer(ILUT_OPENGL);
 	ilInit();
 	iluInit();
-	ilutInit();
-	ilutRenderer(ILUT_OPENGL);
+
+	// ILUT uploads to GL, there is no context in headless mode
+	if (!App->IsHeadless()) {
+		ilutRenderer(ILUT_OPENGL);
+		ilutInit();
+		ilutRenderer(ILUT_OPENGL);
+	}
 
 	TR_LOG("trTexture: Initializating DevIL ...");
 }
@@ -123,6 +127,7 @@ UID MaterialImporter::LoadImageFromPath(const char * path, UID uid_to_force)
 
 	uint img_id = 0u;
 	resource->gpu_id = 0u;
+	bool decoded = false;
 
 	ILenum error_num;
 
@@ -154,17 +159,21 @@ UID MaterialImporter::LoadImageFromPath(const char * path, UID uid_to_force)
 			TR_LOG("trTexture: Error converting the image - %i - %s", error_num, iluErrorString(error_num));
 		}
 
-		glGenTextures(1, &resource->gpu_id);
-		glBindTexture(GL_TEXTURE_2D, resource->gpu_id);
+		decoded = true;
 
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+		if (!App->IsHeadless()) {
+			glGenTextures(1, &resource->gpu_id);
+			glBindTexture(GL_TEXTURE_2D, resource->gpu_id);
 
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
 
-		glTexImage2D(GL_TEXTURE_2D, 0, ilGetInteger(IL_IMAGE_FORMAT), ilGetInteger(IL_IMAGE_WIDTH),
-			ilGetInteger(IL_IMAGE_HEIGHT), 0, ilGetInteger(IL_IMAGE_FORMAT), GL_UNSIGNED_BYTE, ilGetData());
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+
+			glTexImage2D(GL_TEXTURE_2D, 0, ilGetInteger(IL_IMAGE_FORMAT), ilGetInteger(IL_IMAGE_WIDTH),
+				ilGetInteger(IL_IMAGE_HEIGHT), 0, ilGetInteger(IL_IMAGE_FORMAT), GL_UNSIGNED_BYTE, ilGetData());
+		}
 	
 		//fill the rest of the texture info
 		resource->SetExportedPath(path);
@@ -180,7 +189,8 @@ UID MaterialImporter::LoadImageFromPath(const char * path, UID uid_to_force)
 
 	ilDeleteImages(1, &img_id);
 
-	if (resource->gpu_id != 0) {
+	// Headless textures are decoded but never uploaded
+	if (resource->gpu_id != 0 || (App->IsHeadless() && decoded)) {
 		TR_LOG("trTexture: Texture created correctly");
 		return resource->GetUID();
 	}
@@ -0,0 +1,450 @@
+// ----------------------------------------------------
+// MeshBVH.cpp
+// SAH bounding volume hierarchy of the triangles of a mesh
+// ----------------------------------------------------
+
+#include "MeshBVH.h"
+#include "trApp.h"
+#include "trFrameAllocator.h"
+
+#include <algorithm>
+#include <xmmintrin.h>
+
+// Node waiting to be visited, with the distance the ray enters it
+struct TraversalEntry
+{
+	uint node;
+	float t;
+};
+
+// Distance the ray enters the box, FLOAT_INF if it misses it or only reaches it after max_t.
+// The three slabs at once; the fourth lane holds left_first/count and is never read.
+static inline float SlabTest(const MeshBVH::Node& node, __m128 origin, __m128 inv_dir, float max_t)
+{
+	__m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.min), origin), inv_dir);
+	__m128 t2 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.max), origin), inv_dir);
+	__m128 t_near = _mm_min_ps(t1, t2);
+	__m128 t_far = _mm_max_ps(t1, t2);
+
+	// x against y and z in the first lane
+	__m128 enter = _mm_max_ss(t_near, _mm_shuffle_ps(t_near, t_near, _MM_SHUFFLE(1, 1, 1, 1)));
+	enter = _mm_max_ss(enter, _mm_shuffle_ps(t_near, t_near, _MM_SHUFFLE(2, 2, 2, 2)));
+	enter = _mm_max_ss(enter, _mm_setzero_ps());
+
+	__m128 exit = _mm_min_ss(t_far, _mm_shuffle_ps(t_far, t_far, _MM_SHUFFLE(1, 1, 1, 1)));
+	exit = _mm_min_ss(exit, _mm_shuffle_ps(t_far, t_far, _MM_SHUFFLE(2, 2, 2, 2)));
+	exit = _mm_min_ss(exit, _mm_set_ss(max_t));
+
+	float t_enter = _mm_cvtss_f32(enter);
+	return t_enter <= _mm_cvtss_f32(exit) ? t_enter : FLOAT_INF;
+}
+
+MeshBVH::MeshBVH()
+{}
+
+MeshBVH::~MeshBVH()
+{}
+
+// ---------------------------------------------
+void MeshBVH::Build(const float* vertices, uint vertex_size, const uint* indices, uint index_size)
+{
+	Clear();
+
+	uint triangle_count = index_size / 3u;
+	if (vertices == nullptr || indices == nullptr || triangle_count == 0u)
+		return;
+
+	// Indexed by triangle, only the valid ones are in triangles
+	std::vector<AABB> boxes(triangle_count);
+	std::vector<float3> centers(triangle_count);
+	triangles.reserve(triangle_count);
+
+	uint vertex_count = vertex_size / 3u;
+	for (uint i = 0u; i < triangle_count; ++i)
+	{
+		const uint* index = &indices[i * 3u];
+		if (index[0] >= vertex_count || index[1] >= vertex_count || index[2] >= vertex_count)
+			continue;
+
+		float3 a(&vertices[index[0] * 3u]);
+		boxes[i] = AABB(a, a);
+		boxes[i].Enclose(float3(&vertices[index[1] * 3u]));
+		boxes[i].Enclose(float3(&vertices[index[2] * 3u]));
+
+		centers[i] = boxes[i].CenterPoint();
+		triangles.push_back(i);
+	}
+
+	uint count = triangles.size();
+	if (count == 0u)
+		return;
+
+	// Never more than 2n - 1 nodes
+	nodes.reserve(count * 2u);
+
+	Node root;
+	root.left_first = 0u;
+	root.count = count;
+	nodes.push_back(root);
+
+	Subdivide(0u, boxes, centers);
+}
+
+void MeshBVH::Clear()
+{
+	nodes.clear();
+	triangles.clear();
+}
+
+bool MeshBVH::IsBuilt() const
+{
+	return !nodes.empty();
+}
+
+// ---------------------------------------------
+bool MeshBVH::RayCast(const LineSegment& segment, const float* vertices, const uint* indices, MeshHit& hit) const
+{
+	float length = segment.Length();
+	if (nodes.empty() || length <= 0.f)
+		return false;
+
+	float3 dir = segment.Dir();
+	__m128 origin = _mm_setr_ps(segment.a.x, segment.a.y, segment.a.z, 0.f);
+	__m128 inv_dir = _mm_div_ps(_mm_set1_ps(1.f), _mm_setr_ps(dir.x, dir.y, dir.z, 1.f));
+
+	// Like LineSegment::Intersects(Triangle), only hits before b count
+	float best_t = length;
+	uint best_triangle = 0u;
+	bool found = false;
+
+	float root_t = SlabTest(nodes[0], origin, inv_dir, best_t);
+	if (root_t == FLOAT_INF)
+		return false;
+
+	FrameVector<TraversalEntry> stack(App->frame_allocator);
+	stack.push_back({ 0u, root_t });
+
+	while (!stack.empty())
+	{
+		TraversalEntry entry = stack.back();
+		stack.pop_back();
+
+		// A closer hit was found since it was pushed
+		if (entry.t >= best_t)
+			continue;
+
+		const Node& node = nodes[entry.node];
+
+		if (node.count > 0u)
+		{
+			for (uint k = node.left_first; k < node.left_first + node.count; ++k)
+			{
+				float t;
+				if (IntersectTriangle(triangles[k], segment.a, dir, vertices, indices, t) && t < best_t)
+				{
+					best_t = t;
+					best_triangle = triangles[k];
+					found = true;
+				}
+			}
+			continue;
+		}
+
+		// Nearest child on top so it is visited first
+		float left_t = SlabTest(nodes[node.left_first], origin, inv_dir, best_t);
+		float right_t = SlabTest(nodes[node.left_first + 1u], origin, inv_dir, best_t);
+
+		TraversalEntry near_entry = { node.left_first, left_t };
+		TraversalEntry far_entry = { node.left_first + 1u, right_t };
+		if (right_t < left_t)
+			std::swap(near_entry, far_entry);
+
+		if (far_entry.t != FLOAT_INF)
+			stack.push_back(far_entry);
+		if (near_entry.t != FLOAT_INF)
+			stack.push_back(near_entry);
+	}
+
+	if (found)
+	{
+		hit.distance = best_t / length;
+		hit.point = segment.a + dir * best_t;
+		hit.triangle = best_triangle;
+	}
+
+	return found;
+}
+
+uint MeshBVH::RayCastAll(const LineSegment& segment, const float* vertices, const uint* indices, std::vector<MeshHit>& hits) const
+{
+	hits.clear();
+
+	float length = segment.Length();
+	if (nodes.empty() || length <= 0.f)
+		return 0u;
+
+	float3 dir = segment.Dir();
+	__m128 origin = _mm_setr_ps(segment.a.x, segment.a.y, segment.a.z, 0.f);
+	__m128 inv_dir = _mm_div_ps(_mm_set1_ps(1.f), _mm_setr_ps(dir.x, dir.y, dir.z, 1.f));
+
+	FrameVector<uint> stack(App->frame_allocator);
+	stack.push_back(0u);
+
+	while (!stack.empty())
+	{
+		const Node& node = nodes[stack.back()];
+		stack.pop_back();
+
+		if (SlabTest(node, origin, inv_dir, length) == FLOAT_INF)
+			continue;
+
+		if (node.count == 0u)
+		{
+			stack.push_back(node.left_first);
+			stack.push_back(node.left_first + 1u);
+			continue;
+		}
+
+		for (uint k = node.left_first; k < node.left_first + node.count; ++k)
+		{
+			float t;
+			if (IntersectTriangle(triangles[k], segment.a, dir, vertices, indices, t) && t < length)
+			{
+				MeshHit mesh_hit;
+				mesh_hit.distance = t / length;
+				mesh_hit.point = segment.a + dir * t;
+				mesh_hit.triangle = triangles[k];
+				hits.push_back(mesh_hit);
+			}
+		}
+	}
+
+	std::sort(hits.begin(), hits.end(), [](const MeshHit& a, const MeshHit& b) { return a.distance < b.distance; });
+
+	return hits.size();
+}
+
+uint MeshBVH::GetNodeCount() const
+{
+	return nodes.size();
+}
+
+// ---------------------------------------------
+uint MeshBVH::GetSerializedSize() const
+{
+	return sizeof(uint) * 2u + sizeof(Node) * nodes.size() + sizeof(uint) * triangles.size();
+}
+
+void MeshBVH::Serialize(char* cursor) const
+{
+	uint ranges[2] = { nodes.size(), triangles.size() };
+
+	uint bytes = sizeof(ranges); // First store ranges
+	memcpy(cursor, ranges, bytes);
+
+	cursor += bytes;
+	bytes = sizeof(Node) * nodes.size(); // Store nodes
+	if (bytes > 0u)
+		memcpy(cursor, &nodes[0], bytes);
+
+	cursor += bytes;
+	bytes = sizeof(uint) * triangles.size(); // Store triangles
+	if (bytes > 0u)
+		memcpy(cursor, &triangles[0], bytes);
+}
+
+bool MeshBVH::Deserialize(const char* cursor, uint size, uint triangle_count)
+{
+	Clear();
+
+	uint ranges[2];
+	uint bytes = sizeof(ranges);
+	if (size < bytes)
+		return false;
+	memcpy(ranges, cursor, bytes);
+
+	// Saved without a tree, or for other triangles
+	if (ranges[0] == 0u || ranges[0] > ranges[1] * 2u || ranges[1] > triangle_count)
+		return false;
+	if (size < bytes + sizeof(Node) * ranges[0] + sizeof(uint) * ranges[1])
+		return false;
+
+	// Load nodes
+	cursor += bytes;
+	bytes = sizeof(Node) * ranges[0];
+	nodes.resize(ranges[0]);
+	memcpy(&nodes[0], cursor, bytes);
+
+	// Load triangles
+	cursor += bytes;
+	bytes = sizeof(uint) * ranges[1];
+	triangles.resize(ranges[1]);
+	memcpy(&triangles[0], cursor, bytes);
+
+	// Traversal trusts every index, a corrupted file is rebuilt instead.
+	// Childs always come after their parent, so a valid tree has no cycles.
+	bool valid = true;
+	for (uint i = 0u; i < nodes.size() && valid; ++i)
+	{
+		const Node& node = nodes[i];
+		if (node.count == 0u)
+			valid = node.left_first > i && node.left_first + 1u < nodes.size();
+		else
+			valid = node.left_first < triangles.size() && node.count <= triangles.size() - node.left_first;
+	}
+
+	for (uint i = 0u; i < triangles.size() && valid; ++i)
+		valid = triangles[i] < triangle_count;
+
+	if (!valid)
+		Clear();
+
+	return valid;
+}
+
+// ---------------------------------------------
+void MeshBVH::Subdivide(uint node_index, const std::vector<AABB>& boxes, const std::vector<float3>& centers)
+{
+	uint first = nodes[node_index].left_first;
+	uint count = nodes[node_index].count;
+
+	AABB box = boxes[triangles[first]];
+	AABB center_box(centers[triangles[first]], centers[triangles[first]]);
+
+	for (uint i = first + 1u; i < first + count; ++i)
+	{
+		box.Enclose(boxes[triangles[i]]);
+		center_box.Enclose(centers[triangles[i]]);
+	}
+
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		nodes[node_index].min[axis] = box.minPoint[axis];
+		nodes[node_index].max[axis] = box.maxPoint[axis];
+	}
+
+	if (count <= MESH_BVH_LEAF_SIZE)
+		return;
+
+	// Binned SAH: cost of every split between bins along the 3 axis
+	float best_cost = FLOAT_INF;
+	int best_axis = -1;
+	uint best_split = 0u;
+	float3 extent = center_box.Size();
+
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		if (extent[axis] <= 0.f)
+			continue;
+
+		uint bin_counts[MESH_BVH_BINS] = {};
+		AABB bin_boxes[MESH_BVH_BINS];
+
+		float scale = (float)MESH_BVH_BINS / extent[axis];
+		for (uint i = first; i < first + count; ++i)
+		{
+			uint b = MIN((uint)((centers[triangles[i]][axis] - center_box.minPoint[axis]) * scale), MESH_BVH_BINS - 1u);
+
+			// Empty bins are never enclosed, their box is only valid once something fell in
+			if (bin_counts[b]++ == 0u)
+				bin_boxes[b] = boxes[triangles[i]];
+			else
+				bin_boxes[b].Enclose(boxes[triangles[i]]);
+		}
+
+		// Right side areas first, then the left side sweep evaluates every split
+		float right_areas[MESH_BVH_BINS];
+		uint right_counts[MESH_BVH_BINS];
+		AABB accumulated;
+		uint accumulated_count = 0u;
+
+		for (uint b = MESH_BVH_BINS - 1u; b > 0u; --b)
+		{
+			if (bin_counts[b] > 0u)
+			{
+				if (accumulated_count == 0u)
+					accumulated = bin_boxes[b];
+				else
+					accumulated.Enclose(bin_boxes[b]);
+				accumulated_count += bin_counts[b];
+			}
+			right_areas[b] = accumulated_count > 0u ? accumulated.SurfaceArea() : 0.f;
+			right_counts[b] = accumulated_count;
+		}
+
+		accumulated_count = 0u;
+
+		for (uint split = 1u; split < MESH_BVH_BINS; ++split)
+		{
+			if (bin_counts[split - 1u] > 0u)
+			{
+				if (accumulated_count == 0u)
+					accumulated = bin_boxes[split - 1u];
+				else
+					accumulated.Enclose(bin_boxes[split - 1u]);
+				accumulated_count += bin_counts[split - 1u];
+			}
+
+			if (accumulated_count == 0u || right_counts[split] == 0u)
+				continue;
+
+			float split_cost = accumulated.SurfaceArea() * accumulated_count + right_areas[split] * right_counts[split];
+
+			if (split_cost < best_cost) {
+				best_cost = split_cost;
+				best_axis = axis;
+				best_split = split;
+			}
+		}
+	}
+
+	float area = box.SurfaceArea();
+	bool split_pays = best_axis >= 0 && best_cost + area < area * count;
+
+	if (!split_pays && count <= MESH_BVH_MAX_LEAF_SIZE)
+		return;
+
+	uint middle = first + count / 2u;
+
+	if (best_axis >= 0)
+	{
+		float min_center = center_box.minPoint[best_axis];
+		float scale = (float)MESH_BVH_BINS / extent[best_axis];
+
+		std::vector<uint>::iterator it = std::partition(triangles.begin() + first, triangles.begin() + first + count, [&](uint triangle)
+		{
+			return MIN((uint)((centers[triangle][best_axis] - min_center) * scale), MESH_BVH_BINS - 1u) < best_split;
+		});
+
+		uint partition_point = it - triangles.begin();
+		if (partition_point > first && partition_point < first + count)
+			middle = partition_point;
+	}
+
+	// Same centers everywhere: halves in whatever order they are
+	uint left = nodes.size();
+	nodes.push_back(Node());
+	nodes.push_back(Node());
+
+	nodes[left].left_first = first;
+	nodes[left].count = middle - first;
+	nodes[left + 1u].left_first = middle;
+	nodes[left + 1u].count = first + count - middle;
+
+	nodes[node_index].left_first = left;
+	nodes[node_index].count = 0u;
+
+	Subdivide(left, boxes, centers);
+	Subdivide(left + 1u, boxes, centers);
+}
+
+// Moller-Trumbore through MathGeoLib, t along the normalized direction
+bool MeshBVH::IntersectTriangle(uint triangle, const float3& origin, const float3& dir, const float* vertices, const uint* indices, float& t) const
+{
+	const uint* index = &indices[triangle * 3u];
+	float u, v;
+
+	t = Triangle::IntersectLineTri(origin, dir, float3(&vertices[index[0] * 3u]), float3(&vertices[index[1] * 3u]), float3(&vertices[index[2] * 3u]), u, v);
+
+	return t >= 0.f && t != FLOAT_INF;
+}
@@ -0,0 +1,71 @@
+#ifndef __MESH_BVH_H__
+#define __MESH_BVH_H__
+
+#include "trDefs.h"
+#include "MathGeoLib/MathGeoLib.h"
+
+#include <vector>
+
+#define MESH_BVH_BINS 8					// SAH candidates per axis
+#define MESH_BVH_LEAF_SIZE 4			// never split below this
+#define MESH_BVH_MAX_LEAF_SIZE 16		// always split above this, even if SAH says otherwise
+
+struct MeshHit
+{
+	float distance = 0.f;			// normalized along the segment, 0 at a and 1 at b
+	float3 point = float3::zero;	// same space as the segment
+	uint triangle = 0u;				// its first index is triangle * 3
+};
+
+// Bounding volume hierarchy over the triangles of a mesh, built with the binned surface area
+// heuristic. The vertices and indices stay in the mesh, the tree only keeps the triangles
+// reordered so every leaf is a range of them. Nodes are 32 bytes, boxes are tested against
+// the ray with a single SSE slab test.
+class MeshBVH
+{
+public:
+
+	struct Node
+	{
+		float min[3];
+		uint left_first = 0u;	// first triangle for leafs, left child otherwise (right is left + 1)
+		float max[3];
+		uint count = 0u;		// 0 for inner nodes
+	};
+
+public:
+
+	MeshBVH();
+	~MeshBVH();
+
+	// Triangles pointing outside of the vertices are left out
+	void Build(const float* vertices, uint vertex_size, const uint* indices, uint index_size);
+	void Clear();
+	bool IsBuilt() const;
+
+	// Segment in the space of the vertices. Closest hit, nodes behind it are never visited.
+	bool RayCast(const LineSegment& segment, const float* vertices, const uint* indices, MeshHit& hit) const;
+
+	// Every hit, nearest first
+	uint RayCastAll(const LineSegment& segment, const float* vertices, const uint* indices, std::vector<MeshHit>& hits) const;
+
+	uint GetNodeCount() const;
+
+	// Library format: node count, triangle count, nodes, triangles
+	uint GetSerializedSize() const;
+	void Serialize(char* cursor) const;
+	// False if the data can't belong to a mesh of that many triangles or any index is out of range
+	bool Deserialize(const char* cursor, uint size, uint triangle_count);
+
+private:
+
+	void Subdivide(uint node_index, const std::vector<AABB>& boxes, const std::vector<float3>& centers);
+	bool IntersectTriangle(uint triangle, const float3& origin, const float3& dir, const float* vertices, const uint* indices, float& t) const;
+
+private:
+
+	std::vector<Node> nodes;
+	std::vector<uint> triangles;	// leafs point to ranges of it
+};
+
+#endif // __MESH_BVH_H__
@@ -97,11 +97,37 @@ void PanelConfiguration::ShowApplication()
 		
 		ImGui::TextColored(IMGUI_YELLOW, "%i", App->GetFpsCap());
 
+		bool fixed_timestep = App->IsFixedTimestep();
+		if (ImGui::Checkbox("Fixed timestep", &fixed_timestep))
+			App->SetFixedTimestep(fixed_timestep);
+
+		if (fixed_timestep) {
+			int tick_rate = App->GetTickRate();
+			if (ImGui::SliderInt("Tick rate", &tick_rate, 10, 240))
+				App->SetTickRate(tick_rate);
+
+			int max_steps = App->GetMaxCatchUpSteps();
+			if (ImGui::SliderInt("Max catch-up steps", &max_steps, 1, 20))
+				App->SetMaxCatchUpSteps(max_steps);
+
+			ImGui::Text("Interpolation:");
+			ImGui::SameLine();
+			ImGui::TextColored(IMGUI_YELLOW, "%.2f", App->GetInterpolationAlpha());
+		}
+
 		sprintf_s(title, 25, "Framerate %.1f", chart_fps.back());
 		ImGui::PlotHistogram("##framerate", &chart_fps.front(), chart_fps.size(), 0, title, 0.0f, 100.0f, ImVec2(400, 90));
 		sprintf_s(title, 25, "Milliseconds %0.1f", chart_ms.back());
 		ImGui::PlotHistogram("##milliseconds", &chart_ms.front(), chart_ms.size(), 0, title, 0.0f, 40.0f, ImVec2(400, 90));
 
+		const trFramePacer& pacer = App->GetFramePacer();
+		ImGui::Text("Frame time p50 / p95 / p99:");
+		ImGui::SameLine();
+		ImGui::TextColored(IMGUI_YELLOW, "%.1f / %.1f / %.1f ms", pacer.GetPercentileMs(0.5f), pacer.GetPercentileMs(0.95f), pacer.GetPercentileMs(0.99f));
+		ImGui::Text("Worst frame:");
+		ImGui::SameLine();
+		ImGui::TextColored(IMGUI_YELLOW, "%.2f ms", pacer.GetMaxFrameMs());
+
 		ImGui::Separator();
 		
 		CalculateReportedMemory();
@@ -76,7 +76,7 @@ void PanelHierarchy::DrawGameObject(GameObject * game_object)
 		{
 
 			if (ImGui::MenuItem("Remove"))
-				game_object->to_destroy = true;
+				App->main_scene->Destroy(game_object);
 
 			ImGui::EndPopup();
 		}
@@ -59,12 +59,8 @@ void PanelInspector::Draw()
 		ImGui::SameLine();
 
 		if (ImGui::Checkbox("Static##STATIC", &selected->is_static)) {
-			if (selected->is_static) {
+			if (selected->is_static)
 				App->main_scene->InsertGoInQuadtree(selected);
-			}
-			else {
-				App->main_scene->EraseGoInQuadtree(selected);
-			}
 		}
 
 		ImGui::Separator();
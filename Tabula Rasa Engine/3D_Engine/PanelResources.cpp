@@ -72,7 +72,7 @@ void PanelResources::DrawAssets(Directory* dir)
 				std::string extension;
 				App->file_system->GetExtensionFromFile(dir->files_vec[i].name.c_str(), extension);
 
-				if (ImGui::IsMouseDoubleClicked(0) && ImGui::IsItemClicked(0) && extension.compare(".trScene") == 0)
+				if (ImGui::IsMouseDoubleClicked(0) && ImGui::IsItemClicked(0) && (extension.compare(".trScene") == 0 || extension.compare(".trStream") == 0))
 					ImGui::OpenPopup("WARNING!");
 
 				ImGui::SetNextWindowSize(ImVec2(800.0f, 120.0f));
@@ -92,7 +92,16 @@ void PanelResources::DrawAssets(Directory* dir)
 						// TODO: import scene here (scene file is 'dir->files_vec[i]')
 
 						const char* curr_file = dir->files_vec[i].name.c_str();
-						App->file_loader->ImportScene(curr_file); // TODO: this has mem leaks
+						if (extension.compare(".trStream") == 0) {
+							std::string manifest_path(A_SCENES_DIR);
+							manifest_path.append("/");
+							manifest_path.append(curr_file);
+
+							App->main_scene->ClearScene();
+							App->main_scene->streamer.Open(manifest_path.c_str());
+						}
+						else
+							App->file_loader->ImportScene(curr_file); // TODO: this has mem leaks
 						import_clicked = false;
 						ImGui::CloseCurrentPopup();
 					}
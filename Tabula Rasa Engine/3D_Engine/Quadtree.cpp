@@ -2,8 +2,7 @@
 #include "trDefs.h"
 
 #include "GameObject.h"
-
-#define BUCKET_SIZE 6
+#include "trProfiler.h"
 
 Quadtree::Quadtree()
 {
@@ -14,286 +13,349 @@ Quadtree::~Quadtree()
 	RELEASE(root_node);
 }
 
-void Quadtree::Create(AABB limits)
+void Quadtree::Create(AABB limits, uint max_depth)
 {
+	std::vector<GameObject*> objects;
+	if (root_node != nullptr)
+		CollectObjects(root_node, objects);
+
+	RELEASE(root_node);
+	count = 0u;
+
+	this->max_depth = max_depth;
 	root_node = new QuadtreeNode(limits);
+
+	for (uint i = 0u; i < objects.size(); ++i)
+		Insert(objects[i]);
 }
 
 void Quadtree::Insert(GameObject * go)
 {
-	if (root_node != nullptr)
+	if (root_node == nullptr || go->quadtree_node != nullptr || go->HasComponent(Component::component_type::COMPONENT_BONE))
+		return;
+
+	const AABB& go_box = go->bounding_box;
+	QuadtreeNode* node = root_node;
+
+	// Down while it fits in a child, the childs are created on the way
+	if (Fits(root_node, go_box))
 	{
-		if (!go->FindComponentByType(Component::component_type::COMPONENT_BONE)) {
-			if (go->bounding_box.Intersects(root_node->box))
-				root_node->Insert(go);
+		float3 center = go_box.CenterPoint();
+
+		while (node->depth < max_depth && FitsInChild(node, go_box))
+		{
+			uint index = node->ChildIndex(center);
+			if (node->childs[index] == nullptr)
+				node->childs[index] = new QuadtreeNode(node->ChildBox(index), node, node->depth + 1u);
+
+			node = node->childs[index];
 		}
 	}
+
+	go->quadtree_node = node;
+	go->quadtree_slot = node->objects_inside.size();
+	node->objects_inside.push_back(go);
+	count++;
+}
+
+void Quadtree::Remove(GameObject * go)
+{
+	QuadtreeNode* node = go->quadtree_node;
+	if (node == nullptr)
+		return;
+
+	// The last one takes its place
+	std::vector<GameObject*>& objects = node->objects_inside;
+	GameObject* last = objects.back();
+	objects[go->quadtree_slot] = last;
+	last->quadtree_slot = go->quadtree_slot;
+	objects.pop_back();
+
+	go->quadtree_node = nullptr;
+	go->quadtree_slot = 0u;
+	count--;
+
+	Prune(node);
+}
+
+void Quadtree::Update(GameObject * go)
+{
+	QuadtreeNode* node = go->quadtree_node;
+	if (node == nullptr)
+		return;
+
+	const AABB& go_box = go->bounding_box;
+
+	// Still in its loose box and too big for a child: nothing to do
+	bool stays = false;
+	if (node == root_node && !Fits(root_node, go_box))
+		stays = true;
+	else if (Fits(node, go_box))
+		stays = node->depth == max_depth || !FitsInChild(node, go_box);
+
+	if (stays)
+		return;
+
+	Remove(go);
+	Insert(go);
+}
+
+uint Quadtree::GetCount() const
+{
+	return count;
 }
 
-void Quadtree::FillWithAABBs(std::vector<AABB>& vector)
+void Quadtree::FillWithAABBs(FrameVector<AABB>& vector)
 {
 	QuadtreeNode * node = root_node;
 
-	IterateToFillAABBs(node, vector);
+	if (node != nullptr)
+		IterateToFillAABBs(node, vector);
 }
 
-void Quadtree::IterateToFillAABBs(QuadtreeNode * node, std::vector<AABB>& vector)
+void Quadtree::IterateToFillAABBs(QuadtreeNode * node, FrameVector<AABB>& vector)
 {
 	vector.push_back(node->box);
 
-	if (node->childs[0] != nullptr) {
-		for (uint i = 0u; i < 4; i++)
+	for (uint i = 0u; i < 4; i++)
+	{
+		if (node->childs[i] != nullptr)
 			IterateToFillAABBs(node->childs[i], vector);
 	}
 }
 
-void Quadtree::CollectsGOs(const Frustum & frustum, std::vector<GameObject*>& go_output) const
+void Quadtree::CollectsGOs(const Frustum & frustum, FrameVector<GameObject*>& go_output, FrameVector<GameObject*>* candidates) const
 {
+	TR_PROFILE_SCOPE("Quadtree::CollectsGOs");
+
+	// Once per query instead of once per box
+	Plane planes[6];
+	frustum.GetPlanes(planes);
+
 	// Check it with root, then iterate
-	root_node->CollectsGOs(frustum, go_output);
+	if (root_node != nullptr)
+		root_node->CollectsGOs(planes, go_output, candidates);
 }
 
-void Quadtree::CollectIntersectingGOs(const LineSegment & line_segment, std::map<float, GameObject*>& intersect_map) const
+void Quadtree::CollectIntersectingGOs(const LineSegment & line_segment, FrameVector<std::pair<float, GameObject*>>& intersections) const
 {
-	root_node->CollectIntersectingGOs(line_segment, intersect_map);
+	if (root_node != nullptr)
+		root_node->CollectIntersectingGOs(line_segment, intersections);
+}
+
+void Quadtree::CollectAllGOs(FrameVector<GameObject*>& go_output) const
+{
+	if (root_node != nullptr)
+	{
+		go_output.reserve(go_output.size() + count);
+		root_node->CollectAllGOs(go_output);
+	}
 }
 
 void Quadtree::Clear()
 {
 	RELEASE(root_node);
+	count = 0u;
 }
 
-// ------------------------------------- NODE ---------------------------------------------------- \\
+// Center inside the node and not bigger than it, vertically inside the root
+bool Quadtree::Fits(const QuadtreeNode * node, const AABB & go_box) const
+{
+	float3 center = go_box.CenterPoint();
+	float3 size = go_box.Size();
+
+	return center.x >= node->box.minPoint.x && center.x <= node->box.maxPoint.x &&
+		center.z >= node->box.minPoint.z && center.z <= node->box.maxPoint.z &&
+		size.x <= node->box.Size().x && size.z <= node->box.Size().z &&
+		go_box.minPoint.y >= root_node->box.minPoint.y && go_box.maxPoint.y <= root_node->box.maxPoint.y;
+}
 
-QuadtreeNode::QuadtreeNode(AABB limit)
+bool Quadtree::FitsInChild(const QuadtreeNode * node, const AABB & go_box) const
 {
-	box = limit;
-	for (uint i = 0; i < 4; i++)
-		childs[i] = nullptr;
+	float3 size = go_box.Size();
+	float3 node_size = node->box.Size();
+
+	return size.x <= node_size.x * 0.5f && size.z <= node_size.z * 0.5f;
 }
 
-QuadtreeNode::~QuadtreeNode()
+void Quadtree::CollectObjects(QuadtreeNode * node, std::vector<GameObject*>& output) const
 {
-	objects_inside.clear();
-	if (childs[0] != nullptr) {
-		for (uint i = 0u; i < 4; i++)
-		{
-			childs[i]->objects_inside.clear();
-			RELEASE(childs[i]);
-		}
+	output.insert(output.end(), node->objects_inside.begin(), node->objects_inside.end());
+
+	for (uint i = 0u; i < 4; i++)
+	{
+		if (node->childs[i] != nullptr)
+			CollectObjects(node->childs[i], output);
 	}
-	
 }
 
-void QuadtreeNode::Insert(GameObject * go)
+// Empty leafs go away, up to the first node still in use
+void Quadtree::Prune(QuadtreeNode * node)
 {
-	objects_inside.push_back(go);
-
-	if (IsLeaf()) {
-		if (objects_inside.size() >= BUCKET_SIZE) {
-			GenerateChilds();
-			RedistributeObjects();
+	while (node != root_node && node->objects_inside.empty() && node->IsLeaf())
+	{
+		QuadtreeNode* parent = node->parent;
+		for (uint i = 0u; i < 4; i++)
+		{
+			if (parent->childs[i] == node)
+				parent->childs[i] = nullptr;
 		}
-	}
-	else {
-		RedistributeObjects();
+
+		RELEASE(node);
+		node = parent;
 	}
 }
 
-bool QuadtreeNode::IsLeaf() const
+// ------------------------------------- NODE ---------------------------------------------------- \\
+
+QuadtreeNode::QuadtreeNode(AABB limit, QuadtreeNode* parent, uint depth) : parent(parent), depth(depth)
 {
-	return (childs[0] == nullptr);
+	box = limit;
+	for (uint i = 0; i < 4; i++)
+		childs[i] = nullptr;
+
+	// Vertically as tall as the node, objects don't go down by height
+	float3 half_size = box.Size() * 0.5f;
+	half_size.y = 0.f;
+	loose_box = AABB(box.minPoint - half_size, box.maxPoint + half_size);
 }
 
-void QuadtreeNode::GenerateChilds()
+QuadtreeNode::~QuadtreeNode()
 {
-	// Setting up
-	float3 min_point = box.minPoint;
-	float3 max_point = box.maxPoint;
-	float width = math::Abs(min_point.x - max_point.x);
-	float height = math::Abs(min_point.y - max_point.y);
-	float depth = math::Abs(min_point.z - max_point.z);
-
-	/*
-		 __ __ __ __
-		| CH1 | CH2	|
-		|__ __|__ __|
-		| CH3 |	CH4 |
-		|__ __|__ __|
-
-	*/
-
-	// CH1
-	float3 min_point_child = min_point;
-	float3 max_point_child = min_point;
-	max_point_child.x += width / 2.f;
-	max_point_child.y += height;
-	max_point_child.z += depth / 2.f;
-	AABB child_box = AABB(min_point_child, max_point_child);
-	childs[0] = new QuadtreeNode(child_box);
-
-	// CH2
-	min_point_child.x += width / 2.f;
-	max_point_child.x += width / 2.f;
-	child_box = AABB(min_point_child, max_point_child);
-	childs[1] = new QuadtreeNode(child_box);
-
-	// CH3
-	min_point_child.x -= width / 2.f;
-	max_point_child.x -= width / 2.f;
-	min_point_child.z += depth / 2.f;
-	max_point_child.z += depth / 2.f;
-	child_box = AABB(min_point_child, max_point_child);
-	childs[2] = new QuadtreeNode(child_box);
-
-	// CH4
-	min_point_child.x += width / 2.f;
-	max_point_child.x += width / 2.f;
-	child_box = AABB(min_point_child, max_point_child);
-	childs[3] = new QuadtreeNode(child_box);
+	// Not indexed anymore
+	for (uint i = 0u; i < objects_inside.size(); i++)
+		objects_inside[i]->quadtree_node = nullptr;
+
+	for (uint i = 0u; i < 4; i++)
+		RELEASE(childs[i]);
 }
 
-void QuadtreeNode::RedistributeObjects()
+bool QuadtreeNode::IsLeaf() const
 {
-	// Now redistribute ALL objects
-	for (std::list<GameObject*>::iterator it = objects_inside.begin(); it != objects_inside.end();)
-	{
-		GameObject* go = *it;
-
-		AABB new_box(go->bounding_box);
+	return childs[0] == nullptr && childs[1] == nullptr && childs[2] == nullptr && childs[3] == nullptr;
+}
 
-		// Now distribute this new gameobject onto the childs
-		bool intersects[4];
-		for (int i = 0; i < 4; ++i)
-			intersects[i] = childs[i]->box.Intersects(new_box);
+/*
+	 __ __ __ __
+	| CH1 | CH2	|
+	|__ __|__ __|
+	| CH3 |	CH4 |
+	|__ __|__ __|
 
-		if (intersects[0] && intersects[1] && intersects[2] && intersects[3])
-			++it; // if it hits all childs, better to just keep it here
-		else
-		{
-			it = objects_inside.erase(it);
-			for (int i = 0; i < 4; ++i)
-				if (intersects[i]) childs[i]->Insert(go);
-		}
-	}
+*/
+uint QuadtreeNode::ChildIndex(const float3 & point) const
+{
+	float3 center = box.CenterPoint();
 
-	/*for (std::list<GameObject*>::iterator it = objects_inside.begin(); it != objects_inside.end(); it++) {
-		GameObject* go = (*it);
-		uint childs_hit = 0u;
-		for (uint j = 0u; j < 4; j++)
-		{
-			if (go->bounding_box.Intersects(childs[j]->box))
-				childs_hit++;
-		}
+	uint index = 0u;
+	if (point.x > center.x)
+		index += 1u;
+	if (point.z > center.z)
+		index += 2u;
 
-		if (childs_hit == 4) { // hit all childs, dont redistribute
-			continue;
-		}
-		else {
-			it = objects_inside.erase(it);
-			for (uint j = 0u; j < 4; j++)
-			{
-				if (go->bounding_box.Intersects(childs[j]->box))
-					childs[j]->Insert(go);
-			}
-		}
-	}*/
+	return index;
 }
 
-void QuadtreeNode::CollectsGOs(const Frustum & frustum, std::vector<GameObject*>& go_output) const
+AABB QuadtreeNode::ChildBox(uint index) const
 {
-	//check if the node's box intersects with the frustum
-	if (FrustumContainsAaBox(this->box, frustum)) {
+	float3 half_size = box.Size() * 0.5f;
 
-		for (std::list<GameObject*>::const_iterator it = objects_inside.begin(); it != objects_inside.end(); it++) {
+	float3 min_point_child = box.minPoint;
+	if (index & 1u)
+		min_point_child.x += half_size.x;
+	if (index & 2u)
+		min_point_child.z += half_size.z;
 
-			AABB go_box = (*it)->bounding_box;
-			if (FrustumContainsAaBox(this->box, frustum)) { //if one game object of the node is in the frustum, collect it
+	float3 max_point_child = min_point_child + float3(half_size.x, box.Size().y, half_size.z);
 
-				bool unique = true;
-				for (uint i = 0; i < go_output.size(); i++)
-				{
-					if ((*it) == go_output.at(i))
-						unique = false;
-				}
+	return AABB(min_point_child, max_point_child);
+}
 
-				if(unique) // care iterating childs with the same gos
-					go_output.push_back((*it));
-			}
+void QuadtreeNode::CollectsGOs(const Plane* planes, FrameVector<GameObject*>& go_output, FrameVector<GameObject*>* candidates) const
+{
+	// The root also holds what fits nowhere, it is never culled
+	if (parent != nullptr)
+	{
+		frustum_test test = TestAaBox(loose_box, planes);
 
-		}
+		if (test == FRUSTUM_OUTSIDE)
+			return;
 
-		if (!IsLeaf()) {
-			for (uint i = 0u; i < 4; i++)
-			{
-				childs[i]->CollectsGOs(frustum, go_output);
-			}
+		// Every object below is inside the loose box
+		if (test == FRUSTUM_INSIDE) {
+			CollectAllGOs(go_output);
+			return;
 		}
-
 	}
-}
 
-void QuadtreeNode::CollectIntersectingGOs(const LineSegment & line_segment, std::map<float, GameObject*>& intersect_map) const
-{
-	// As we use a map with hit distance value as key it is already ordered in ascending order by default.
-	// This means the gameobjects are already sorted by their AABBs distance to the camera.
-	if (line_segment.Intersects(this->box)) 
+	// Single owner, no need to check for duplicates
+	if (candidates != nullptr)
+		candidates->insert(candidates->end(), objects_inside.begin(), objects_inside.end());
+	else
 	{
-		for (std::list<GameObject*>::const_iterator it = objects_inside.begin(); it != objects_inside.end(); it++) 
+		for (uint i = 0u; i < objects_inside.size(); i++)
 		{
-			AABB go_box = (*it)->bounding_box;
-			float hit_distance;
-			float out_distance;
-			if (line_segment.Intersects(go_box, hit_distance, out_distance))
-			{ 
-				bool unique = true;
-
-				for (std::map<float, GameObject*>::iterator it_map = intersect_map.begin(); it_map != intersect_map.end(); it_map++)
-				{
-					if ((*it) == (*it_map).second)
-						unique = false;
-				}
-
-				if (unique) // care iterating childs with the same gos
-					intersect_map.insert(std::pair<float, GameObject*>(hit_distance, *it));
-			}
+			if (TestAaBox(objects_inside[i]->bounding_box, planes) != FRUSTUM_OUTSIDE)
+				go_output.push_back(objects_inside[i]);
 		}
+	}
 
-		if (!IsLeaf()) 
-		{
-			for (uint i = 0u; i < 4; i++)
-				childs[i]->CollectIntersectingGOs(line_segment, intersect_map);
-			
-		}
+	for (uint i = 0u; i < 4; i++)
+	{
+		if (childs[i] != nullptr)
+			childs[i]->CollectsGOs(planes, go_output, candidates);
 	}
+}
 
+void QuadtreeNode::CollectAllGOs(FrameVector<GameObject*>& go_output) const
+{
+	go_output.insert(go_output.end(), objects_inside.begin(), objects_inside.end());
+
+	for (uint i = 0u; i < 4; i++)
+	{
+		if (childs[i] != nullptr)
+			childs[i]->CollectAllGOs(go_output);
+	}
 }
 
-bool QuadtreeNode::FrustumContainsAaBox(const AABB & ref_box, const Frustum & frustum) const
+void QuadtreeNode::CollectIntersectingGOs(const LineSegment & line_segment, FrameVector<std::pair<float, GameObject*>>& intersections) const
 {
-	float3 aabb_corners[8];
-	int total_in = 0;
-	ref_box.GetCornerPoints(aabb_corners);
+	if (parent != nullptr && !line_segment.Intersects(loose_box))
+		return;
 
-	for (int p = 0; p < 6; ++p) { // Planes of the frustum
-		int corners_outside = 8;
-		int point_in = 1;
+	for (uint i = 0u; i < objects_inside.size(); i++)
+	{
+		float hit_distance;
+		float out_distance;
+		if (line_segment.Intersects(objects_inside[i]->bounding_box, hit_distance, out_distance))
+			intersections.push_back(std::pair<float, GameObject*>(hit_distance, objects_inside[i]));
+	}
 
-		for (int i = 0; i < 8; ++i) { // each corner of the AABB
+	for (uint i = 0u; i < 4; i++)
+	{
+		if (childs[i] != nullptr)
+			childs[i]->CollectIntersectingGOs(line_segment, intersections);
+	}
+}
 
-			if (frustum.GetPlane(p).IsOnPositiveSide(aabb_corners[i])) {
-				point_in = 0;
-				--corners_outside;
-			}
-		}
+frustum_test QuadtreeNode::TestAaBox(const AABB & ref_box, const Plane * planes)
+{
+	float3 center = ref_box.CenterPoint();
+	float3 half_size = ref_box.HalfSize();
+	frustum_test result = FRUSTUM_INSIDE;
+
+	for (uint p = 0u; p < 6u; ++p) // positive side of the planes is outside
+	{
+		const float3& normal = planes[p].normal;
+		float radius = Abs(normal.x) * half_size.x + Abs(normal.y) * half_size.y + Abs(normal.z) * half_size.z;
+		float distance = normal.Dot(center) - planes[p].d;
 
-		if (corners_outside == 0) // totally in
-			return false;
+		if (distance - radius > 0.f) // even the nearest corner is out
+			return FRUSTUM_OUTSIDE;
 
-		total_in += point_in;
+		if (distance + radius > 0.f)
+			result = FRUSTUM_INTERSECTS;
 	}
-	//if (iTotalIn == 6)// TODO: maybe is usefull ...
-	//return true;
 
-	return true;
+	return result;
 }
@@ -2,38 +2,56 @@
 #define __QUAD_TREE_H__
 
 #include "MathGeoLib/MathGeoLib.h"
+#include "trFrameAllocator.h"
 
 #include <list>
 #include <map>
+#include <vector>
+
+#define QUADTREE_MAX_DEPTH 8
 
 class GameObject;
 
+enum frustum_test {
+	FRUSTUM_OUTSIDE,
+	FRUSTUM_INTERSECTS,
+	FRUSTUM_INSIDE
+};
+
+// Loose node: it holds the objects whose center is inside its box and whose size fits it,
+// so they are always inside the box grown by half its size on each side (XZ).
 class QuadtreeNode {
 
 	// Constructor
 public:
-	QuadtreeNode(AABB limit);
+	QuadtreeNode(AABB limit, QuadtreeNode* parent = nullptr, uint depth = 0u);
 	~QuadtreeNode();
 
-	void Insert(GameObject* go);
 	bool IsLeaf() const;
-	void GenerateChilds();
-	void RedistributeObjects();
+	uint ChildIndex(const float3& point) const;
+	AABB ChildBox(uint index) const;
 
 	// Intersections stuff
-	void CollectsGOs(const Frustum& frustum, std::vector<GameObject*>& go_output)const;
-	void CollectIntersectingGOs(const LineSegment& line_segment, std::map<float, GameObject*>& intersect_map) const;
-
-	bool FrustumContainsAaBox(const AABB & ref_box, const Frustum& frustum)const;
+	void CollectsGOs(const Plane* planes, FrameVector<GameObject*>& go_output, FrameVector<GameObject*>* candidates)const;
+	void CollectAllGOs(FrameVector<GameObject*>& go_output)const;
+	void CollectIntersectingGOs(const LineSegment& line_segment, FrameVector<std::pair<float, GameObject*>>& intersections) const;
 
+	// Against the 6 planes of a frustum, two corners per plane (the nearest and farthest along its normal)
+	static frustum_test TestAaBox(const AABB& ref_box, const Plane* planes);
 
 public:
 	AABB box;
+	AABB loose_box;
 	QuadtreeNode* parent = nullptr;
 	QuadtreeNode* childs[4];
-	std::list<GameObject*> objects_inside;
+	std::vector<GameObject*> objects_inside;
+	uint depth = 0u;
 };
 
+// Every object lives in a single node, picked from its box center and size. Childs are created
+// when an object needs them and removed once empty. Static and dynamic objects share it: a moved
+// object only changes node if it left the loose box of its node, no rebuilds.
+// Objects that don't fit the root (outside of it or too big) stay in the root, which is never culled.
 class Quadtree {
 
 	// Constructor
@@ -44,23 +62,44 @@ public:
 	// Operations
 public:
 
-	void Create(AABB limits);
+	// Objects already inside are kept and placed again
+	void Create(AABB limits, uint max_depth = QUADTREE_MAX_DEPTH);
 	void Insert(GameObject* go);
+	void Remove(GameObject* go); // O(1), the object knows its slot
 
-	void FillWithAABBs(std::vector<AABB>& vector);
-	void IterateToFillAABBs(QuadtreeNode* node, std::vector<AABB>& vector);
+	// O(depth) after the box of the object changed, O(1) while it stays in its node
+	void Update(GameObject* go);
 
-	// Intersection stuff
-	void CollectsGOs(const Frustum& frustum, std::vector<GameObject*>& go_output) const;
-	void CollectIntersectingGOs(const LineSegment& line_segment, std::map<float, GameObject*>& intersect_map) const;
+	uint GetCount() const;
 
+	void FillWithAABBs(FrameVector<AABB>& vector);
+	void IterateToFillAABBs(QuadtreeNode* node, FrameVector<AABB>& vector);
+
+	// Intersection stuff. Nodes fully inside the frustum are taken whole, no test per object.
+	// With candidates, the objects of nodes crossing the frustum go there untested (for a batched test).
+	void CollectsGOs(const Frustum& frustum, FrameVector<GameObject*>& go_output, FrameVector<GameObject*>* candidates = nullptr) const;
+	void CollectIntersectingGOs(const LineSegment& line_segment, FrameVector<std::pair<float, GameObject*>>& intersections) const;
+	// Every object, no node test
+	void CollectAllGOs(FrameVector<GameObject*>& go_output) const;
+
+	// Forgets every object
 	void Clear();
 
+private:
+
+	bool Fits(const QuadtreeNode* node, const AABB& go_box) const;
+	bool FitsInChild(const QuadtreeNode* node, const AABB& go_box) const;
+	void CollectObjects(QuadtreeNode* node, std::vector<GameObject*>& output) const;
+	void Prune(QuadtreeNode* node);
 
 public:
 	QuadtreeNode* root_node = nullptr;
 
+private:
+	uint max_depth = QUADTREE_MAX_DEPTH;
+	uint count = 0u;
+
 };
 
 
-#endif // __QUAD_TREE_H__
\ No newline at end of file
+#endif // __QUAD_TREE_H__
@@ -56,10 +56,11 @@ bool Resource::IsLoadedToMemory() const
 
 uint Resource::LoadToMemory()
 {
-	if (LoadInMemory())
-		references++;
-	else
-		references++;
+	// Shared, only the first user loads it
+	if (references == 0u)
+		LoadInMemory();
+
+	references++;
 	return references;
 }
 
@@ -70,11 +71,12 @@ uint Resource::CountReferences() const
 
 void Resource::Release()
 {
-	references--;
-	if (references <= 0) {
-		references = 0;
+	if (references > 0u)
+		references--;
+
+	// Only the last user frees it
+	if (references == 0u) {
 		ReleaseMemory();
+		App->resources->Delete(this);
 	}
-
-	App->resources->Delete(this);
 }
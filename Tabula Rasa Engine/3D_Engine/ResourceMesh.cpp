@@ -1,6 +1,7 @@
 #include "ResourceMesh.h"
 
 #include "trOpenGL.h"
+#include "trApp.h"
 
 ResourceMesh::ResourceMesh(UID uid) : Resource(uid, Resource::Type::MESH)
 {
@@ -15,13 +16,19 @@ ResourceMesh::~ResourceMesh()
 
 	path.clear();
 
-	glDeleteBuffers(1, (GLuint*)&index_buffer);
-	glDeleteBuffers(1, (GLuint*)&vertex_buffer);
-	glDeleteBuffers(1, (GLuint*)&uv_buffer);
+	if (!App->IsHeadless()) {
+		glDeleteBuffers(1, (GLuint*)&index_buffer);
+		glDeleteBuffers(1, (GLuint*)&vertex_buffer);
+		glDeleteBuffers(1, (GLuint*)&uv_buffer);
+	}
 }
 
 void ResourceMesh::GenerateAndBindMesh(bool deformable)
 {
+	// CPU data is enough without a GL context
+	if (App->IsHeadless())
+		return;
+
 	if (vertex_buffer == 0) {
 		vertex_buffer = 1;
 		uv_buffer = 2;
@@ -53,6 +60,9 @@ bool ResourceMesh::LoadInMemory()
 
 bool ResourceMesh::ReleaseMemory()
 {
+	if (App->IsHeadless())
+		return true;
+
 	glDeleteBuffers(1, (GLuint*)&index_buffer);
 	glDeleteBuffers(1, (GLuint*)&vertex_buffer);
 	glDeleteBuffers(1, (GLuint*)&uv_buffer);
@@ -86,3 +96,32 @@ void ResourceMesh::DuplicateMesh(ResourceMesh * mesh)
 	}
 		
 }
+
+void ResourceMesh::RecalculateLocalAABB()
+{
+	local_aabb.SetNegativeInfinity();
+
+	if (vertices != nullptr)
+		local_aabb.Enclose((float3*)vertices, vertex_size / 3);
+}
+
+void ResourceMesh::BuildTriangleBVH()
+{
+	triangle_bvh.Build(vertices, vertex_size, indices, index_size);
+}
+
+bool ResourceMesh::RayCast(const LineSegment & segment, MeshHit & hit)
+{
+	if (!triangle_bvh.IsBuilt())
+		BuildTriangleBVH();
+
+	return triangle_bvh.RayCast(segment, vertices, indices, hit);
+}
+
+uint ResourceMesh::RayCastAll(const LineSegment & segment, std::vector<MeshHit>& hits)
+{
+	if (!triangle_bvh.IsBuilt())
+		BuildTriangleBVH();
+
+	return triangle_bvh.RayCastAll(segment, vertices, indices, hits);
+}
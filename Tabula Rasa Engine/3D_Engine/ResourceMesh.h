@@ -2,6 +2,8 @@
 #define __RESOURCE_MESH_H__
 
 #include "Resource.h"
+#include "MathGeoLib/MathGeoLib.h"
+#include "MeshBVH.h"
 
 class ResourceMesh : public Resource
 {
@@ -16,6 +18,14 @@ public:
 	bool ReleaseMemory() override;
 	void DuplicateMesh(ResourceMesh* mesh);
 
+	// Called once the vertices are set
+	void RecalculateLocalAABB();
+
+	// Segment in object space. The triangle BVH comes from the Library, or is built on the first call.
+	bool RayCast(const LineSegment& segment, MeshHit& hit);
+	uint RayCastAll(const LineSegment& segment, std::vector<MeshHit>& hits);
+	void BuildTriangleBVH();
+
 public:
 	std::string path;
 
@@ -39,6 +49,12 @@ public:
 
 	UID texture_uuid = 0u;
 
+	// Object space, world boxes are built from it
+	AABB local_aabb = AABB(float3::zero, float3::zero);
+
+	// Saved after the normals in the Library
+	MeshBVH triangle_bvh;
+
 	ResourceMesh* deformable = nullptr;
 
 };
@@ -26,6 +26,10 @@ bool ResourceTexture::LoadInMemory()
 
 bool ResourceTexture::ReleaseMemory()
 {
-	App->resources->material_importer->DeleteTextureBuffer(this);
+	// Without the importer DevIL never loaded this image, and after CleanUp it is already shut down
+	MaterialImporter* importer = App->resources->FindMaterialImporter();
+	if (importer != nullptr)
+		importer->DeleteTextureBuffer(this);
+
 	return true;
 }
@@ -0,0 +1,480 @@
+// ----------------------------------------------------
+// SceneBVH.cpp
+// SAH bounding volume hierarchy of the scene objects
+// ----------------------------------------------------
+
+#include "SceneBVH.h"
+#include "trApp.h"
+#include "GameObject.h"
+#include "Quadtree.h"
+#include "trProfiler.h"
+
+#include <algorithm>
+
+// Empty boxes (meshes without resource) are infinite the wrong way round, Enclose can't take them
+static inline void Grow(AABB& box, const AABB& other)
+{
+	if (other.IsFinite())
+		box.Enclose(other);
+}
+
+SceneBVH::SceneBVH()
+{}
+
+SceneBVH::~SceneBVH()
+{}
+
+// ---------------------------------------------
+void SceneBVH::Insert(GameObject * go)
+{
+	if (go->bvh_slot != BVH_NO_SLOT)
+		return;
+
+	go->bvh_slot = objects.size();
+	objects.push_back(go);
+	changed = true;
+}
+
+void SceneBVH::Remove(GameObject * go)
+{
+	uint slot = go->bvh_slot;
+	if (slot == BVH_NO_SLOT)
+		return;
+
+	// Skipped by the queries until the next build
+	objects[slot] = nullptr;
+	go->bvh_slot = BVH_NO_SLOT;
+
+	if (slot < built_count)
+		removed_count++;
+	changed = true;
+}
+
+void SceneBVH::Update(GameObject * go)
+{
+	if (go->bvh_slot >= built_count)
+		return;
+
+	// The leaf and every ancestor not queued yet by another object
+	uint index = leafs[go->bvh_slot];
+	while (!nodes[index].refit)
+	{
+		nodes[index].refit = true;
+		refit_nodes.push_back(index);
+
+		if (index == 0u)
+			break;
+		index = nodes[index].parent;
+	}
+
+	changed = true;
+}
+
+// ---------------------------------------------
+void SceneBVH::Refresh()
+{
+	if (!changed)
+		return;
+
+	TR_PROFILE_SCOPE("SceneBVH::Refresh");
+
+	changed = false;
+	uint pending = objects.size() - built_count;
+
+	if (pending > MAX((uint)BVH_MIN_PENDING, built_count / 8u) || removed_count > built_count / 4u)
+		Build();
+	else if (!refit_nodes.empty())
+	{
+		Refit();
+
+		// Objects moved far from where they were grouped
+		if (cost > build_cost * BVH_REBUILD_RATIO)
+			Build();
+	}
+}
+
+void SceneBVH::Build()
+{
+	TR_PROFILE_SCOPE("SceneBVH::Build");
+
+	// Removed slots go away
+	uint live = 0u;
+	for (uint i = 0u; i < objects.size(); ++i)
+	{
+		if (objects[i] != nullptr) {
+			objects[i]->bvh_slot = live;
+			objects[live++] = objects[i];
+		}
+	}
+	objects.resize(live);
+
+	std::vector<AABB> boxes(live);
+	std::vector<float3> centers(live);
+	order.resize(live);
+
+	for (uint i = 0u; i < live; ++i)
+	{
+		boxes[i] = objects[i]->bounding_box;
+		centers[i] = boxes[i].IsFinite() ? boxes[i].CenterPoint() : float3::zero;
+		order[i] = i;
+	}
+
+	// Never more than 2n - 1 nodes
+	nodes.clear();
+	nodes.reserve(MAX(1u, live * 2u));
+
+	Node root;
+	root.first = 0u;
+	root.count = live;
+	nodes.push_back(root);
+
+	Subdivide(0u, boxes, centers);
+
+	// Leaf of every slot, for the partial refits
+	leafs.resize(live);
+	for (uint i = 0u; i < nodes.size(); ++i)
+	{
+		if (nodes[i].left != 0u) {
+			nodes[nodes[i].left].parent = nodes[nodes[i].left + 1u].parent = i;
+			continue;
+		}
+
+		for (uint k = nodes[i].first; k < nodes[i].first + nodes[i].count; ++k)
+			leafs[order[k]] = i;
+	}
+
+	built_count = live;
+	removed_count = 0u;
+	refit_nodes.clear();
+
+	build_cost = cost = CalculateCost();
+	build_count++;
+}
+
+void SceneBVH::Refit()
+{
+	TR_PROFILE_SCOPE("SceneBVH::Refit");
+
+	// Childs are always after their parent: higher indices first is bottom-up
+	std::sort(refit_nodes.begin(), refit_nodes.end());
+
+	for (uint i = refit_nodes.size(); i > 0u; --i)
+	{
+		Node& node = nodes[refit_nodes[i - 1u]];
+		node.refit = false;
+		cost_sum -= NodeCost(node);
+
+		AABB box;
+		box.SetNegativeInfinity();
+
+		if (node.left == 0u)
+		{
+			for (uint k = node.first; k < node.first + node.count; ++k)
+			{
+				if (objects[order[k]] != nullptr)
+					Grow(box, objects[order[k]]->bounding_box);
+			}
+		}
+		else
+		{
+			Grow(box, nodes[node.left].box);
+			Grow(box, nodes[node.left + 1u].box);
+		}
+
+		node.box = box;
+		cost_sum += NodeCost(node);
+	}
+
+	refit_nodes.clear();
+
+	float root_area = nodes[0].box.IsFinite() ? nodes[0].box.SurfaceArea() : 0.f;
+	cost = root_area > 0.f ? cost_sum / root_area : 0.f;
+}
+
+void SceneBVH::Clear()
+{
+	for (uint i = 0u; i < objects.size(); ++i)
+	{
+		if (objects[i] != nullptr)
+			objects[i]->bvh_slot = BVH_NO_SLOT;
+	}
+
+	objects.clear();
+	order.clear();
+	nodes.clear();
+	leafs.clear();
+	refit_nodes.clear();
+
+	built_count = removed_count = 0u;
+	changed = false;
+	build_cost = cost = cost_sum = 0.f;
+}
+
+// ---------------------------------------------
+void SceneBVH::CollectsGOs(const Frustum & frustum, FrameVector<GameObject*>& go_output, FrameVector<GameObject*>* candidates) const
+{
+	TR_PROFILE_SCOPE("SceneBVH::CollectsGOs");
+
+	Plane planes[6];
+	frustum.GetPlanes(planes);
+
+	if (!nodes.empty())
+	{
+		FrameVector<uint> stack(App->frame_allocator);
+		stack.push_back(0u);
+
+		while (!stack.empty())
+		{
+			const Node& node = nodes[stack.back()];
+			stack.pop_back();
+
+			frustum_test test = QuadtreeNode::TestAaBox(node.box, planes);
+			if (test == FRUSTUM_OUTSIDE)
+				continue;
+
+			// The whole range is inside, or a leaf to test one by one
+			if (test == FRUSTUM_INSIDE || node.left == 0u)
+			{
+				FrameVector<GameObject*>& output = test != FRUSTUM_INSIDE && candidates != nullptr ? *candidates : go_output;
+				bool test_each = test != FRUSTUM_INSIDE && candidates == nullptr;
+
+				for (uint k = node.first; k < node.first + node.count; ++k)
+				{
+					GameObject* go = objects[order[k]];
+					if (go != nullptr && (!test_each || QuadtreeNode::TestAaBox(go->bounding_box, planes) != FRUSTUM_OUTSIDE))
+						output.push_back(go);
+				}
+				continue;
+			}
+
+			stack.push_back(node.left);
+			stack.push_back(node.left + 1u);
+		}
+	}
+
+	// Inserted after the last build
+	for (uint i = built_count; i < objects.size(); ++i)
+	{
+		if (objects[i] == nullptr)
+			continue;
+
+		if (candidates != nullptr)
+			candidates->push_back(objects[i]);
+		else if (QuadtreeNode::TestAaBox(objects[i]->bounding_box, planes) != FRUSTUM_OUTSIDE)
+			go_output.push_back(objects[i]);
+	}
+}
+
+void SceneBVH::CollectIntersectingGOs(const LineSegment & line_segment, FrameVector<std::pair<float, GameObject*>>& intersections) const
+{
+	float hit_distance;
+	float out_distance;
+
+	if (!nodes.empty())
+	{
+		FrameVector<uint> stack(App->frame_allocator);
+		stack.push_back(0u);
+
+		while (!stack.empty())
+		{
+			const Node& node = nodes[stack.back()];
+			stack.pop_back();
+
+			if (!line_segment.Intersects(node.box))
+				continue;
+
+			if (node.left != 0u) {
+				stack.push_back(node.left);
+				stack.push_back(node.left + 1u);
+				continue;
+			}
+
+			for (uint k = node.first; k < node.first + node.count; ++k)
+			{
+				GameObject* go = objects[order[k]];
+				if (go != nullptr && line_segment.Intersects(go->bounding_box, hit_distance, out_distance))
+					intersections.push_back(std::pair<float, GameObject*>(hit_distance, go));
+			}
+		}
+	}
+
+	for (uint i = built_count; i < objects.size(); ++i)
+	{
+		if (objects[i] != nullptr && line_segment.Intersects(objects[i]->bounding_box, hit_distance, out_distance))
+			intersections.push_back(std::pair<float, GameObject*>(hit_distance, objects[i]));
+	}
+}
+
+void SceneBVH::CollectAllGOs(FrameVector<GameObject*>& go_output) const
+{
+	go_output.reserve(go_output.size() + GetCount());
+
+	for (uint i = 0u; i < objects.size(); ++i)
+	{
+		if (objects[i] != nullptr)
+			go_output.push_back(objects[i]);
+	}
+}
+
+// ---------------------------------------------
+uint SceneBVH::GetCount() const
+{
+	return objects.size() - removed_count;
+}
+
+uint SceneBVH::GetNodeCount() const
+{
+	return nodes.size();
+}
+
+uint SceneBVH::GetBuildCount() const
+{
+	return build_count;
+}
+
+float SceneBVH::GetCost() const
+{
+	return cost;
+}
+
+// ---------------------------------------------
+void SceneBVH::Subdivide(uint node_index, const std::vector<AABB>& boxes, const std::vector<float3>& centers)
+{
+	uint first = nodes[node_index].first;
+	uint count = nodes[node_index].count;
+
+	AABB box, center_box;
+	box.SetNegativeInfinity();
+	center_box.SetNegativeInfinity();
+
+	for (uint i = first; i < first + count; ++i)
+	{
+		Grow(box, boxes[order[i]]);
+		center_box.Enclose(centers[order[i]]);
+	}
+	nodes[node_index].box = box;
+
+	if (count <= BVH_LEAF_SIZE)
+		return;
+
+	// Binned SAH: cost of every split between bins along the 3 axis
+	float best_cost = FLOAT_INF;
+	int best_axis = -1;
+	uint best_split = 0u;
+	float3 extent = center_box.Size();
+
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		if (extent[axis] <= 0.f)
+			continue;
+
+		uint bin_counts[BVH_BINS] = {};
+		AABB bin_boxes[BVH_BINS];
+		for (uint b = 0u; b < BVH_BINS; ++b)
+			bin_boxes[b].SetNegativeInfinity();
+
+		float scale = (float)BVH_BINS / extent[axis];
+		for (uint i = first; i < first + count; ++i)
+		{
+			uint b = MIN((uint)((centers[order[i]][axis] - center_box.minPoint[axis]) * scale), BVH_BINS - 1u);
+			bin_counts[b]++;
+			Grow(bin_boxes[b], boxes[order[i]]);
+		}
+
+		// Right side areas first, then the left side sweep evaluates every split
+		float right_areas[BVH_BINS];
+		uint right_counts[BVH_BINS];
+		AABB accumulated;
+		accumulated.SetNegativeInfinity();
+		uint accumulated_count = 0u;
+
+		for (uint b = BVH_BINS - 1u; b > 0u; --b)
+		{
+			Grow(accumulated, bin_boxes[b]);
+			accumulated_count += bin_counts[b];
+			right_areas[b] = accumulated.IsFinite() ? accumulated.SurfaceArea() : 0.f;
+			right_counts[b] = accumulated_count;
+		}
+
+		accumulated.SetNegativeInfinity();
+		accumulated_count = 0u;
+
+		for (uint split = 1u; split < BVH_BINS; ++split)
+		{
+			Grow(accumulated, bin_boxes[split - 1u]);
+			accumulated_count += bin_counts[split - 1u];
+
+			if (accumulated_count == 0u || right_counts[split] == 0u)
+				continue;
+
+			float left_area = accumulated.IsFinite() ? accumulated.SurfaceArea() : 0.f;
+			float split_cost = left_area * accumulated_count + right_areas[split] * right_counts[split];
+
+			if (split_cost < best_cost) {
+				best_cost = split_cost;
+				best_axis = axis;
+				best_split = split;
+			}
+		}
+	}
+
+	float area = box.IsFinite() ? box.SurfaceArea() : 0.f;
+	bool split_pays = best_axis >= 0 && best_cost + area < area * count;
+
+	if (!split_pays && count <= BVH_MAX_LEAF_SIZE)
+		return;
+
+	uint middle = first + count / 2u;
+
+	if (best_axis >= 0)
+	{
+		float min_center = center_box.minPoint[best_axis];
+		float scale = (float)BVH_BINS / extent[best_axis];
+
+		std::vector<uint>::iterator it = std::partition(order.begin() + first, order.begin() + first + count, [&](uint slot)
+		{
+			return MIN((uint)((centers[slot][best_axis] - min_center) * scale), BVH_BINS - 1u) < best_split;
+		});
+
+		uint partition_point = it - order.begin();
+		if (partition_point > first && partition_point < first + count)
+			middle = partition_point;
+	}
+
+	// Same centers everywhere: halves in whatever order they are
+	uint left = nodes.size();
+	nodes.push_back(Node());
+	nodes.push_back(Node());
+
+	nodes[left].first = first;
+	nodes[left].count = middle - first;
+	nodes[left + 1u].first = middle;
+	nodes[left + 1u].count = first + count - middle;
+	nodes[node_index].left = left;
+
+	Subdivide(left, boxes, centers);
+	Subdivide(left + 1u, boxes, centers);
+}
+
+// Traversal of inner nodes, tests in the leafs
+float SceneBVH::NodeCost(const Node & node) const
+{
+	if (!node.box.IsFinite())
+		return 0.f;
+
+	float area = node.box.SurfaceArea();
+	return node.left != 0u ? area : area * node.count;
+}
+
+// SAH cost of the tree relative to its root. Keeps the sum for the refits.
+float SceneBVH::CalculateCost()
+{
+	cost_sum = 0.f;
+	for (uint i = 0u; i < nodes.size(); ++i)
+		cost_sum += NodeCost(nodes[i]);
+
+	if (nodes.empty() || !nodes[0].box.IsFinite() || nodes[0].box.SurfaceArea() <= 0.f)
+		return 0.f;
+
+	return cost_sum / nodes[0].box.SurfaceArea();
+}
@@ -0,0 +1,93 @@
+#ifndef __SCENE_BVH_H__
+#define __SCENE_BVH_H__
+
+#include "trDefs.h"
+#include "MathGeoLib/MathGeoLib.h"
+#include "trFrameAllocator.h"
+
+#include <vector>
+
+#define BVH_NO_SLOT 0xFFFFFFFF
+#define BVH_BINS 12					// SAH candidates per axis
+#define BVH_LEAF_SIZE 4				// never split below this
+#define BVH_MAX_LEAF_SIZE 16		// always split above this, even if SAH says otherwise
+#define BVH_REBUILD_RATIO 1.5f		// refitted cost against the cost after the build
+#define BVH_MIN_PENDING 64			// inserted objects tested one by one until the next build
+
+class GameObject;
+
+// Bounding volume hierarchy over the boxes of the scene objects, animated ones included.
+// Built top-down with the binned surface area heuristic, nodes in a flat array (childs after
+// their parent, so a reverse sweep refits bottom-up). Moving objects only trigger a refit of
+// their leaf and its ancestors; the tree is built again when the refitted cost degrades, or when enough objects were
+// inserted or removed. Until then inserted objects are tested one by one and removed ones
+// are skipped.
+class SceneBVH
+{
+private:
+
+	struct Node
+	{
+		AABB box;
+		uint first = 0u;	// range in order, the whole subtree for inner nodes
+		uint count = 0u;
+		uint left = 0u;		// right is left + 1, 0 for leafs (the root is never a child)
+		uint parent = 0u;
+		bool refit = false;	// queued in refit_nodes
+	};
+
+public:
+
+	SceneBVH();
+	~SceneBVH();
+
+	void Insert(GameObject* go);
+	void Remove(GameObject* go);
+
+	// Its box changed, its leaf and the ones above are refitted
+	void Update(GameObject* go);
+
+	// Once per frame after the bounds pass: rebuild or refit as needed, nothing if nothing changed
+	void Refresh();
+	void Build();
+	// Only the nodes queued by Update, bottom-up
+	void Refit();
+	void Clear();
+
+	// Nodes fully inside the frustum are taken whole. With candidates, the objects of leafs
+	// crossing the frustum (and the ones not built yet) go there untested.
+	void CollectsGOs(const Frustum& frustum, FrameVector<GameObject*>& go_output, FrameVector<GameObject*>* candidates = nullptr) const;
+	void CollectIntersectingGOs(const LineSegment& line_segment, FrameVector<std::pair<float, GameObject*>>& intersections) const;
+	// Every object, no node test
+	void CollectAllGOs(FrameVector<GameObject*>& go_output) const;
+
+	uint GetCount() const;
+	uint GetNodeCount() const;
+	uint GetBuildCount() const;
+	float GetCost() const;
+
+private:
+
+	void Subdivide(uint node_index, const std::vector<AABB>& boxes, const std::vector<float3>& centers);
+	float NodeCost(const Node& node) const;
+	float CalculateCost();
+
+private:
+
+	std::vector<GameObject*> objects;	// by slot, nullptr once removed
+	std::vector<uint> order;			// slots, leafs point to ranges of it
+	std::vector<Node> nodes;
+	std::vector<uint> leafs;			// by slot, the leaf holding it
+	std::vector<uint> refit_nodes;
+
+	uint built_count = 0u;		// slots below this are in the tree
+	uint removed_count = 0u;
+	bool changed = false;		// since the last Refresh
+
+	float build_cost = 0.f;
+	float cost = 0.f;
+	float cost_sum = 0.f;		// cost before dividing by the root area, kept by the refits
+	uint build_count = 0u;
+};
+
+#endif // __SCENE_BVH_H__
@@ -22,6 +22,8 @@
 
 #include "trResources.h"
 #include "trAnimation.h"
+#include "trJobSystem.h"
+#include "trProfiler.h"
 #include "ResourceMesh.h"
 #include "BoneImporter.h"
 #include "AnimationImporter.h"
@@ -41,6 +43,16 @@ void StreamCallback(const char* msg, char* user_msg) {
 	TR_LOG("trFileLoader: %s", msg);
 }
 
+// Upper bound of the GameObjects an import creates
+static uint CountNodes(const aiNode* node)
+{
+	uint count = 1u;
+	for (uint i = 0u; i < node->mNumChildren; ++i)
+		count += CountNodes(node->mChildren[i]);
+
+	return count;
+}
+
 SceneImporter::SceneImporter()
 {
 	TR_LOG("MeshImporter: Loading Mesh Importer");
@@ -61,6 +73,8 @@ SceneImporter::~SceneImporter()
 
 bool SceneImporter::Import(const char * path, std::string & output_file)
 {
+	TR_PROFILE_SCOPE("SceneImporter::Import");
+
 	std::string real_path = A_MODELS_DIR;
 	real_path.append("/");
 	real_path.append(path);
@@ -77,6 +91,7 @@ bool SceneImporter::Import(const char * path, std::string & output_file)
 		cursor_data = nullptr;
 		material_data = nullptr;
 
+		App->main_scene->ReserveGameObjects(CountNodes(scene->mRootNode));
 		ImportNodesRecursively(scene->mRootNode, scene, (char*)real_path.c_str(), App->main_scene->GetRoot());
 
 		RecursiveProcessBones(scene, scene->mRootNode);
@@ -90,7 +105,7 @@ bool SceneImporter::Import(const char * path, std::string & output_file)
 		std::string final_file_name;
 		App->file_system->GetFileFileNameFromPath(real_path.c_str(), final_file_name);
 		App->main_scene->scene_name = final_file_name;
-		imported_root_go->to_destroy = true;
+		App->main_scene->Destroy(imported_root_go);
 
 		App->animation->CleanAnimableGOS();
 
@@ -168,7 +183,7 @@ void SceneImporter::ImportNodesRecursively(const aiNode * node, const aiScene *
 		aiMesh* new_mesh = scene->mMeshes[node->mMeshes[0]];
 
 		if (!new_mesh->HasTextureCoords(0)) {
-			new_go->to_destroy = true;
+			App->main_scene->Destroy(new_go);
 			good_mesh = false;
 		}
 
@@ -176,7 +191,7 @@ void SceneImporter::ImportNodesRecursively(const aiNode * node, const aiScene *
 		{
 			if (new_mesh->mFaces[i].mNumIndices != 3) {
 				TR_LOG("WARNING, geometry face with != 3 indices!");
-				new_go->to_destroy = true;
+				App->main_scene->Destroy(new_go);
 				good_mesh = false;
 			}
 		}
@@ -237,6 +252,7 @@ void SceneImporter::ImportNodesRecursively(const aiNode * node, const aiScene *
 				mesh_data->vertex_size = new_mesh->mNumVertices * 3;
 				mesh_data->vertices = new float[mesh_data->vertex_size];
 				memcpy(mesh_data->vertices, new_mesh->mVertices, sizeof(float) * mesh_data->vertex_size);
+				mesh_data->RecalculateLocalAABB();
 
 				// Data for the bounding box of all the meshes
 				for (uint i = 0; i < mesh_data->vertex_size; i++) {
@@ -268,14 +284,25 @@ void SceneImporter::ImportNodesRecursively(const aiNode * node, const aiScene *
 					mesh_data->face_size = new_mesh->mNumFaces;
 					mesh_data->index_size = new_mesh->mNumFaces * 3;
 					mesh_data->indices = new uint[mesh_data->index_size]; // assume each face is a triangle
-					for (uint i = 0; i < new_mesh->mNumFaces; ++i)
+					// The console isn't thread safe, bad faces are counted and logged after the join
+					std::atomic<uint> bad_faces(0u);
+					App->job_system->ParallelFor(0u, new_mesh->mNumFaces, 0u, [new_mesh, mesh_data, &bad_faces](uint begin, uint end)
 					{
-						if (new_mesh->mFaces[i].mNumIndices != 3) {
-							TR_LOG("WARNING, geometry face with != 3 indices!");
+						uint bad = 0u;
+						for (uint i = begin; i < end; ++i)
+						{
+							if (new_mesh->mFaces[i].mNumIndices != 3)
+								bad++;
+							else
+								memcpy(&mesh_data->indices[i * 3], new_mesh->mFaces[i].mIndices, 3 * sizeof(uint));
 						}
-						else
-							memcpy(&mesh_data->indices[i * 3], new_mesh->mFaces[i].mIndices, 3 * sizeof(uint));
-					}
+
+						if (bad > 0u)
+							bad_faces.fetch_add(bad);
+					});
+
+					if (bad_faces.load() > 0u)
+						TR_LOG("WARNING, %u geometry faces with != 3 indices!", bad_faces.load());
 				}
 
 				// Mesh normals
@@ -329,7 +356,7 @@ void SceneImporter::RecursiveProcessBones(const aiScene * scene, const aiNode *
 		UID bone_uid = App->resources->bone_importer->Import(bone, mesh_bone[bone], output);
 
 		if(go->GetParent() == nullptr ||
-			(go->GetParent() && !go->GetParent()->FindComponentByType(Component::component_type::COMPONENT_BONE)))
+			(go->GetParent() && !go->GetParent()->HasComponent(Component::component_type::COMPONENT_BONE)))
 			bone_root_uid = go->GetUUID();
 		
 		
@@ -418,7 +445,13 @@ bool SceneImporter::SaveMeshFile(const char* file_name, ResourceMesh* mesh_data,
 
 	// Amount of indices / vertices / colors / normals / texture_coords / AABB
 	uint ranges[4] = { mesh_data->index_size, mesh_data->vertex_size, mesh_data->size_uv, mesh_data->normal_size };
-	uint size = sizeof(ranges) + size_indices + size_vertices + size_uvs + size_normals;
+
+	// Picking doesn't have to build it again every time the mesh is loaded
+	if (!mesh_data->triangle_bvh.IsBuilt())
+		mesh_data->BuildTriangleBVH();
+	uint size_bvh = mesh_data->triangle_bvh.GetSerializedSize();
+
+	uint size = sizeof(ranges) + size_indices + size_vertices + size_uvs + size_normals + size_bvh;
 
 	char* data = new char[size]; // Allocate
 	char* cursor = data;
@@ -442,6 +475,10 @@ bool SceneImporter::SaveMeshFile(const char* file_name, ResourceMesh* mesh_data,
 	bytes = size_normals; // Store normals
 	memcpy(cursor, mesh_data->normals, bytes);
 
+	cursor += bytes;
+	bytes = size_bvh; // Store triangle BVH
+	mesh_data->triangle_bvh.Serialize(cursor);
+
 	cursor += bytes;
 
 	// Saving file
@@ -471,7 +508,7 @@ UID SceneImporter::GenerateResourceFromFile(const char * file_path, UID uid_to_f
 	}
 	// Open file requested file
 	char* buffer = nullptr;
-	App->file_system->ReadFromFile(file_path, &buffer);
+	uint size = App->file_system->ReadFromFile(file_path, &buffer);
 
 	// Check for errors
 	if (buffer == nullptr)
@@ -505,6 +542,7 @@ UID SceneImporter::GenerateResourceFromFile(const char * file_path, UID uid_to_f
 	bytes = sizeof(float) * resource->vertex_size;
 	resource->vertices = new float[resource->vertex_size];
 	memcpy(resource->vertices, cursor, bytes);
+	resource->RecalculateLocalAABB();
 
 	// Load uvs
 	cursor += bytes;
@@ -518,6 +556,12 @@ UID SceneImporter::GenerateResourceFromFile(const char * file_path, UID uid_to_f
 	resource->normals = new float[resource->normal_size];
 	memcpy(resource->normals, cursor, bytes);
 
+	// Load triangle BVH, files saved before it was there build it on the first pick
+	cursor += bytes;
+	uint read = cursor - buffer;
+	if (size > read)
+		resource->triangle_bvh.Deserialize(cursor, size - read, resource->index_size / 3u);
+
 	resource->SetExportedPath(file_path);
 
 	resource->index_buffer = last_id;
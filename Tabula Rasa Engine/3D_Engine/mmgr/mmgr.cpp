@@ -87,6 +87,7 @@
 #include <time.h>
 #include <stdarg.h>
 #include <new>
+#include <mutex>
 
 #ifndef	_WIN32
 #include <unistd.h>
@@ -251,6 +252,14 @@ static const	char		*memoryLogFile         = "memory.log";
 static const	char		*memoryLeakLogFile     = "memleaks.log";
 static		void		doCleanupLogOnFirstRun();
 
+// The tracking tables are shared by every thread that allocates (job system workers included), so all entry points are serialized.
+// Function-local static so it exists before any global constructor calls new.
+static	std::recursive_mutex	&allocatorMutex()
+{
+	static	std::recursive_mutex	mutex;
+	return mutex;
+}
+
 // ---------------------------------------------------------------------------------------------------------------------------------
 // Local functions only
 // ---------------------------------------------------------------------------------------------------------------------------------
@@ -1040,6 +1049,8 @@ void	operator delete[](void *reportedAddress)
 
 void	*m_allocator(const char *sourceFile, const unsigned int sourceLine, const char *sourceFunc, const unsigned int allocationType, const size_t reportedSize)
 {
+	std::lock_guard<std::recursive_mutex>	lock(allocatorMutex());
+
 	try
 	{
 		#ifdef TEST_MEMORY_MANAGER
@@ -1219,6 +1230,8 @@ void	*m_allocator(const char *sourceFile, const unsigned int sourceLine, const c
 
 void	*m_reallocator(const char *sourceFile, const unsigned int sourceLine, const char *sourceFunc, const unsigned int reallocationType, const size_t reportedSize, void *reportedAddress)
 {
+	std::lock_guard<std::recursive_mutex>	lock(allocatorMutex());
+
 	try
 	{
 		#ifdef TEST_MEMORY_MANAGER
@@ -1418,6 +1431,8 @@ void	*m_reallocator(const char *sourceFile, const unsigned int sourceLine, const
 
 void	m_deallocator(const char *sourceFile, const unsigned int sourceLine, const char *sourceFunc, const unsigned int deallocationType, const void *reportedAddress)
 {
+	std::lock_guard<std::recursive_mutex>	lock(allocatorMutex());
+
 	try
 	{
 		#ifdef TEST_MEMORY_MANAGER
@@ -8,6 +8,8 @@
 #include "trMainScene.h"
 #include "trResources.h"
 #include "trTimeManager.h"
+#include "trJobSystem.h"
+#include "trProfiler.h"
 
 #include "trInput.h" //TODO: delete this
 
@@ -19,15 +21,29 @@
 
 #define SCALE 100 /// FBX/DAE exports set scale to 0.01
 #define BLEND_TIME 1.0f
+#define DEFORM_GRAIN 1024
 
 trAnimation::trAnimation()
 {
 	this->name = "Animation";
+	phases = PHASE_UPDATE;
+	main_thread_only = false;
+	concurrent_awake = true;
+	fixed_step = true;
 }
 
 trAnimation::~trAnimation()
 {}
 
+// ---------------------------------------------
+void trAnimation::DeclareDependencies()
+{
+	// Moves bone transforms and deforms mesh vertices
+	Reads(App->time_manager);
+	Writes(App->main_scene);
+	Writes(App->resources);
+}
+
 bool trAnimation::Awake(JSON_Object* config)
 {
 	return true;
@@ -54,6 +70,8 @@ bool trAnimation::CleanUp()
 
 bool trAnimation::Update(float dt)
 {
+	TR_PROFILE_SCOPE("trAnimation::Update");
+
 	if (current_anim == nullptr)
 		return true;
 
@@ -97,14 +115,22 @@ bool trAnimation::Update(float dt)
 
 	for (uint i = 0; i < current_anim->animable_gos.size(); ++i)
 	{
-		ComponentBone* tmp_bone = (ComponentBone*)current_anim->animable_gos.at(i)->FindComponentByType(Component::component_type::COMPONENT_BONE);
+		GameObject* go = App->main_scene->GetGameObject(current_anim->animable_gos.at(i));
+		if (go == nullptr)
+			continue;
+
+		ComponentBone* tmp_bone = (ComponentBone*)go->FindComponentByType(Component::component_type::COMPONENT_BONE);
 		ResetMesh(tmp_bone);
 		
 	}
 
 	for (uint i = 0; i < current_anim->animable_gos.size(); ++i)
 	{
-		ComponentBone* bone = (ComponentBone*)current_anim->animable_gos.at(i)->FindComponentByType(Component::component_type::COMPONENT_BONE);
+		GameObject* go = App->main_scene->GetGameObject(current_anim->animable_gos.at(i));
+		if (go == nullptr)
+			continue;
+
+		ComponentBone* bone = (ComponentBone*)go->FindComponentByType(Component::component_type::COMPONENT_BONE);
 
 		if (bone && bone->attached_mesh)
 		{
@@ -135,8 +161,8 @@ void trAnimation::RecursiveGetAnimableGO(GameObject * go, ResourceAnimation::Bon
 	if (bone_transformation->bone_name.compare(go->GetName()) == 0) 
 	{
 		if (!go->to_destroy) {
-			anim->animable_data_map.insert(std::pair<GameObject*, ResourceAnimation::BoneTransformation*>(go, bone_transformation));
-			anim->animable_gos.push_back(go);
+			anim->animable_gos.push_back(go->GetHandle());
+			anim->animable_data.push_back(bone_transformation);
 			return;
 		}
 	}
@@ -150,14 +176,15 @@ void trAnimation::MoveAnimationForward(float time, Animation* current_animation,
 
 	for (uint i = 0; i < current_animation->animable_gos.size(); ++i)
 	{
-		ResourceAnimation::BoneTransformation* transform = current_animation->animable_data_map.find(current_animation->animable_gos[i])->second;
+		GameObject* go = App->main_scene->GetGameObject(current_animation->animable_gos[i]);
+		ResourceAnimation::BoneTransformation* transform = current_animation->animable_data[i];
 
-		if (transform)
+		if (go && transform)
 		{
 			float3 pos, scale;
 			Quat rot;
 
-			current_animation->animable_gos[i]->GetTransform()->GetLocalPosition(&pos, &scale, &rot);
+			go->GetTransform()->GetLocalPosition(&pos, &scale, &rot);
 
 			float* prev_pos = nullptr;
 			float* next_pos = nullptr;
@@ -306,15 +333,19 @@ void trAnimation::MoveAnimationForward(float time, Animation* current_animation,
 
 			if (blend >= 1.f)
 			{
-				current_animation->animable_gos[i]->GetTransform()->Setup(pos, scale, rot);
+				go->GetTransform()->Setup(pos, scale, rot);
 			}
 			else
 			{
 				float3 pos2, scale2;
 				Quat rot2;
-				last_anim->animable_gos[i]->GetTransform()->GetLocalPosition(&pos2, &scale2, &rot2);
+				GameObject* last_go = App->main_scene->GetGameObject(last_anim->animable_gos[i]);
+				if (last_go != nullptr)
+					last_go->GetTransform()->GetLocalPosition(&pos2, &scale2, &rot2);
+				else
+					go->GetTransform()->GetLocalPosition(&pos2, &scale2, &rot2);
 
-				current_animation->animable_gos[i]->GetTransform()->Setup(float3::Lerp(pos2, pos, blend),
+				go->GetTransform()->Setup(float3::Lerp(pos2, pos, blend),
 					float3::Lerp(scale2, scale, blend), 
 					Quat::Slerp(rot2, rot, blend));
 				
@@ -364,7 +395,7 @@ void trAnimation::CleanAnimableGOS()
 	for (uint i = 0; i < animations.size(); ++i)
 	{
 		animations.at(i)->animable_gos.clear();
-		animations.at(i)->animable_data_map.clear();
+		animations.at(i)->animable_data.clear();
 	}
 
 	for (std::vector<Animation*>::iterator it = animations.begin(); it != animations.end(); ++it)
@@ -435,17 +466,22 @@ void trAnimation::DeformMesh(ComponentBone* component_bone)
 
 		trans = trans * rbone->offset_matrix;
 
-		for (uint i = 0; i < rbone->bone_weights_size; ++i)
+		// A bone weights each vertex once, so its weights can be split across cores.
+		// Bones themselves stay sequential: they accumulate into the same vertices.
+		App->job_system->ParallelFor(0u, rbone->bone_weights_size, DEFORM_GRAIN, [&](uint begin, uint end)
 		{
-			uint index = rbone->bone_weights_indices[i];
-			float3 original(&roriginal->vertices[index * 3]);
+			for (uint i = begin; i < end; ++i)
+			{
+				uint index = rbone->bone_weights_indices[i];
+				float3 original(&roriginal->vertices[index * 3]);
 
-			float3 vertex = trans.TransformPos(original);
+				float3 vertex = trans.TransformPos(original);
 
-			rmesh->vertices[index * 3] += vertex.x * rbone->bone_weights[i] * SCALE;
-			rmesh->vertices[index * 3 + 1] += vertex.y * rbone->bone_weights[i] * SCALE;
-			rmesh->vertices[index * 3 + 2] += vertex.z * rbone->bone_weights[i] * SCALE;
-		}
+				rmesh->vertices[index * 3] += vertex.x * rbone->bone_weights[i] * SCALE;
+				rmesh->vertices[index * 3 + 1] += vertex.y * rbone->bone_weights[i] * SCALE;
+				rmesh->vertices[index * 3 + 2] += vertex.z * rbone->bone_weights[i] * SCALE;
+			}
+		});
 	}
 }
 
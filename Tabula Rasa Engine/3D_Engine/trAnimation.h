@@ -5,6 +5,7 @@
 #include "trDefs.h"
 #include "MathGeoLib\MathGeoLib.h"
 #include "ResourceAnimation.h"
+#include "GameObjectHandle.h"
 
 #include <vector>
 #include <map>
@@ -28,8 +29,9 @@ public:
 
 	struct Animation {
 		std::string name;
-		std::vector<GameObject*> animable_gos;
-		std::map<GameObject*, ResourceAnimation::BoneTransformation*> animable_data_map;
+		// Destroyed bones resolve to nullptr and are skipped
+		std::vector<GameObjectHandle> animable_gos;
+		std::vector<ResourceAnimation::BoneTransformation*> animable_data; // same index as animable_gos
 
 		bool loop = false;
 		bool interpolate = false;
@@ -52,6 +54,8 @@ public:
 	// Called before the first frame
 	bool Start();
 	bool CleanUp();
+
+	void DeclareDependencies();
 	bool Update(float dt);
 
 	void SetAnimationGos(ResourceAnimation* res);
@@ -1,4 +1,7 @@
 #include <iostream> 
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
 
 #include "trApp.h"
 #include "trDefs.h"
@@ -14,6 +17,9 @@
 #include "trFileSystem.h"
 #include "trResources.h"
 #include "trAnimation.h"
+#include "trJobSystem.h"
+#include "trProfiler.h"
+#include "trBenchmark.h"
 
 #include "trMainScene.h"
 
@@ -27,6 +33,18 @@ trApp::trApp(int argc, char* args[]) : argc(argc), args(args)
 {
 	pcg32_random();
 
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(args[i], "--headless") == 0)
+			headless = true;
+		else if (strncmp(args[i], "--frames=", 9) == 0)
+			max_frames = atoi(args[i] + 9);
+		else if (strcmp(args[i], "--trace") == 0)
+			dump_trace_on_exit = true;
+		else if (strncmp(args[i], "--benchmark=", 12) == 0)
+			benchmark = args[i] + 12;
+	}
+
 	frames = 0;
 	last_frame_ms = -1;
 	last_fps = -1;
@@ -68,6 +86,11 @@ trApp::trApp(int argc, char* args[]) : argc(argc), args(args)
 
 	
 	//disable modules here
+	if (headless) {
+		// Both need ImGui
+		editor->active = false;
+		camera->active = false;
+	}
 }
 
 // Destructor
@@ -93,17 +116,23 @@ void trApp::AddModule(trModule* module)
 bool trApp::Awake()
 {
 	bool ret = true;
+	trPerfTimer awake_timer;
 
 	uint64_t seeds[2];
 	entropy_getbytes((void*)seeds, sizeof(seeds));
 	pcg32_srandom_r(&random, seeds[0], seeds[1]);
 
+	// The main thread also executes jobs while waiting, so one core is left for it
+	uint cpu_count = hardware->GetCPUCount();
+	job_system = new trJobSystem(cpu_count > 1u ? cpu_count - 1u : 0u);
+
 	JSON_Value* root_value = nullptr;
 	root_value = json_parse_file("Settings/settings.json");
+	JSON_Object* root_obj = nullptr;
 
 	if (root_value != nullptr) {
 
-		JSON_Object* root_obj = json_value_get_object(root_value);
+		root_obj = json_value_get_object(root_value);
 
 		TR_LOG("trApp: config.json loaded correctly, iterating between modules ...");
 		JSON_Object* app_obj = json_object_get_object(json_value_get_object(root_value), "app");
@@ -112,17 +141,9 @@ bool trApp::Awake()
 		this->SetFpsCap(json_object_get_number(app_obj, "framerate_cap"));
 		cap_fps = json_object_get_boolean(app_obj, "cap_framerate");
 		this->SetVersion(json_object_get_string(app_obj, "version"));
-
-		for (std::list<trModule*>::iterator it = modules.begin(); it != modules.end() && ret == true; it++)
-		{
-			JSON_Object* module_obj = json_object_get_object(root_obj, (*it)->name.c_str());
-
-			ret = (*it)->Awake(module_obj);
-			if(!ret)
-				TR_LOG("trApp: Error awakening in: %s", (*it)->name.c_str());
-		}
-
-		json_value_free(root_value);
+		this->SetFixedTimestep(json_object_has_value(app_obj, "fixed_timestep") ? json_object_get_boolean(app_obj, "fixed_timestep") : A_FIXED_TIMESTEP);
+		this->SetTickRate(json_object_has_value(app_obj, "tick_rate") ? json_object_get_number(app_obj, "tick_rate") : A_TICK_RATE);
+		this->SetMaxCatchUpSteps(json_object_has_value(app_obj, "max_catch_up_steps") ? json_object_get_number(app_obj, "max_catch_up_steps") : A_MAX_CATCH_UP_STEPS);
 	}
 	else {
 
@@ -133,12 +154,73 @@ bool trApp::Awake()
 		this->SetFpsCap(A_FPS_CAP_VALUE);
 		cap_fps = A_FPS_CAP;
 		this->SetVersion(A_VERSION);
+		this->SetFixedTimestep(A_FIXED_TIMESTEP);
+		this->SetTickRate(A_TICK_RATE);
+		this->SetMaxCatchUpSteps(A_MAX_CATCH_UP_STEPS);
+	}
 
-		for (std::list<trModule*>::iterator it = modules.begin(); it != modules.end() && ret == true; it++)
-			ret = (*it)->Awake();
+	ret = AwakeModules(root_obj);
+
+	if (root_value != nullptr)
+		json_value_free(root_value);
+
+	// Headless runs measure throughput
+	if (headless)
+		cap_fps = false;
+
+	awake_ms = awake_timer.ReadMs();
+	TR_LOG("trApp: Awake took %.2f ms", awake_ms);
+
+	return ret;
+}
+
+// Concurrent modules are sent to the workers first, the rest awake in order on the main thread meanwhile
+bool trApp::AwakeModules(JSON_Object* root_obj)
+{
+	std::atomic<bool> ret(true);
+	JobCounter concurrent_awakes(0);
 
+	for (std::list<trModule*>::iterator it = modules.begin(); it != modules.end(); it++)
+	{
+		if (!(*it)->concurrent_awake)
+			continue;
+
+		trModule* module = (*it);
+		JSON_Object* module_obj = root_obj != nullptr ? json_object_get_object(root_obj, module->name.c_str()) : nullptr;
+
+		job_system->Run([this, module, module_obj, &ret]()
+		{
+			if (!AwakeModule(module, module_obj))
+				ret = false;
+		}, &concurrent_awakes);
+	}
+
+	for (std::list<trModule*>::iterator it = modules.begin(); it != modules.end() && ret; it++)
+	{
+		if ((*it)->concurrent_awake)
+			continue;
+
+		JSON_Object* module_obj = root_obj != nullptr ? json_object_get_object(root_obj, (*it)->name.c_str()) : nullptr;
+
+		if (!AwakeModule((*it), module_obj))
+			ret = false;
 	}
-		
+
+	// The config is freed after this, the jobs must be done with it
+	job_system->Wait(&concurrent_awakes);
+
+	return ret;
+}
+
+bool trApp::AwakeModule(trModule* module, JSON_Object* config)
+{
+	trPerfTimer timer;
+	bool ret = module->Awake(config);
+
+	if (ret)
+		TR_LOG("trApp: %s Awake %.2f ms", module->name.c_str(), timer.ReadMs());
+	else
+		TR_LOG("trApp: Error awakening in: %s", module->name.c_str());
 
 	return ret;
 }
@@ -147,6 +229,7 @@ bool trApp::Awake()
 bool trApp::Start()
 {
 	bool ret = true;
+	trPerfTimer start_timer;
 
 	std::list<trModule*>::iterator it = modules.begin();
 	
@@ -156,35 +239,71 @@ bool trApp::Start()
 			it++;
 			continue;
 		}
+		trPerfTimer timer;
 		ret = (*it)->Start();
+		TR_LOG("trApp: %s Start %.2f ms", (*it)->name.c_str(), timer.ReadMs());
 		it++;
 	}
 
+	if (ret)
+		BuildSchedule();
+
+	// Benchmarks are left out of the startup time
+	start_ms = start_timer.ReadMs();
+
+	if (ret && !benchmark.empty())
+	{
+		trBenchmark::Run(benchmark.c_str());
+		max_frames = 1u;
+	}
+
+	if (headless)
+		TR_LOG("trApp: Running headless%s", max_frames > 0u ? ", frame limit set" : "");
+	run_timer.Start();
+
 	return ret;
 }
 
 // Called each loop iteration
 bool trApp::Update()
 {
+	TR_PROFILE_SCOPE("Frame");
+
 	bool ret = true;
 	PrepareUpdate();
 
 	if (ret)
 		ret = PreUpdate();
+	event_bus.Flush();
+
+	// Simulation ticks after input has been read for this frame
+	if (ret && fixed_timestep)
+	{
+		ret = FixedUpdate();
+		event_bus.Flush();
+	}
 
 	if (ret)
 		ret = DoUpdate();
+	event_bus.Flush();
 
 	if (ret)
 		ret = PostUpdate();
+	event_bus.Flush();
 
 	FinishUpdate();
+
+	if (max_frames > 0u && frames >= max_frames)
+		ret = false;
+
 	return ret;
 }
 
 // ---------------------------------------------
 void trApp::PrepareUpdate()
 {
+	trProfiler::BeginFrame();
+
 	dt = (float)ms_timer.Read() / 1000.f;
 
 	if(run_time)
@@ -197,8 +316,13 @@ void trApp::PrepareUpdate()
 // ---------------------------------------------
 void trApp::FinishUpdate()
 {
+	TR_PROFILE_SCOPE("FinishUpdate");
+
 	// Framerate calculations --
 
+	// Finished reads/writes from previous frames
+	async_io.DispatchCompletions();
+
 	if (want_to_save == true) {
 		SaveNow();
 		want_to_save = false;
@@ -221,118 +345,180 @@ void trApp::FinishUpdate()
 
 	last_frame_ms = ms_timer.Read();
 
-	editor->InfoFPSMS((float)last_fps, (float)ms_timer.Read(), frames);
+	if (editor->active)
+		editor->InfoFPSMS((float)last_fps, (float)ms_timer.Read(), frames);
+
+	// Nothing allocated this frame survives it
+	frame_allocator.Reset();
 
 	// Cap fps
-	if (cap_fps && capped_ms > 0 && (last_frame_ms < capped_ms))
-		SDL_Delay(capped_ms - last_frame_ms);
+	frame_pacer.EndFrame(cap_fps);
 
 	if (!all_modules_loaded)
+	{
 		all_modules_loaded = true;
+
+		// The rest is construction, config and the first frame itself
+		double startup_ms = startup_timer.ReadMs();
+		TR_LOG("trApp: Cold start to first frame: %.2f ms (awake %.2f ms, start %.2f ms, other %.2f ms), %s the %.0f ms budget",
+			startup_ms, awake_ms, start_ms, startup_ms - awake_ms - start_ms,
+			startup_ms <= STARTUP_BUDGET_MS ? "within" : "over", STARTUP_BUDGET_MS);
+	}
 }
 
 // Call modules before each loop iteration
 bool trApp::PreUpdate()
 {
-	bool ret = true;
+	TR_PROFILE_SCOPE("PreUpdate");
+
+	return pre_update_schedule.Execute([this](trModule* module)
+	{
+		if (fixed_timestep && module->fixed_step)
+			return true;
+		TR_PROFILE_SCOPE(module->name.c_str());
+		return module->PreUpdate(GetModuleDt(module));
+	});
+}
 
-	trModule* pModule = NULL;
+// Call modules on each loop iteration
+bool trApp::DoUpdate()
+{
+	TR_PROFILE_SCOPE("Update");
 
-	for (std::list<trModule*>::iterator it = modules.begin(); it != modules.end() && ret == true; it++)
+	return update_schedule.Execute([this](trModule* module)
 	{
-		pModule = (*it);
+		if (fixed_timestep && module->fixed_step)
+			return true;
+		TR_PROFILE_SCOPE(module->name.c_str());
+		return module->Update(all_modules_loaded ? GetModuleDt(module) : 0);
+	});
+}
 
-		if (pModule->active == false) {
-			continue;
-		}
+// Call modules after each loop iteration
+bool trApp::PostUpdate()
+{
+	TR_PROFILE_SCOPE("PostUpdate");
 
-		if (run_time) {
-			if (pModule == main_scene) {
-				ret = (*it)->PreUpdate(time_manager->GetGameDt());
-			}
-			else {
-				ret = (*it)->PreUpdate(dt);
-			}
-		}else
-			ret = (*it)->PreUpdate(dt);
-		
-	}
+	bool ret = post_update_schedule.Execute([this](trModule* module)
+	{
+		if (fixed_timestep && module->fixed_step)
+			return true;
+		TR_PROFILE_SCOPE(module->name.c_str());
+		return module->PostUpdate(GetModuleDt(module));
+	});
 
+	//PERF_PEEK(ptimer);
 	return ret;
 }
 
-// Call modules on each loop iteration
-bool trApp::DoUpdate()
+// ---------------------------------------------
+bool trApp::FixedUpdate()
 {
+	TR_PROFILE_SCOPE("FixedUpdate");
 
 	bool ret = true;
 
-	trModule* pModule = NULL;
+	accumulator += dt;
 
-	for (std::list<trModule*>::iterator it = modules.begin(); it != modules.end() && ret == true; it++)
+	uint steps = 0u;
+	while (ret && accumulator >= fixed_dt && steps < max_catch_up_steps)
 	{
-		pModule = (*it);
-
-		if (pModule->active == false) {
-			continue;
-		}
+		// Transforms written during the tick keep their previous state for interpolation
+		fixed_tick++;
+		in_fixed_tick = true;
+		transforms.BeginTick(fixed_tick);
 
-		if (all_modules_loaded) {
-			if (run_time) {
-				if (pModule == main_scene) {
-					ret = (*it)->Update(time_manager->GetGameDt());
-				}
-				else {
-					ret = (*it)->Update(dt);
-				}
-			}
-			else
-				ret = (*it)->Update(dt);
-		}
-		else {
-			ret = (*it)->Update(0);
-		}
+		// Same graphs as the frame, only the fixed step modules are called
+		ret = pre_update_schedule.Execute([this](trModule* module)
+		{
+			if (!module->fixed_step)
+				return true;
+			TR_PROFILE_SCOPE(module->name.c_str());
+			return module->PreUpdate(GetFixedModuleDt(module));
+		});
+
+		if (ret)
+			ret = update_schedule.Execute([this](trModule* module)
+			{
+				if (!module->fixed_step)
+					return true;
+				TR_PROFILE_SCOPE(module->name.c_str());
+				return module->Update(all_modules_loaded ? GetFixedModuleDt(module) : 0);
+			});
+
+		if (ret)
+			ret = post_update_schedule.Execute([this](trModule* module)
+			{
+				if (!module->fixed_step)
+					return true;
+				TR_PROFILE_SCOPE(module->name.c_str());
+				return module->PostUpdate(GetFixedModuleDt(module));
+			});
+
+		transforms.EndTick();
+		in_fixed_tick = false;
+		accumulator -= fixed_dt;
+		steps++;
 	}
 
+	// Too far behind: drop the time instead of spiraling
+	if (accumulator >= fixed_dt)
+		accumulator = fmodf(accumulator, fixed_dt);
+
+	interpolation_alpha = accumulator / fixed_dt;
+
 	return ret;
 }
 
-// Call modules after each loop iteration
-bool trApp::PostUpdate()
+// ---------------------------------------------
+void trApp::BuildSchedule()
 {
-	bool ret = true;
+	for (std::list<trModule*>::iterator it = modules.begin(); it != modules.end(); it++)
+		(*it)->DeclareDependencies();
 
-	trModule* pModule = NULL;
+	// Render goes last in every phase, it swaps buffers
+	pre_update_schedule.Build(modules, trModule::PHASE_PRE_UPDATE, render);
+	update_schedule.Build(modules, trModule::PHASE_UPDATE, render);
+	post_update_schedule.Build(modules, trModule::PHASE_POST_UPDATE, render);
 
-	for (std::list<trModule*>::iterator it = modules.begin(); it != modules.end() && ret == true; it++)
-	{
-		pModule = (*it);
+	TR_LOG("trApp: PreUpdate schedule: %u modules, critical path %u", pre_update_schedule.GetModuleCount(), pre_update_schedule.GetCriticalPathLength());
+	TR_LOG("trApp: Update schedule: %u modules, critical path %u", update_schedule.GetModuleCount(), update_schedule.GetCriticalPathLength());
+	TR_LOG("trApp: PostUpdate schedule: %u modules, critical path %u", post_update_schedule.GetModuleCount(), post_update_schedule.GetCriticalPathLength());
+}
 
-		if (pModule->active == false) {
-			continue;
-		}
+// Game dt for the scene while playing, real dt for everything else
+float trApp::GetModuleDt(const trModule* module) const
+{
+	if (run_time && module == main_scene)
+		return time_manager->GetGameDt();
 
-		if (run_time) {
-			if (pModule == main_scene) {
-				ret = (*it)->PostUpdate(time_manager->GetGameDt());
-			}
-			else {
-				ret = (*it)->PostUpdate(dt);
-			}
-		}
-		else
-			ret = (*it)->PostUpdate(dt);
-	}
+	return dt;
+}
 
-	//PERF_PEEK(ptimer);
-	return ret;
+// The game clock scale (0 while paused) applies to the fixed step as well
+float trApp::GetFixedModuleDt(const trModule* module) const
+{
+	if (run_time && module == main_scene)
+		return dt > 0.f ? fixed_dt * (time_manager->GetGameDt() / dt) : 0.f;
+
+	return fixed_dt;
 }
 
 // Called before quitting
 bool trApp::CleanUp()
 {
 	bool ret = true;
+
+	if (headless && frames > 0u)
+	{
+		double total_ms = run_timer.ReadMs();
+		TR_LOG("trApp: Headless throughput: %u frames in %.2f ms (%.3f ms/frame, %.1f fps)",
+			frames, total_ms, total_ms / frames, frames * 1000.0 / total_ms);
+	}
 	
+	if (dump_trace_on_exit)
+		trProfiler::DumpChromeTrace();
+
 	std::list<trModule*>::reverse_iterator it = modules.rbegin();
 
 	while (it != modules.rend() && ret == true)
@@ -341,6 +527,15 @@ bool trApp::CleanUp()
 		it++;
 	}
 
+	event_bus.Clear();
+	RELEASE(job_system);
+
+	// Pending saves are written before quitting
+	async_io.WaitIdle();
+	async_io.DispatchCompletions();
+
+	trProfiler::ShutDown();
+
 	return ret;
 }
 
@@ -381,12 +576,6 @@ void trApp::RequestBrowser(const char * url) const
 	ShellExecuteA(NULL, "open", url, NULL, NULL, SW_SHOWNORMAL);
 }
 
-void trApp::SendTheCarrierPigeon(const Event & event)
-{
-	for (std::list<trModule*>::iterator it = modules.begin(); it != modules.end(); it++)
-		(*it)->OnEventReceived(event);
-}
-
 void trApp::SetOrganization(const char * organization)
 {
 	this->organization = organization;
@@ -417,12 +606,67 @@ UID trApp::GenerateNewUUID()
 	//return pcg32_boundedrand_r(&pcg32_global, UINT32_MAX);
 }
 
+bool trApp::IsFixedTimestep() const
+{
+	return fixed_timestep;
+}
+
+uint trApp::GetTickRate() const
+{
+	return tick_rate;
+}
+
+uint trApp::GetMaxCatchUpSteps() const
+{
+	return max_catch_up_steps;
+}
+
+uint64 trApp::GetFixedTick() const
+{
+	return fixed_tick;
+}
+
+bool trApp::IsInFixedTick() const
+{
+	return in_fixed_tick;
+}
+
+float trApp::GetInterpolationAlpha() const
+{
+	return fixed_timestep ? interpolation_alpha : 1.f;
+}
+
+const trFramePacer& trApp::GetFramePacer() const
+{
+	return frame_pacer;
+}
+
+void trApp::SetFixedTimestep(bool fixed_timestep)
+{
+	this->fixed_timestep = fixed_timestep;
+	accumulator = 0.f;
+	interpolation_alpha = 1.f;
+}
+
+void trApp::SetTickRate(uint tick_rate)
+{
+	this->tick_rate = tick_rate > 0u ? tick_rate : A_TICK_RATE;
+	fixed_dt = 1.f / (float)this->tick_rate;
+}
+
+void trApp::SetMaxCatchUpSteps(uint max_steps)
+{
+	max_catch_up_steps = max_steps > 0u ? max_steps : 1u;
+}
+
 void trApp::SetFpsCap(uint max_framerate)
 {
 	if (max_framerate > 0)
 		capped_ms = 1000 / max_framerate;
 	else
 		capped_ms = 0;
+
+	frame_pacer.SetTargetFramerate(max_framerate);
 }
 
 void trApp::SwitchRunTime()
@@ -453,6 +697,11 @@ bool trApp::IsRunTime() const
 	return run_time;
 }
 
+bool trApp::IsHeadless() const
+{
+	return headless;
+}
+
 void trApp::Save()
 {
 	want_to_save = true;
@@ -468,10 +717,18 @@ bool trApp::LoadNow()
 {
 	TR_LOG("Loading ...");
 
-	bool ret = true;
+	// Parsed on the io thread, modules are loaded once it's done
+	async_io.ReadJson("Settings/settings.json", [this](JSON_Value* root_value)
+	{
+		ApplyLoad(root_value);
+	});
 
-	JSON_Value* root_value = nullptr;
-	root_value = json_parse_file("Settings/config.json");
+	return true;
+}
+
+bool trApp::ApplyLoad(JSON_Value* root_value)
+{
+	bool ret = true;
 
 	if (root_value != nullptr) {
 
@@ -489,7 +746,6 @@ bool trApp::LoadNow()
 
 			ret = (*it)->Load(module_obj);
 		}
-		json_value_free(root_value);
 	}
 	else {
 		TR_LOG("trApp: Error loading settings.json file");
@@ -503,9 +759,7 @@ bool trApp::LoadNow()
 			ret = (*it)->Load();
 		}
 	}
-		
-	
-	
+
 	return ret;
 }
 
@@ -528,8 +782,9 @@ bool trApp::SaveNow()
 	json_object_set_string(app_obj, "version", App->GetVersion());
 	json_object_set_number(app_obj, "framerate_cap", capped_ms);
 	json_object_set_boolean(app_obj, "cap_framerate", cap_fps);
-	
-	char *serialized_string = NULL;
+	json_object_set_boolean(app_obj, "fixed_timestep", fixed_timestep);
+	json_object_set_number(app_obj, "tick_rate", tick_rate);
+	json_object_set_number(app_obj, "max_catch_up_steps", max_catch_up_steps);
 
 	for (std::list<trModule*>::iterator it = modules.begin(); it != modules.end() && ret == true; it++)
 	{
@@ -545,11 +800,12 @@ bool trApp::SaveNow()
 		ret = (*it)->Save(mod_obj);
 	}
 	
-	serialized_string = json_serialize_to_string_pretty(root_value);
-	puts(serialized_string);
-	json_serialize_to_file(root_value, "Settings/settings.json");
-	json_free_serialized_string(serialized_string);
-	json_value_free(root_value);
+	// The DOM is the snapshot, serializing and writing it happens on the io thread
+	async_io.WriteJson(root_value, "Settings/settings.json", [](bool success)
+	{
+		if (success)
+			TR_LOG("trApp: Settings saved");
+	});
 
 	return ret;
 }
\ No newline at end of file
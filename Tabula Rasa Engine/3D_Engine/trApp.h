@@ -5,6 +5,13 @@
 #include <string>
 #include "trModule.h"
 #include "trTimer.h"
+#include "trPerfTimer.h"
+#include "trFramePacer.h"
+#include "trModuleScheduler.h"
+#include "trEventBus.h"
+#include "trFrameAllocator.h"
+#include "trAsyncIO.h"
+#include "trTransformSystem.h"
 #include "ParsonJson/parson.h"
 #include "trLog.h"
 #include "SDL/include/SDL.h"
@@ -26,6 +33,10 @@ class trFileSystem;
 class trResources;
 class trAnimation;
 
+class trJobSystem;
+
+#define STARTUP_BUDGET_MS 300.0 // cold start to the end of the first frame
+
 class trApp
 {
 public:
@@ -57,22 +68,34 @@ public:
 	const char* GetTitle() const;
 	const char* GetOrganization() const;
 	uint GetFpsCap() const;
+	bool IsFixedTimestep() const;
+	uint GetTickRate() const;
+	uint GetMaxCatchUpSteps() const;
+	uint64 GetFixedTick() const;
+	bool IsInFixedTick() const;
+	float GetInterpolationAlpha() const;
+	const trFramePacer& GetFramePacer() const;
 	const char* GetVersion()const;
 	UID GenerateNewUUID();
 
 	// Usefull requests
 	void RequestBrowser(const char* url)const;
-	void SendTheCarrierPigeon(const Event& event);
 
 	// Setters
 	void SetTitle(const char* title);
 	void SetOrganization(const char* organization);
 	void SetVersion(const char* version);
 	void SetFpsCap(uint max_framerate);
+	void SetFixedTimestep(bool fixed_timestep);
+	void SetTickRate(uint tick_rate);
+	void SetMaxCatchUpSteps(uint max_steps);
 
 	void SwitchRunTime();
 	bool IsRunTime()const;
 
+	// No window, GL context nor editor (--headless)
+	bool IsHeadless()const;
+
 	// Load / Save
 	void Save();
 	void Load();
@@ -94,8 +117,21 @@ private:
 	// Call modules after each loop iteration
 	bool PostUpdate();
 
+	// Ticks the fixed step modules as many times as the accumulated time allows
+	bool FixedUpdate();
+
+	// Times every module, the concurrent ones are awaken on the job system
+	bool AwakeModules(JSON_Object* root_obj);
+	bool AwakeModule(trModule* module, JSON_Object* config);
+
 	bool LoadNow();
 	bool SaveNow();
+	bool ApplyLoad(JSON_Value* root_value);
+
+	// Builds the module graph of each update phase
+	void BuildSchedule();
+	float GetModuleDt(const trModule* module) const;
+	float GetFixedModuleDt(const trModule* module) const;
 
 public:
 
@@ -113,9 +149,27 @@ public:
 	trResources*		resources = nullptr;
 	trAnimation*		animation = nullptr;
 
+	// Created at the beginning of Awake, modules can awake on it
+	trJobSystem*		job_system = nullptr;
+
+	// Flushed after every update phase
+	trEventBus			event_bus;
+
+	// Scratch memory, reset at the end of every frame
+	trFrameAllocator	frame_allocator;
+
+	// Settings and scenes are written/parsed here
+	trAsyncIO			async_io;
+
+	// Every ComponentTransform is a handle into this
+	trTransformSystem	transforms;
+
 private:
 
 	std::list<trModule*>modules;
+	trModuleScheduler	pre_update_schedule;
+	trModuleScheduler	update_schedule;
+	trModuleScheduler	post_update_schedule;
 	int					argc = 0;
 	char**				args = nullptr;
 
@@ -128,6 +182,18 @@ private:
 
 	bool				run_time = false;
 
+	// Headless
+	bool				headless = false;
+	uint				max_frames = 0u; // --frames=N, 0 runs until quit
+	bool				dump_trace_on_exit = false; // --trace
+	std::string			benchmark; // --benchmark=name, runs after Start and quits
+	trPerfTimer			run_timer;
+
+	// Started on construction, read once the first frame is done
+	trPerfTimer			startup_timer;
+	double				awake_ms = 0.0;
+	double				start_ms = 0.0;
+
 	//fps/ms
 	trTimer				ms_timer;
 	trTimer				fps_timer;
@@ -138,6 +204,17 @@ private:
 	int					last_fps = 0;
 	int					capped_ms = 0;
 	bool				cap_fps = true;
+	trFramePacer		frame_pacer;
+
+	// Fixed timestep
+	bool				fixed_timestep = false;
+	uint				tick_rate = 60u;
+	uint				max_catch_up_steps = 5u;
+	float				fixed_dt = 1.f / 60.f;
+	float				accumulator = 0.f;
+	float				interpolation_alpha = 1.f;
+	uint64				fixed_tick = 0u;
+	bool				in_fixed_tick = false;
 
 	// UUID
 	//LCG*				gen_uuid = nullptr;
@@ -0,0 +1,140 @@
+// ----------------------------------------------------
+// trAsyncIO.cpp
+// Serializes and writes/reads files off the main thread
+// ----------------------------------------------------
+
+#include "trAsyncIO.h"
+#include "trLog.h"
+
+#include <memory>
+
+trAsyncIO::trAsyncIO()
+{
+	worker = std::thread(&trAsyncIO::WorkerLoop, this);
+}
+
+trAsyncIO::~trAsyncIO()
+{
+	// Whatever is queued still gets written
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+	wake_up.notify_one();
+
+	if (worker.joinable())
+		worker.join();
+}
+
+// ---------------------------------------------
+void trAsyncIO::Submit(const Task& task, const Completion& on_done)
+{
+	Request request;
+	request.task = task;
+	request.on_done = on_done;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		pending.push_back(request);
+	}
+	wake_up.notify_one();
+}
+
+void trAsyncIO::WriteJson(JSON_Value* snapshot, const char* path, const Completion& on_done)
+{
+	std::string file_path(path);
+
+	Submit([snapshot, file_path]()
+	{
+		bool ret = json_serialize_to_file(snapshot, file_path.c_str()) == JSONSuccess;
+		json_value_free(snapshot);
+		return ret;
+	},
+	[file_path, on_done](bool success)
+	{
+		// Logged from here, the console isn't thread safe
+		if (!success)
+			TR_LOG("trAsyncIO: Error writing %s", file_path.c_str());
+
+		if (on_done)
+			on_done(success);
+	});
+}
+
+void trAsyncIO::ReadJson(const char* path, const JsonLoaded& on_loaded)
+{
+	std::string file_path(path);
+	std::shared_ptr<JSON_Value*> result = std::make_shared<JSON_Value*>(nullptr);
+
+	Submit([result, file_path]()
+	{
+		*result = json_parse_file(file_path.c_str());
+		return *result != nullptr;
+	},
+	[result, on_loaded](bool success)
+	{
+		on_loaded(*result);
+
+		if (*result != nullptr)
+			json_value_free(*result);
+	});
+}
+
+// ---------------------------------------------
+void trAsyncIO::DispatchCompletions()
+{
+	std::vector<Request> done;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (completed.empty())
+			return;
+		done.swap(completed);
+	}
+
+	for (uint i = 0u; i < done.size(); ++i)
+	{
+		if (done[i].on_done)
+			done[i].on_done(done[i].success);
+	}
+}
+
+void trAsyncIO::WaitIdle()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	idle.wait(lock, [this]() { return pending.empty() && !busy; });
+}
+
+uint trAsyncIO::GetPendingCount()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return pending.size() + (busy ? 1u : 0u);
+}
+
+// ---------------------------------------------
+void trAsyncIO::WorkerLoop()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	while (true)
+	{
+		wake_up.wait(lock, [this]() { return quit || !pending.empty(); });
+
+		if (pending.empty())
+			break; // quit with nothing left to write
+
+		Request request = pending.front();
+		pending.pop_front();
+		busy = true;
+
+		lock.unlock();
+		request.success = request.task();
+		lock.lock();
+
+		busy = false;
+		if (request.on_done)
+			completed.push_back(request);
+
+		if (pending.empty())
+			idle.notify_all();
+	}
+}
@@ -0,0 +1,74 @@
+#ifndef __trASYNCIO_H__
+#define __trASYNCIO_H__
+
+#include "trDefs.h"
+#include "ParsonJson/parson.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Background thread for file serialization. Tasks run in submission order on the io thread,
+// their completions are called on the main thread from DispatchCompletions.
+class trAsyncIO
+{
+public:
+
+	typedef std::function<bool()> Task;
+	typedef std::function<void(bool success)> Completion;
+
+	// value is nullptr if the file couldn't be read or parsed. It is freed after the call.
+	typedef std::function<void(JSON_Value* value)> JsonLoaded;
+
+private:
+
+	struct Request
+	{
+		Task task;
+		Completion on_done;
+		bool success = false;
+	};
+
+public:
+
+	trAsyncIO();
+	~trAsyncIO();
+
+	void Submit(const Task& task, const Completion& on_done = nullptr);
+
+	// Takes ownership of the snapshot, it must not be touched after this call
+	void WriteJson(JSON_Value* snapshot, const char* path, const Completion& on_done = nullptr);
+
+	// Parses on the io thread, on_loaded runs on the main thread
+	void ReadJson(const char* path, const JsonLoaded& on_loaded);
+
+	// Main thread, once per frame
+	void DispatchCompletions();
+
+	// Blocks until every submitted task has been executed (completions are not dispatched)
+	void WaitIdle();
+
+	uint GetPendingCount();
+
+private:
+
+	void WorkerLoop();
+
+private:
+
+	std::thread worker;
+	std::mutex mutex;
+	std::condition_variable wake_up;
+	std::condition_variable idle;
+
+	std::deque<Request> pending;
+	std::vector<Request> completed;
+	bool busy = false;
+	bool quit = false;
+};
+
+#endif // __trASYNCIO_H__
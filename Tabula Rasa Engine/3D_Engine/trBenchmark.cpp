@@ -0,0 +1,813 @@
+// ----------------------------------------------------
+// trBenchmark.cpp
+// Micro benchmarks selected from the command line
+// ----------------------------------------------------
+
+#include "trBenchmark.h"
+#include "trApp.h"
+#include "trPerfTimer.h"
+#include "trTransformSystem.h"
+#include "trMainScene.h"
+#include "Quadtree.h"
+#include "MeshBVH.h"
+#include "trFrustumCuller.h"
+#include "GameObject.h"
+#include "ComponentTransform.h"
+#include "ComponentMesh.h"
+#include "ComponentMaterial.h"
+#include "trResources.h"
+#include "ResourceMesh.h"
+#include "trPool.h"
+#include "trLog.h"
+
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+// Baseline: one allocation per node, childs reached through pointers
+struct NaiveTransform
+{
+	float4x4 local = float4x4::identity;
+	float4x4 world = float4x4::identity;
+	std::vector<NaiveTransform*> childs;
+};
+
+static void UpdateNaive(NaiveTransform* node, const float4x4& parent_world)
+{
+	node->world = parent_world * node->local;
+
+	for (uint i = 0u; i < node->childs.size(); ++i)
+		UpdateNaive(node->childs[i], node->world);
+}
+
+// Baseline: what cloning through the regular API costs, object by object. Same components
+// and resources as trMainScene::Instantiate, indexed by the caller once the boxes are known.
+static GameObject* CloneNaive(GameObject* source, GameObject* parent, std::vector<GameObject*>& created)
+{
+	GameObject* copy = App->main_scene->CreateGameObject(source->GetName(), parent);
+
+	for (std::list<Component*>::iterator it = source->components.begin(); it != source->components.end(); ++it)
+	{
+		if ((*it)->GetType() == Component::component_type::COMPONENT_TRANSFORM)
+		{
+			ComponentTransform* transform = (ComponentTransform*)copy->CreateComponent(Component::component_type::COMPONENT_TRANSFORM);
+			transform->Setup(source->GetTransform()->GetTranslation(), source->GetTransform()->GetScale(), source->GetTransform()->GetRotation(), true);
+		}
+		else if ((*it)->GetType() != Component::component_type::COMPONENT_CAMERA)
+		{
+			Component* component = copy->CreateComponent((*it)->GetType());
+			if (component != nullptr && (*it)->GetResourceUID() != 0u)
+				component->SetResource((*it)->GetResourceUID());
+		}
+	}
+
+	created.push_back(copy);
+
+	for (std::list<GameObject*>::iterator it = source->childs.begin(); it != source->childs.end(); ++it)
+		CloneNaive((*it), copy, created);
+
+	return copy;
+}
+
+// Unit cube around the origin, CPU data only
+static ResourceMesh* CreateCubeMesh()
+{
+	static const float cube_vertices[] = {
+		-0.5f, -0.5f, -0.5f,	0.5f, -0.5f, -0.5f,		0.5f, 0.5f, -0.5f,		-0.5f, 0.5f, -0.5f,
+		-0.5f, -0.5f, 0.5f,		0.5f, -0.5f, 0.5f,		0.5f, 0.5f, 0.5f,		-0.5f, 0.5f, 0.5f
+	};
+	static const uint cube_indices[] = {
+		0, 2, 1, 0, 3, 2,	4, 5, 6, 4, 6, 7,	0, 1, 5, 0, 5, 4,
+		3, 6, 2, 3, 7, 6,	0, 4, 7, 0, 7, 3,	1, 2, 6, 1, 6, 5
+	};
+
+	ResourceMesh* mesh = (ResourceMesh*)App->resources->CreateNewResource(Resource::Type::MESH);
+
+	mesh->vertex_size = sizeof(cube_vertices) / sizeof(float);
+	mesh->vertices = new float[mesh->vertex_size];
+	memcpy(mesh->vertices, cube_vertices, sizeof(cube_vertices));
+
+	mesh->index_size = sizeof(cube_indices) / sizeof(uint);
+	mesh->indices = new uint[mesh->index_size];
+	memcpy(mesh->indices, cube_indices, sizeof(cube_indices));
+	mesh->face_size = mesh->index_size / 3u;
+
+	mesh->RecalculateLocalAABB();
+	return mesh;
+}
+
+// Baseline: what camera culling did, the 8 corners against every plane, fetched again for every corner
+static bool ContainsCorners(const Frustum& frustum, const AABB& ref_box)
+{
+	float3 aabb_corners[8];
+	ref_box.GetCornerPoints(aabb_corners);
+
+	for (int p = 0; p < 6; ++p)
+	{
+		int corners_outside = 8;
+
+		for (int i = 0; i < 8; ++i)
+		{
+			if (frustum.GetPlane(p).IsOnPositiveSide(aabb_corners[i]))
+				--corners_outside;
+		}
+
+		if (corners_outside == 0)
+			return false;
+	}
+
+	return true;
+}
+
+// What a loaded object takes from the allocator. Meshes and materials on every other object.
+struct SceneAllocation
+{
+	void* go = nullptr;
+	void* transform = nullptr;
+	void* mesh = nullptr;
+	void* material = nullptr;
+	char* name = nullptr; // stays on the heap with the pools too, like the names do
+};
+
+// Writes the whole object like a constructor would, the first word gets the load index
+template<typename T>
+static void* Touch(void* memory, uint index)
+{
+	memset(memory, 0, sizeof(T));
+	*(uint*)memory = index;
+	return memory;
+}
+
+// Sums a word of every object, in load order, to see how scattered they are
+static uint WalkScene(const std::vector<SceneAllocation>& scene)
+{
+	uint sum = 0u;
+	for (uint i = 0u; i < scene.size(); ++i)
+	{
+		sum += *(const uint*)scene[i].go;
+		sum += *(const uint*)scene[i].transform;
+	}
+	return sum;
+}
+
+// ---------------------------------------------
+bool trBenchmark::Run(const char* name)
+{
+	if (strcmp(name, "transforms") == 0)
+	{
+		Transforms();
+		return true;
+	}
+	if (strcmp(name, "instantiate") == 0)
+	{
+		Instantiate();
+		return true;
+	}
+	if (strcmp(name, "quadtree") == 0)
+	{
+		QuadtreeQueries();
+		return true;
+	}
+	if (strcmp(name, "picking") == 0)
+	{
+		Picking();
+		return true;
+	}
+	if (strcmp(name, "culling") == 0)
+	{
+		Culling();
+		return true;
+	}
+	if (strcmp(name, "pools") == 0)
+	{
+		Pools();
+		return true;
+	}
+
+	TR_LOG("trBenchmark: Unknown benchmark %s", name);
+	return false;
+}
+
+// ---------------------------------------------
+void trBenchmark::Transforms()
+{
+	const uint count = BENCHMARK_TRANSFORMS;
+
+	// Four childs per node, ~9 levels deep
+	trTransformSystem system;
+	std::vector<TransformHandle> handles(count);
+	std::vector<NaiveTransform*> naive(count);
+
+	for (uint i = 0u; i < count; ++i)
+	{
+		float3 position((float)(i % 10u), (float)((i / 10u) % 10u), (float)(i % 7u));
+		Quat rotation = Quat::RotateY(0.001f * (float)i);
+		float3 scale = float3::one;
+
+		uint parent = i > 0u ? (i - 1u) / 4u : INVALID_TRANSFORM;
+
+		handles[i] = system.Create(parent != INVALID_TRANSFORM ? handles[parent] : INVALID_TRANSFORM, position, rotation, scale);
+
+		naive[i] = new NaiveTransform();
+		naive[i]->local = float4x4::FromTRS(position, rotation, scale);
+		if (parent != INVALID_TRANSFORM)
+			naive[parent]->childs.push_back(naive[i]);
+	}
+
+	trPerfTimer timer;
+	system.UpdateWorldMatrices(false);
+	double first_ms = timer.ReadMs();
+
+	TR_LOG("trBenchmark: %u transforms, %u levels, first pass (sort included) %.3f ms", count, system.GetLevelCount(), first_ms);
+
+	// Naive, everything recalculated
+	timer.Start();
+	for (uint it = 0u; it < BENCHMARK_ITERATIONS; ++it)
+		UpdateNaive(naive[0], float4x4::identity);
+	double naive_ms = timer.ReadMs() / BENCHMARK_ITERATIONS;
+
+	// SoA, everything dirty
+	double all_serial_ms = 0.0, all_parallel_ms = 0.0;
+	for (uint it = 0u; it < BENCHMARK_ITERATIONS; ++it)
+	{
+		system.MarkDirty(handles[0]);
+		timer.Start();
+		system.UpdateWorldMatrices(false);
+		all_serial_ms += timer.ReadMs();
+
+		system.MarkDirty(handles[0]);
+		timer.Start();
+		system.UpdateWorldMatrices(true);
+		all_parallel_ms += timer.ReadMs();
+	}
+	all_serial_ms /= BENCHMARK_ITERATIONS;
+	all_parallel_ms /= BENCHMARK_ITERATIONS;
+
+	// SoA, 10% of the transforms dirty (leaves, so nothing else is dragged along)
+	uint first_leaf = (count - 1u) / 4u + 1u;
+	uint stride = MAX(1u, (count - first_leaf) / (count / 10u));
+	double some_serial_ms = 0.0, some_parallel_ms = 0.0;
+	for (uint it = 0u; it < BENCHMARK_ITERATIONS; ++it)
+	{
+		for (uint i = first_leaf; i < count; i += stride)
+			system.MarkDirty(handles[i]);
+		timer.Start();
+		system.UpdateWorldMatrices(false);
+		some_serial_ms += timer.ReadMs();
+
+		for (uint i = first_leaf; i < count; i += stride)
+			system.MarkDirty(handles[i]);
+		timer.Start();
+		system.UpdateWorldMatrices(true);
+		some_parallel_ms += timer.ReadMs();
+	}
+	some_serial_ms /= BENCHMARK_ITERATIONS;
+	some_parallel_ms /= BENCHMARK_ITERATIONS;
+
+	// Both paths must agree
+	float max_error = 0.f;
+	for (uint i = 0u; i < count; ++i)
+	{
+		const float* soa = system.GetWorldMatrix(handles[i]).ptr();
+		const float* reference = naive[i]->world.ptr();
+		for (uint e = 0u; e < 16u; ++e)
+			max_error = MAX(max_error, Abs(soa[e] - reference[e]));
+	}
+
+	TR_LOG("trBenchmark: Naive pointer chasing, all dirty: %.3f ms", naive_ms);
+	TR_LOG("trBenchmark: SoA serial,   all dirty: %.3f ms, 10%% dirty: %.3f ms", all_serial_ms, some_serial_ms);
+	TR_LOG("trBenchmark: SoA parallel, all dirty: %.3f ms, 10%% dirty: %.3f ms", all_parallel_ms, some_parallel_ms);
+	TR_LOG("trBenchmark: Max difference against the naive pass: %f", max_error);
+
+	// The products alone, same tree in depth order: MathGeoLib scalar operator* against the SSE rows
+	std::vector<float4x4> locals(count), scalar_worlds(count), simd_worlds(count);
+	for (uint i = 0u; i < count; ++i)
+		locals[i] = naive[i]->local;
+	scalar_worlds[0] = simd_worlds[0] = locals[0];
+
+	timer.Start();
+	for (uint it = 0u; it < BENCHMARK_ITERATIONS; ++it)
+	{
+		for (uint i = 1u; i < count; ++i)
+			scalar_worlds[i] = scalar_worlds[(i - 1u) / 4u] * locals[i];
+	}
+	double scalar_ms = timer.ReadMs() / BENCHMARK_ITERATIONS;
+
+	timer.Start();
+	for (uint it = 0u; it < BENCHMARK_ITERATIONS; ++it)
+	{
+		for (uint i = 1u; i < count; ++i)
+			trTransformSystem::MultiplyMatrices(simd_worlds[(i - 1u) / 4u], locals[i], simd_worlds[i]);
+	}
+	double simd_ms = timer.ReadMs() / BENCHMARK_ITERATIONS;
+
+	float simd_error = 0.f;
+	for (uint i = 0u; i < count; ++i)
+	{
+		for (uint e = 0u; e < 16u; ++e)
+			simd_error = MAX(simd_error, Abs(simd_worlds[i].ptr()[e] - scalar_worlds[i].ptr()[e]));
+	}
+
+	TR_LOG("trBenchmark: %u matrix products, scalar: %.3f ms, SSE: %.3f ms (x%.2f), max difference %f", count - 1u, scalar_ms, simd_ms, simd_ms > 0.0 ? scalar_ms / simd_ms : 0.0, simd_error);
+
+	for (uint i = 0u; i < count; ++i)
+		RELEASE(naive[i]);
+}
+
+// ---------------------------------------------
+void trBenchmark::Instantiate()
+{
+	const uint count = BENCHMARK_INSTANCES;
+
+	// Prototype: a root with four childs, two grandchilds each
+	std::vector<GameObject*> prototype_gos;
+	App->main_scene->CreateGameObjects(1u, "Benchmark prototype", nullptr, prototype_gos);
+	GameObject* prototype = prototype_gos[0];
+
+	std::vector<GameObject*> childs, grandchilds;
+	App->main_scene->CreateGameObjects(4u, "Benchmark child", prototype, childs);
+	for (uint i = 0u; i < childs.size(); ++i)
+	{
+		childs[i]->GetTransform()->Setup(float3((float)i, 0.f, 0.f), float3::one, Quat::identity, true);
+		App->main_scene->CreateGameObjects(2u, "Benchmark grandchild", childs[i], grandchilds);
+	}
+	for (uint i = 0u; i < grandchilds.size(); ++i)
+		grandchilds[i]->GetTransform()->Setup(float3(0.f, (float)(i % 2u), 0.f), float3::one, Quat::identity, true);
+
+	uint prototype_size = 1u + childs.size() + grandchilds.size();
+
+	// Every child and grandchild draws the same cube with the same texture
+	ResourceMesh* mesh = CreateCubeMesh();
+	Resource* texture = App->resources->CreateNewResource(Resource::Type::TEXTURE);
+	for (uint i = 0u; i < childs.size(); ++i)
+	{
+		childs[i]->CreateComponent(Component::component_type::COMPONENT_MESH)->SetResource(mesh->GetUID());
+		childs[i]->CreateComponent(Component::component_type::COMPONENT_MATERIAL)->SetResource(texture->GetUID());
+	}
+	for (uint i = 0u; i < grandchilds.size(); ++i)
+	{
+		grandchilds[i]->CreateComponent(Component::component_type::COMPONENT_MESH)->SetResource(mesh->GetUID());
+		grandchilds[i]->CreateComponent(Component::component_type::COMPONENT_MATERIAL)->SetResource(texture->GetUID());
+	}
+
+	// Destroyed objects are only released next frame, both runs are compared by what they add
+	uint indexed = App->main_scene->quadtree.GetCount();
+	uint mesh_references = mesh->CountReferences();
+	uint texture_references = texture->CountReferences();
+
+	// Naive
+	std::vector<GameObject*> naive_copies;
+	naive_copies.reserve(count);
+	std::vector<GameObject*> naive_created;
+	naive_created.reserve(count * prototype_size);
+
+	trPerfTimer timer;
+	for (uint i = 0u; i < count; ++i)
+	{
+		GameObject* copy = CloneNaive(prototype, App->main_scene->GetRoot(), naive_created);
+		copy->GetTransform()->Setup(float3((float)(i % 100u), 0.f, (float)(i / 100u)), float3::one, Quat::identity, true);
+		naive_copies.push_back(copy);
+	}
+	App->main_scene->UpdateTransforms();
+	for (uint i = 0u; i < naive_copies.size(); ++i)
+		naive_copies[i]->RecalculateBoundingBox();
+	for (uint i = 0u; i < naive_created.size(); ++i)
+		App->main_scene->InsertGoInQuadtree(naive_created[i]);
+	double naive_ms = timer.ReadMs();
+
+	uint naive_indexed = App->main_scene->quadtree.GetCount() - indexed;
+	uint naive_mesh_references = mesh->CountReferences() - mesh_references;
+	uint naive_texture_references = texture->CountReferences() - texture_references;
+
+	for (uint i = 0u; i < naive_copies.size(); ++i)
+		App->main_scene->Destroy(naive_copies[i]);
+
+	// Batched, all the copies at the same place
+	std::vector<GameObject*> copies;
+	indexed = App->main_scene->quadtree.GetCount();
+	mesh_references = mesh->CountReferences();
+	texture_references = texture->CountReferences();
+
+	timer.Start();
+	App->main_scene->Instantiate(prototype, float4x4::identity, count, &copies);
+	double batched_ms = timer.ReadMs();
+
+	uint batched_indexed = App->main_scene->quadtree.GetCount() - indexed;
+	uint batched_mesh_references = mesh->CountReferences() - mesh_references;
+	uint batched_texture_references = texture->CountReferences() - texture_references;
+
+	TR_LOG("trBenchmark: %u instances of a %u objects prototype (%u objects)", count, prototype_size, count * prototype_size);
+	TR_LOG("trBenchmark: Object by object: %.3f ms (%.3f us per instance)", naive_ms, 1000.0 * naive_ms / count);
+	TR_LOG("trBenchmark: Instantiate:      %.3f ms (%.3f us per instance)", batched_ms, 1000.0 * batched_ms / count);
+
+	// Both have to leave the scene in the same state, otherwise the times mean nothing
+	if (naive_created.size() != count * prototype_size || naive_indexed != batched_indexed ||
+		naive_mesh_references != batched_mesh_references || naive_texture_references != batched_texture_references)
+	{
+		TR_LOG("trBenchmark: Instantiate MISMATCH, objects %u/%u, indexed %u/%u, mesh references %u/%u, texture references %u/%u",
+			(uint)naive_created.size(), count * prototype_size, naive_indexed, batched_indexed,
+			naive_mesh_references, batched_mesh_references, naive_texture_references, batched_texture_references);
+	}
+	else
+		TR_LOG("trBenchmark: Same result: %u objects indexed, %u mesh and %u texture references added", batched_indexed, batched_mesh_references, batched_texture_references);
+
+	for (uint i = 0u; i < copies.size(); ++i)
+		App->main_scene->Destroy(copies[i]);
+	App->main_scene->Destroy(prototype);
+}
+
+// ---------------------------------------------
+void trBenchmark::QuadtreeQueries()
+{
+	const uint count = BENCHMARK_QUADTREE_OBJECTS;
+	AABB world(float3(-500.f, -100.f, -500.f), float3(500.f, 100.f, 500.f));
+
+	// Only their boxes are used, they are never indexed in the scene quadtree
+	std::vector<GameObject*> gos;
+	App->main_scene->CreateGameObjects(count, "Benchmark object", nullptr, gos);
+
+	LCG random(1234u);
+	for (uint i = 0u; i < count; ++i)
+	{
+		float3 center(random.Float(-500.f, 500.f), random.Float(-50.f, 50.f), random.Float(-500.f, 500.f));
+		float size = i % 20u == 0u ? random.Float(10.f, 60.f) : random.Float(0.5f, 4.f); // some big ones
+		gos[i]->bounding_box = AABB::FromCenterAndSize(center, float3(size, size, size));
+	}
+
+	::Quadtree tree;
+
+	trPerfTimer timer;
+	tree.Create(world);
+	for (uint i = 0u; i < count; ++i)
+		tree.Insert(gos[i]);
+	double insert_ms = timer.ReadMs();
+
+	// Camera flying across the world, looking down a bit
+	Frustum frustum;
+	frustum.type = FrustumType::PerspectiveFrustum;
+	frustum.front = float3(1.f, -0.3f, 1.f).Normalized();
+	frustum.up = frustum.front.Cross(float3::unitX).Normalized();
+	if (frustum.up.y < 0.f)
+		frustum.up = -frustum.up;
+	frustum.nearPlaneDistance = 0.1f;
+	frustum.farPlaneDistance = 300.f;
+	frustum.verticalFov = math::DegToRad(60.0f);
+	frustum.horizontalFov = 2.f * atanf(tanf(frustum.verticalFov / 2.f) * 16.f / 9.f);
+
+	FrameVector<GameObject*> brute_found(App->frame_allocator), tree_found(App->frame_allocator);
+	FrameVector<GameObject*> split_found(App->frame_allocator), candidates(App->frame_allocator);
+	brute_found.reserve(count);
+	tree_found.reserve(count);
+	split_found.reserve(count);
+	candidates.reserve(count);
+
+	double brute_ms = 0.0, tree_ms = 0.0, split_ms = 0.0;
+	uint found_total = 0u, candidate_total = 0u, mismatches = 0u;
+
+	for (uint it = 0u; it < BENCHMARK_ITERATIONS; ++it)
+	{
+		frustum.pos = float3(-450.f + 40.f * it, 40.f, -450.f + 40.f * it);
+
+		// Baseline: every box against the frustum
+		Plane planes[6];
+		timer.Start();
+		frustum.GetPlanes(planes);
+		brute_found.clear();
+		for (uint i = 0u; i < count; ++i)
+		{
+			if (QuadtreeNode::TestAaBox(gos[i]->bounding_box, planes) != FRUSTUM_OUTSIDE)
+				brute_found.push_back(gos[i]);
+		}
+		brute_ms += timer.ReadMs();
+
+		// Every box of the nodes crossing the frustum tested in the tree
+		tree_found.clear();
+		timer.Start();
+		tree.CollectsGOs(frustum, tree_found);
+		tree_ms += timer.ReadMs();
+
+		// What the renderer does: the crossing nodes hand out candidates, tested afterwards
+		split_found.clear();
+		candidates.clear();
+		timer.Start();
+		tree.CollectsGOs(frustum, split_found, &candidates);
+		for (uint i = 0u; i < candidates.size(); ++i)
+		{
+			if (QuadtreeNode::TestAaBox(candidates[i]->bounding_box, planes) != FRUSTUM_OUTSIDE)
+				split_found.push_back(candidates[i]);
+		}
+		split_ms += timer.ReadMs();
+
+		// Same objects, whatever the order the nodes gave them in
+		std::sort(brute_found.begin(), brute_found.end());
+		std::sort(tree_found.begin(), tree_found.end());
+		std::sort(split_found.begin(), split_found.end());
+
+		if (brute_found != tree_found || brute_found != split_found)
+		{
+			mismatches++;
+			TR_LOG("trBenchmark: Frustum %u: every box found %u, quadtree %u, with candidates %u", it, brute_found.size(), tree_found.size(), split_found.size());
+		}
+
+		found_total += brute_found.size();
+		candidate_total += candidates.size();
+	}
+
+	TR_LOG("trBenchmark: %u objects in the quadtree, inserted in %.3f ms, %u found per query", count, insert_ms, found_total / BENCHMARK_ITERATIONS);
+	TR_LOG("trBenchmark: Every box:             %.3f ms per query", brute_ms / BENCHMARK_ITERATIONS);
+	TR_LOG("trBenchmark: Quadtree:              %.3f ms per query", tree_ms / BENCHMARK_ITERATIONS);
+	TR_LOG("trBenchmark: Quadtree + candidates: %.3f ms per query, %u candidates tested", split_ms / BENCHMARK_ITERATIONS, candidate_total / BENCHMARK_ITERATIONS);
+	TR_LOG("trBenchmark: %u of %u frustums found different objects than testing every box", mismatches, BENCHMARK_ITERATIONS);
+
+	// Unlinked from the local tree before they go
+	tree.Clear();
+	for (uint i = 0u; i < count; ++i)
+		App->main_scene->Destroy(gos[i]);
+}
+
+// ---------------------------------------------
+void trBenchmark::Picking()
+{
+	const uint grid = BENCHMARK_PICKING_GRID;
+	const uint side = grid + 1u;
+
+	// Bumpy terrain, 100 units wide
+	std::vector<float> vertices(side * side * 3u);
+	std::vector<uint> indices(grid * grid * 6u);
+
+	for (uint z = 0u; z < side; ++z)
+	{
+		for (uint x = 0u; x < side; ++x)
+		{
+			float* vertex = &vertices[(z * side + x) * 3u];
+			vertex[0] = 100.f * x / grid - 50.f;
+			vertex[1] = 2.f * sinf(0.3f * x) * cosf(0.2f * z);
+			vertex[2] = 100.f * z / grid - 50.f;
+		}
+	}
+
+	for (uint z = 0u; z < grid; ++z)
+	{
+		for (uint x = 0u; x < grid; ++x)
+		{
+			uint* quad = &indices[(z * grid + x) * 6u];
+			uint corner = z * side + x;
+			quad[0] = corner; quad[1] = corner + side; quad[2] = corner + 1u;
+			quad[3] = corner + 1u; quad[4] = corner + side; quad[5] = corner + side + 1u;
+		}
+	}
+
+	uint triangle_count = indices.size() / 3u;
+
+	MeshBVH bvh;
+	trPerfTimer timer;
+	bvh.Build(&vertices[0], vertices.size(), &indices[0], indices.size());
+	double build_ms = timer.ReadMs();
+
+	// Rays from above, slanted, some of them missing the terrain
+	std::vector<LineSegment> rays(BENCHMARK_PICKING_RAYS);
+	LCG random(1234u);
+	for (uint i = 0u; i < rays.size(); ++i)
+	{
+		float3 from(random.Float(-60.f, 60.f), 30.f, random.Float(-60.f, 60.f));
+		float3 to(from.x + random.Float(-20.f, 20.f), -10.f, from.z + random.Float(-20.f, 20.f));
+		rays[i] = LineSegment(from, to);
+	}
+
+	// Baseline: every triangle, like picking did before
+	std::vector<float> brute_distances(rays.size(), FLOAT_INF);
+	timer.Start();
+	for (uint i = 0u; i < rays.size(); ++i)
+	{
+		Triangle tri;
+		for (uint t = 0u; t < triangle_count; ++t)
+		{
+			tri.a = float3(&vertices[indices[t * 3u] * 3u]);
+			tri.b = float3(&vertices[indices[t * 3u + 1u] * 3u]);
+			tri.c = float3(&vertices[indices[t * 3u + 2u] * 3u]);
+
+			float hit_distance = 0.f;
+			if (rays[i].Intersects(tri, &hit_distance, nullptr) && hit_distance < brute_distances[i])
+				brute_distances[i] = hit_distance;
+		}
+	}
+	double brute_ms = timer.ReadMs();
+
+	std::vector<float> bvh_distances(rays.size(), FLOAT_INF);
+	timer.Start();
+	for (uint i = 0u; i < rays.size(); ++i)
+	{
+		MeshHit hit;
+		if (bvh.RayCast(rays[i], &vertices[0], &indices[0], hit))
+			bvh_distances[i] = hit.distance;
+	}
+	double bvh_ms = timer.ReadMs();
+
+	// Both must find the same triangles
+	uint hits = 0u, mismatches = 0u;
+	for (uint i = 0u; i < rays.size(); ++i)
+	{
+		if (brute_distances[i] != FLOAT_INF)
+			hits++;
+		if (brute_distances[i] != bvh_distances[i] && !(Abs(brute_distances[i] - bvh_distances[i]) <= 1e-5f))
+			mismatches++;
+	}
+
+	TR_LOG("trBenchmark: %u triangles, BVH of %u nodes built in %.3f ms", triangle_count, bvh.GetNodeCount(), build_ms);
+	TR_LOG("trBenchmark: Every triangle: %.4f ms per ray", brute_ms / rays.size());
+	TR_LOG("trBenchmark: Triangle BVH:   %.4f ms per ray", bvh_ms / rays.size());
+	TR_LOG("trBenchmark: %u of %u rays hit, %u differ from testing every triangle", hits, rays.size(), mismatches);
+}
+
+// ---------------------------------------------
+void trBenchmark::Culling()
+{
+	const uint count = BENCHMARK_CULLING_BOXES;
+
+	std::vector<AABB> boxes(count);
+	LCG random(1234u);
+	for (uint i = 0u; i < count; ++i)
+	{
+		float3 center(random.Float(-500.f, 500.f), random.Float(-50.f, 50.f), random.Float(-500.f, 500.f));
+		float size = random.Float(0.5f, 8.f);
+		boxes[i] = AABB::FromCenterAndSize(center, float3(size, size, size));
+	}
+
+	Frustum frustum;
+	frustum.type = FrustumType::PerspectiveFrustum;
+	frustum.pos = float3(0.f, 20.f, 0.f);
+	frustum.front = float3(1.f, -0.2f, 0.5f).Normalized();
+	frustum.up = frustum.front.Cross(float3::unitY).Cross(frustum.front).Normalized();
+	frustum.nearPlaneDistance = 0.1f;
+	frustum.farPlaneDistance = 400.f;
+	frustum.verticalFov = math::DegToRad(60.0f);
+	frustum.horizontalFov = 2.f * atanf(tanf(frustum.verticalFov / 2.f) * 16.f / 9.f);
+
+	std::vector<uint> corners_visible, planes_visible;
+	corners_visible.reserve(count);
+	planes_visible.reserve(count);
+
+	FrameVector<uint> culler_visible(App->frame_allocator);
+	culler_visible.reserve(count);
+
+	double corners_ms = 0.0, planes_ms = 0.0, culler_ms = 0.0, fill_ms = 0.0;
+	trPerfTimer timer;
+
+	trFrustumCuller culler;
+
+	for (uint it = 0u; it < BENCHMARK_ITERATIONS; ++it)
+	{
+		// Corners, one box at a time
+		corners_visible.clear();
+		timer.Start();
+		for (uint i = 0u; i < count; ++i)
+		{
+			if (ContainsCorners(frustum, boxes[i]))
+				corners_visible.push_back(i);
+		}
+		corners_ms += timer.ReadMs();
+
+		// Center and extents, planes once, one box at a time
+		planes_visible.clear();
+		timer.Start();
+		Plane planes[6];
+		frustum.GetPlanes(planes);
+		for (uint i = 0u; i < count; ++i)
+		{
+			if (QuadtreeNode::TestAaBox(boxes[i], planes) != FRUSTUM_OUTSIDE)
+				planes_visible.push_back(i);
+		}
+		planes_ms += timer.ReadMs();
+
+		// SoA, 4 boxes per test. Filling the arrays is timed apart, the renderer does it in parallel
+		timer.Start();
+		culler.SetFrustum(frustum);
+		culler.Resize(count);
+		for (uint i = 0u; i < count; ++i)
+			culler.SetBox(i, boxes[i]);
+		fill_ms += timer.ReadMs();
+
+		culler_visible.clear();
+		timer.Start();
+		culler.Cull(culler_visible);
+		culler_ms += timer.ReadMs();
+	}
+
+	// The center-extent test is exact against each plane, same result as the corners
+	bool same = corners_visible.size() == culler_visible.size() && planes_visible.size() == culler_visible.size();
+	for (uint i = 0u; same && i < culler_visible.size(); ++i)
+		same = corners_visible[i] == culler_visible[i] && planes_visible[i] == culler_visible[i];
+
+	TR_LOG("trBenchmark: %u boxes, %u visible", count, culler_visible.size());
+	TR_LOG("trBenchmark: 8 corners:        %.3f ms", corners_ms / BENCHMARK_ITERATIONS);
+	TR_LOG("trBenchmark: Cached planes:    %.3f ms", planes_ms / BENCHMARK_ITERATIONS);
+	TR_LOG("trBenchmark: trFrustumCuller:  %.3f ms (+ %.3f ms filling the arrays)", culler_ms / BENCHMARK_ITERATIONS, fill_ms / BENCHMARK_ITERATIONS);
+
+	if (!same)
+		TR_LOG("trBenchmark: trFrustumCuller results differ from the corners test!");
+}
+
+// ---------------------------------------------
+void trBenchmark::Pools()
+{
+	const uint count = BENCHMARK_POOL_OBJECTS;
+
+	// Local pools, the scene ones are left alone. Slabs are kept between cycles like on a scene clear.
+	trPool<GameObject> go_pool;
+	trPool<ComponentTransform> transform_pool;
+	trPool<ComponentMesh> mesh_pool;
+	trPool<ComponentMaterial> material_pool;
+
+	std::vector<SceneAllocation> scene(count);
+	double heap_load_ms = 0.0, heap_walk_ms = 0.0, heap_clear_ms = 0.0;
+	double pool_load_ms = 0.0, pool_walk_ms = 0.0, pool_clear_ms = 0.0, pool_first_load_ms = 0.0;
+	uint heap_sum = 0u, pool_sum = 0u;
+	trPerfTimer timer;
+
+	for (uint it = 0u; it < BENCHMARK_ITERATIONS; ++it)
+	{
+		// Heap: one allocation per object and component, as before the pools
+		timer.Start();
+		for (uint i = 0u; i < count; ++i)
+		{
+			SceneAllocation& allocation = scene[i];
+			allocation.go = Touch<GameObject>(::operator new(sizeof(GameObject)), i);
+			allocation.name = new char[32];
+			allocation.transform = Touch<ComponentTransform>(::operator new(sizeof(ComponentTransform)), i);
+			if (i % 2u == 0u)
+			{
+				allocation.mesh = Touch<ComponentMesh>(::operator new(sizeof(ComponentMesh)), i);
+				allocation.material = Touch<ComponentMaterial>(::operator new(sizeof(ComponentMaterial)), i);
+			}
+		}
+		heap_load_ms += timer.ReadMs();
+
+		timer.Start();
+		heap_sum += WalkScene(scene);
+		heap_walk_ms += timer.ReadMs();
+
+		timer.Start();
+		for (uint i = 0u; i < count; ++i)
+		{
+			SceneAllocation& allocation = scene[i];
+			::operator delete(allocation.go);
+			RELEASE_ARRAY(allocation.name);
+			::operator delete(allocation.transform);
+			if (allocation.mesh != nullptr)
+			{
+				::operator delete(allocation.mesh);
+				::operator delete(allocation.material);
+			}
+			allocation = SceneAllocation();
+		}
+		heap_clear_ms += timer.ReadMs();
+
+		// Pools, reserved up front like trMainScene does when it loads a scene
+		timer.Start();
+		go_pool.Reserve(count);
+		transform_pool.Reserve(count);
+		mesh_pool.Reserve((count + 1u) / 2u);
+		material_pool.Reserve((count + 1u) / 2u);
+		for (uint i = 0u; i < count; ++i)
+		{
+			SceneAllocation& allocation = scene[i];
+			allocation.go = Touch<GameObject>(go_pool.Allocate(), i);
+			allocation.name = new char[32];
+			allocation.transform = Touch<ComponentTransform>(transform_pool.Allocate(), i);
+			if (i % 2u == 0u)
+			{
+				allocation.mesh = Touch<ComponentMesh>(mesh_pool.Allocate(), i);
+				allocation.material = Touch<ComponentMaterial>(material_pool.Allocate(), i);
+			}
+		}
+		double load_ms = timer.ReadMs();
+		if (it == 0u)
+			pool_first_load_ms = load_ms;
+		pool_load_ms += load_ms;
+
+		timer.Start();
+		pool_sum += WalkScene(scene);
+		pool_walk_ms += timer.ReadMs();
+
+		timer.Start();
+		for (uint i = 0u; i < count; ++i)
+		{
+			SceneAllocation& allocation = scene[i];
+			go_pool.Free(allocation.go);
+			RELEASE_ARRAY(allocation.name);
+			transform_pool.Free(allocation.transform);
+			mesh_pool.Free(allocation.mesh);
+			material_pool.Free(allocation.material);
+			allocation = SceneAllocation();
+		}
+		pool_clear_ms += timer.ReadMs();
+	}
+
+	TR_LOG("trBenchmark: %u objects per load, meshes and materials on half of them, %u cycles", count, BENCHMARK_ITERATIONS);
+	TR_LOG("trBenchmark: Heap:  load %.3f ms, walk %.3f ms, clear %.3f ms", heap_load_ms / BENCHMARK_ITERATIONS, heap_walk_ms / BENCHMARK_ITERATIONS, heap_clear_ms / BENCHMARK_ITERATIONS);
+	TR_LOG("trBenchmark: Pools: load %.3f ms (first one %.3f ms), walk %.3f ms, clear %.3f ms", pool_load_ms / BENCHMARK_ITERATIONS, pool_first_load_ms, pool_walk_ms / BENCHMARK_ITERATIONS, pool_clear_ms / BENCHMARK_ITERATIONS);
+	TR_LOG("trBenchmark: %u GameObject slabs after %u loads", go_pool.GetSlabCount(), BENCHMARK_ITERATIONS);
+
+	if (heap_sum != pool_sum)
+		TR_LOG("trBenchmark: Pooled objects read differently from the heap ones!");
+}
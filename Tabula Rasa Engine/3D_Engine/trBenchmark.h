@@ -0,0 +1,46 @@
+#ifndef __trBENCHMARK_H__
+#define __trBENCHMARK_H__
+
+#include "trDefs.h"
+
+#define BENCHMARK_TRANSFORMS 100000
+#define BENCHMARK_ITERATIONS 20
+#define BENCHMARK_INSTANCES 10000
+#define BENCHMARK_QUADTREE_OBJECTS 50000
+#define BENCHMARK_PICKING_GRID 400		// quads per side, two triangles each
+#define BENCHMARK_PICKING_RAYS 1000
+#define BENCHMARK_CULLING_BOXES 100000
+#define BENCHMARK_POOL_OBJECTS 50000
+
+// Micro benchmarks run with --benchmark=name once every module has started.
+// Results go to the log, the app quits after the next frame.
+class trBenchmark
+{
+public:
+
+	// False if there is no benchmark with that name
+	static bool Run(const char* name);
+
+private:
+
+	// SoA sweep (serial and parallel, 10% and 100% dirty) against a pointer chasing hierarchy,
+	// and the SSE matrix product against the scalar one
+	static void Transforms();
+
+	// trMainScene::Instantiate against cloning the prototype one object at a time
+	static void Instantiate();
+
+	// Frustum queries on the quadtree against testing every box
+	static void QuadtreeQueries();
+
+	// Closest hit through the triangle BVH against testing every triangle
+	static void Picking();
+
+	// trFrustumCuller against the 8 corners test and the cached planes test, one box at a time
+	static void Culling();
+
+	// Scene load and clear cycles with the pools against the heap, same object sizes
+	static void Pools();
+};
+
+#endif // __trBENCHMARK_H__
@@ -15,6 +15,7 @@
 trCamera3D::trCamera3D() : trModule()
 {
 	this->name = "Camera3D";
+	phases = PHASE_UPDATE;
 
 }
 
@@ -23,6 +24,16 @@ trCamera3D::~trCamera3D()
 	RELEASE(dummy_camera);
 }
 
+// ---------------------------------------------
+void trCamera3D::DeclareDependencies()
+{
+	// Mouse picking only queries the scene, the selection lives in the editor
+	Reads(App->input);
+	Reads(App->window);
+	Reads(App->main_scene);
+	Writes(App->editor);
+}
+
 bool trCamera3D::Awake(JSON_Object* config)
 {
 	dummy_camera = new ComponentCamera(nullptr);
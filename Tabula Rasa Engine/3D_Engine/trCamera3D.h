@@ -32,6 +32,8 @@ public:
 	void OnPickGameObject();
 
 	bool CleanUp();
+
+	void DeclareDependencies();
 	
 public:
 
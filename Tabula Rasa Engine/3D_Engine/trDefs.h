@@ -69,7 +69,7 @@ inline const char* const PATH(const char* folder, const char* file)
 
 // Performance macros
 #define PERF_START(timer) timer.Start()
-#define PERF_PEEK(timer) LOG("%s took %f ms", __FUNCTION__, timer.ReadMs())
+#define PERF_PEEK(timer) TR_LOG("%s took %f ms", __FUNCTION__, timer.ReadMs())
 
 // Maths calculations
 #define PI 3.14159265359f
@@ -103,6 +103,9 @@ inline const char* const PATH(const char* folder, const char* file)
 #define A_VERSION "v0.3.1-development"
 #define A_FPS_CAP true
 #define A_FPS_CAP_VALUE 60
+#define A_FIXED_TIMESTEP false
+#define A_TICK_RATE 60
+#define A_MAX_CATCH_UP_STEPS 5
 /// Window
 #define W_WIDTH 500
 #define W_HEIGHT 500
@@ -5,6 +5,11 @@
 #include "trCamera3D.h"
 #include "trRenderer3D.h"
 #include "trInput.h"
+#include "trMainScene.h"
+#include "trHardware.h"
+#include "trFileSystem.h"
+#include "trTimeManager.h"
+#include "trAnimation.h"
 
 #include "Panel.h"
 #include "PanelAbout.h"
@@ -16,6 +21,7 @@
 #include "PanelControl.h"
 
 #include "GameObject.h"
+#include "trProfiler.h"
 
 #include "ImGui/imgui.h"
 #include "ImGui/imgui_impl_sdl.h"
@@ -36,6 +42,7 @@
 trEditor::trEditor() : trModule()
 {
 	this->name = "Editor";
+	phases = PHASE_ALL;
 }
 
 // Destructor
@@ -43,6 +50,21 @@ trEditor::~trEditor()
 {
 }
 
+// ---------------------------------------------
+void trEditor::DeclareDependencies()
+{
+	// Panels inspect and modify most of the engine
+	Reads(App->input);
+	Reads(App->window);
+	Reads(App->camera);
+	Reads(App->file_system);
+	Reads(App->hardware);
+	Writes(App->main_scene);
+	Writes(App->animation);
+	Writes(App->time_manager);
+	Writes(App->render);
+}
+
 bool trEditor::Start()
 {
 	// Setup Dear ImGui binding
@@ -114,7 +136,11 @@ bool trEditor::Start()
 	//Panels
 	about = new PanelAbout();
 	config = new PanelConfiguration();
-	console = new PanelConsole(init_logs);
+	{
+		std::lock_guard<std::mutex> lock(logs_mutex);
+		console = new PanelConsole(pending_logs);
+		pending_logs.clear();
+	}
 	inspector = new PanelInspector();
 	hierarchy = new PanelHierarchy();
 	resources = new PanelResources();
@@ -127,11 +153,16 @@ bool trEditor::Start()
 	panels.push_back(resources);
 	panels.push_back(control);
 
+	destroyed_subscription = App->event_bus.Subscribe(Event::GAMEOBJECT_DESTROYED,
+		[this](const Event* events, uint count) { OnGameObjectsDestroyed(events, count); });
+
 	return true;
 }
 
 bool trEditor::PreUpdate(float dt)
 {
+	FlushLogs();
+
 	ImGui_ImplOpenGL3_NewFrame();
 	ImGui_ImplSDL2_NewFrame(App->window->GetWindow());
 	ImGui::NewFrame();
@@ -152,6 +183,10 @@ bool trEditor::Update(float dt)
 	if (App->input->GetKey(SDL_SCANCODE_LALT) == KEY_REPEAT && App->input->GetKey(SDL_SCANCODE_G) == KEY_DOWN)
 		show_imgui = !show_imgui;
 
+	// Dump the last frames as a Chrome trace
+	if (App->input->GetKey(SDL_SCANCODE_LALT) == KEY_REPEAT && App->input->GetKey(SDL_SCANCODE_P) == KEY_DOWN)
+		trProfiler::DumpChromeTrace();
+
 	if (!ImGuizmo::IsUsing())
 	{
 		if (App->input->GetKey(SDL_SCANCODE_W) == KEY_DOWN)
@@ -173,6 +208,12 @@ bool trEditor::Update(float dt)
 				App->Save();
 			if (ImGui::MenuItem("Load"))
 				App->Load();
+			if (ImGui::MenuItem("Save streamed scene")) {
+				std::string output_file;
+				App->main_scene->streamer.Save(App->main_scene->scene_name.c_str(), STREAM_CELL_SIZE, output_file);
+			}
+			if (ImGui::MenuItem("Dump profile trace", "Alt+P"))
+				trProfiler::DumpChromeTrace();
 			if (ImGui::MenuItem("Quit", "Alt+F4"))
 				have_to_quit = true;
 
@@ -255,6 +296,8 @@ bool trEditor::PostUpdate(float dt)
 bool trEditor::CleanUp()
 {
 	Log("trEditor: CleanUp");
+	App->event_bus.Unsubscribe(destroyed_subscription);
+
 	std::vector<Panel*>::iterator it = panels.begin();
 
 	while (it != panels.end()) {
@@ -262,26 +305,33 @@ bool trEditor::CleanUp()
 		it++;
 	}
 	panels.clear();
+	console = nullptr;
 
-	init_logs.clear();
+	{
+		std::lock_guard<std::mutex> lock(logs_mutex);
+		pending_logs.clear();
+	}
 
-	ImGui_ImplOpenGL3_Shutdown();
-	ImGui_ImplSDL2_Shutdown();
-	ImGui::DestroyContext();
+	// Never started in headless mode
+	if (!App->IsHeadless()) {
+		ImGui_ImplOpenGL3_Shutdown();
+		ImGui_ImplSDL2_Shutdown();
+		ImGui::DestroyContext();
+	}
 	this->active = false;
 	return true;
 }
 
-void trEditor::OnEventReceived(const Event & event)
+void trEditor::OnGameObjectsDestroyed(const Event* events, uint count)
 {
-	if (event.GetType() == Event::event_type::GAMEOBJECT_DESTROYED) {
-		this->selected = nullptr; // for now
-	}
+	// The objects are released already, a stale handle is how the selection tells
+	if (!selected.IsNull() && App->main_scene->GetGameObject(selected) == nullptr)
+		selected = GameObjectHandle();
 }
 
 void trEditor::Draw()
 {
-	if (selected)
+	if (GetSelected() != nullptr)
 		DisplayGuizmos();
 
 	ImGui::Render();
@@ -295,21 +345,36 @@ void trEditor::InfoFPSMS(float current_fps, float current_ms, int frames)
 
 void trEditor::Log(const char * new_log)
 {
-	if (console != nullptr)
-		console->AddLogToConsole(new_log);
-	else 
-		init_logs.push_back(new_log);
+	std::lock_guard<std::mutex> lock(logs_mutex);
+	pending_logs.push_back(new_log);
+}
+
+// Main thread, the console buffer is read by ImGui
+void trEditor::FlushLogs()
+{
+	if (console == nullptr)
+		return;
+
+	std::vector<std::string> logs;
+	{
+		std::lock_guard<std::mutex> lock(logs_mutex);
+		logs.swap(pending_logs);
+	}
+
+	for (uint i = 0u; i < logs.size(); ++i)
+		console->AddLogToConsole(logs[i].c_str());
 }
 
 GameObject * trEditor::GetSelected() const
 {
-	return selected;
+	// nullptr if it was destroyed
+	return App->main_scene->GetGameObject(selected);
 }
 
 void trEditor::SetSelected(GameObject * selected)
 {
 	if (!ImGui::IsMouseHoveringAnyWindow() && !ImGuizmo::IsOver())
-		this->selected = selected;
+		this->selected = selected != nullptr ? selected->GetHandle() : GameObjectHandle();
 }
 
 void trEditor::DisplayGuizmos()
@@ -322,9 +387,11 @@ void trEditor::DisplayGuizmos()
 	ImGuiIO& io = ImGui::GetIO();
 	ImGuizmo::SetRect(0, 0, io.DisplaySize.x, io.DisplaySize.y);
 
+	GameObject* selected_go = GetSelected();
+
 	float4x4 view_matrix(App->camera->dummy_camera->GetViewMatrix());
 	float4x4 proj_matrix(App->camera->dummy_camera->GetProjectionMatrix());
-	float4x4 transform_matrix(selected->GetTransform()->GetMatrix());
+	float4x4 transform_matrix(selected_go->GetTransform()->GetMatrix());
 	transform_matrix = transform_matrix.Transposed();
 
 	ImGuizmo::Manipulate(view_matrix.ptr(),
@@ -340,7 +407,7 @@ void trEditor::DisplayGuizmos()
 		float3 new_scale;
 
 		transform_matrix = transform_matrix.Transposed();
-		selected->GetTransform()->SetupFromGlobalMatrix(transform_matrix);
+		selected_go->GetTransform()->SetupFromGlobalMatrix(transform_matrix);
 		// old way
 		//transform_matrix.Decompose(new_pos, new_rot, new_scale);
 		//selected->GetTransform()->Setup(new_pos, new_scale, new_rot);
@@ -1,7 +1,9 @@
 #pragma once
 #include "trModule.h"
 #include "trDefs.h"
+#include "GameObjectHandle.h"
 
+#include <mutex>
 #include <vector>
 #include <string>
 
@@ -18,6 +20,7 @@ class PanelControl;
 
 class Mesh;
 class Texture;
+class Event;
 
 class GameObject;
 
@@ -34,12 +37,13 @@ public:
 	bool PostUpdate(float dt);
 	bool CleanUp();
 
-	void OnEventReceived(const Event& event);
+	void DeclareDependencies();
 
 	void Draw();
 
 	void InfoFPSMS(float current_fps, float current_ms, int frames);
 
+	// Any thread, the line reaches the console on the next PreUpdate
 	void Log(const char* new_log);
 
 	GameObject* GetSelected()const;
@@ -47,6 +51,11 @@ public:
 
 	void DisplayGuizmos();
 
+private:
+
+	void OnGameObjectsDestroyed(const Event* events, uint count);
+	void FlushLogs();
+
 public:
 
 	//panels
@@ -62,11 +71,14 @@ public:
 
 private:
 
-	std::vector<std::string> init_logs;
+	// Workers log too, only the main thread touches the console
+	std::mutex logs_mutex;
+	std::vector<std::string> pending_logs;
 
 	std::vector<Panel*> panels;
 
-	GameObject* selected = nullptr;
+	GameObjectHandle selected;
+	uint destroyed_subscription = 0u;
 
 	//default imgui demo window
 	bool show_demo_window = false;
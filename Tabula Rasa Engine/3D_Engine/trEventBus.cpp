@@ -0,0 +1,89 @@
+// ----------------------------------------------------
+// trEventBus.cpp
+// Queued, per type delivery of engine events
+// ----------------------------------------------------
+
+#include "trEventBus.h"
+
+#include <algorithm>
+
+static bool EventLess(const Event& a, const Event& b)
+{
+	if (a.uid != b.uid)
+		return a.uid < b.uid;
+	return a.game_object < b.game_object;
+}
+
+trEventBus::trEventBus()
+{}
+
+trEventBus::~trEventBus()
+{
+	Clear();
+}
+
+// ---------------------------------------------
+uint trEventBus::Subscribe(Event::event_type type, const Handler& handler)
+{
+	Subscriber subscriber;
+	subscriber.id = next_id++;
+	subscriber.handler = handler;
+	subscribers[type].push_back(subscriber);
+
+	return subscriber.id;
+}
+
+void trEventBus::Unsubscribe(uint id)
+{
+	for (uint type = 0u; type < Event::EVENT_TYPE_COUNT; ++type)
+	{
+		for (std::vector<Subscriber>::iterator it = subscribers[type].begin(); it != subscribers[type].end(); ++it)
+		{
+			if ((*it).id == id)
+			{
+				subscribers[type].erase(it);
+				return;
+			}
+		}
+	}
+}
+
+// ---------------------------------------------
+void trEventBus::Publish(const Event& event)
+{
+	// Nobody listening, nothing to queue
+	if (subscribers[event.GetType()].empty())
+		return;
+
+	std::lock_guard<std::mutex> lock(queue_mutex);
+	queue[event.GetType()].push_back(event);
+}
+
+void trEventBus::Flush()
+{
+	for (uint type = 0u; type < Event::EVENT_TYPE_COUNT; ++type)
+	{
+		{
+			std::lock_guard<std::mutex> lock(queue_mutex);
+			if (queue[type].empty())
+				continue;
+			batch.swap(queue[type]);
+		}
+
+		// Coalesce: the batch is delivered sorted by payload without duplicates
+		std::sort(batch.begin(), batch.end(), EventLess);
+		batch.erase(std::unique(batch.begin(), batch.end()), batch.end());
+
+		for (uint i = 0u; i < subscribers[type].size(); ++i)
+			subscribers[type][i].handler(batch.data(), batch.size());
+
+		batch.clear();
+	}
+}
+
+void trEventBus::Clear()
+{
+	std::lock_guard<std::mutex> lock(queue_mutex);
+	for (uint type = 0u; type < Event::EVENT_TYPE_COUNT; ++type)
+		queue[type].clear();
+}
@@ -0,0 +1,55 @@
+#ifndef __trEVENTBUS_H__
+#define __trEVENTBUS_H__
+
+#include "trDefs.h"
+#include "Event.h"
+
+#include <functional>
+#include <mutex>
+#include <vector>
+
+// Events are queued while the frame runs and delivered in batches on Flush.
+// Subscribers only hear about the types they asked for, duplicates in a batch are dropped.
+// Batches are sorted by payload, don't rely on publishing order within a type.
+class trEventBus
+{
+public:
+
+	typedef std::function<void(const Event* events, uint count)> Handler;
+
+private:
+
+	struct Subscriber
+	{
+		uint id = 0u;
+		Handler handler;
+	};
+
+public:
+
+	trEventBus();
+	~trEventBus();
+
+	// Returns an id for Unsubscribe
+	uint Subscribe(Event::event_type type, const Handler& handler);
+	void Unsubscribe(uint id);
+
+	// Thread safe, the event is delivered on the next Flush
+	void Publish(const Event& event);
+
+	// Delivers everything queued so far. Events published by the handlers wait for the next Flush.
+	void Flush();
+
+	// Drops the queued events without delivering them
+	void Clear();
+
+private:
+
+	std::vector<Subscriber> subscribers[Event::EVENT_TYPE_COUNT];
+	std::vector<Event> queue[Event::EVENT_TYPE_COUNT];
+	std::vector<Event> batch;
+	std::mutex queue_mutex;
+	uint next_id = 1u;
+};
+
+#endif // __trEVENTBUS_H__
@@ -7,12 +7,17 @@
 #include "trMainScene.h"
 
 #include "SceneImporter.h"
-#include "MaterialImporter.h"
+#include "trResources.h"
 #include "trAnimation.h"
 
+#include <memory>
+#include <string>
+
 trFileLoader::trFileLoader()
 {
 	this->name = "FileLoader";
+	phases = PHASE_NONE;
+	concurrent_awake = true;
 }
 
 trFileLoader::~trFileLoader()
@@ -20,8 +25,6 @@ trFileLoader::~trFileLoader()
 
 bool trFileLoader::Awake(JSON_Object* config)
 {
-	mesh_importer = new SceneImporter();
-	material_importer = new MaterialImporter();
 	return true;
 }
 
@@ -47,9 +50,6 @@ bool trFileLoader::CleanUp()
 {
 	TR_LOG("Cleaning File Loader");
 
-	RELEASE(mesh_importer);
-	RELEASE(material_importer);
-
 	return true;
 }
 
@@ -62,7 +62,7 @@ void trFileLoader::ImportFBX(const char* file_path)
 	// Then get the file_path from de Assets continue
 
 	std::string output;
-	mesh_importer->Import(file_path, output);
+	App->resources->GetSceneImporter()->Import(file_path, output);
 
 }
 
@@ -73,35 +73,47 @@ void trFileLoader::ImportTexture(const char * file_path)
 	// Then get the file_path from de Assets continue
 }
 
-void trFileLoader::ImportScene(const char * file_path, bool and_delete_all, bool only_animation)
+void trFileLoader::ImportScene(const char * file_path, bool and_delete_all, bool only_animation, const std::function<void()>& on_loaded)
 {
-	// TODO: copy paste FBX file to Assets/
+	if (file_path == nullptr)
+		return;
 
-	// Then get the file_path from de Assets continue
+	std::string scene_path(A_SCENES_DIR);
+	scene_path.append("/");
+	scene_path.append(file_path);
 
-	if (file_path != nullptr)
+	// Queued behind any write of the same scene still on its way to disk
+	std::shared_ptr<JSON_Value*> result = std::make_shared<JSON_Value*>(nullptr);
+	App->async_io.Submit([result, scene_path]()
 	{
-		std::string tmp_str(A_SCENES_DIR);
-		tmp_str.append("/");
-		tmp_str.append(file_path);
-
-		// Clear previous scene
-		if(and_delete_all)
-			App->main_scene->ClearScene(true);
-		//App->animation->CleanAnimableGOS();
-
 		char* buffer = nullptr;
-		uint size = App->file_system->ReadFromFile(tmp_str.c_str(), &buffer);
+		uint size = App->file_system->ReadFromFile(scene_path.c_str(), &buffer);
 
+		// Not null terminated
 		if (buffer != nullptr && size > 0)
+			*result = json_parse_string(std::string(buffer, size).c_str());
+		RELEASE_ARRAY(buffer);
+
+		return *result != nullptr;
+	},
+	[result, scene_path, and_delete_all, only_animation, on_loaded](bool success)
+	{
+		if (!success)
 		{
-			App->main_scene->DeSerializeScene(buffer, only_animation);
-			RELEASE_ARRAY(buffer);
+			TR_LOG("trFileLoader: Error reading scene from path: %s", scene_path.c_str());
+			return;
 		}
-		else 
-			TR_LOG("trFileLoader: Error reading scene from path: %s", tmp_str.c_str());
-		
-	}
+
+		// The previous scene stays until the new one is ready
+		if (and_delete_all)
+			App->main_scene->ClearScene(true);
+
+		App->main_scene->DeSerializeScene(*result, only_animation);
+		json_value_free(*result);
+
+		if (on_loaded)
+			on_loaded();
+	});
 }
 
 
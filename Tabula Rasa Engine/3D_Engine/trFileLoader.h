@@ -5,10 +5,9 @@
 #include "trDefs.h"
 #include "MathGeoLib\MathGeoLib.h"
 
-struct Mesh;
+#include <functional>
 
-class SceneImporter;
-class MaterialImporter;
+struct Mesh;
 
 class trFileLoader : public trModule
 {
@@ -26,14 +25,12 @@ public:
 
 	void ImportFBX(const char* file_path);
 	void ImportTexture(const char* file_path);
-	void ImportScene(const char* file_path, bool and_delete_all = true, bool only_animation = false);
+	// Read and parsed on the io thread, the scene is built on the main thread a few frames later.
+	// on_loaded runs right after it, only if the scene could be loaded.
+	void ImportScene(const char* file_path, bool and_delete_all = true, bool only_animation = false, const std::function<void()>& on_loaded = nullptr);
 
 	bool LoadMeshFile(const char* file_path);
 
-public:
-	SceneImporter* mesh_importer = nullptr;
-	MaterialImporter* material_importer = nullptr;
-
 };
 
 #endif // __FILE_LOADER_H__
@@ -12,10 +12,20 @@
 trFileSystem::trFileSystem()
 {
 	this->name = "FileSystem";
+	phases = PHASE_UPDATE;
+	main_thread_only = false;
+	concurrent_awake = true;
 }
 
 trFileSystem::~trFileSystem() { RELEASE(assets_dir); }
 
+// ---------------------------------------------
+void trFileSystem::DeclareDependencies()
+{
+	// Assets changes are reported to resources through a flag, see trResources::PostUpdate
+	Reads(App->time_manager);
+}
+
 bool trFileSystem::Awake(JSON_Object * config)
 {
 	// Initializing PhysFS library
@@ -127,7 +137,8 @@ bool trFileSystem::Update(float dt)
 			// Case 3: asset has been added / renamed
 			if (!file_found)
 			{
-				App->resources->CheckForChangesInAssets(assets_dir);
+				// Update may run on a worker, resources picks it up on the main thread
+				assets_changed = true;
 				// TODO: send event that file 'assets_files[i]' has been added / renamed
 			}
 
@@ -148,6 +159,10 @@ bool trFileSystem::CleanUp()
 
 	TR_LOG("trFileSystem: deinitializing PHYSFS...\n");
 
+	for (std::map<std::string, std::pair<char*, uint>>::iterator it = prefetched.begin(); it != prefetched.end(); ++it)
+		RELEASE_ARRAY(it->second.first);
+	prefetched.clear();
+
 	if (PHYSFS_deinit() != 0)
 	{
 		ret = true;
@@ -424,6 +439,19 @@ bool trFileSystem::WriteInFile(const char* file_name, char* buffer, uint size) c
 
 uint trFileSystem::ReadFromFile(const char* file_name, char** buffer)
 {
+	{
+		std::lock_guard<std::mutex> lock(prefetch_mutex);
+
+		std::map<std::string, std::pair<char*, uint>>::iterator it = prefetched.find(file_name);
+		if (it != prefetched.end())
+		{
+			*buffer = it->second.first;
+			uint size = it->second.second;
+			prefetched.erase(it);
+			return size;
+		}
+	}
+
 	uint size = 0u;
 	PHYSFS_File* file = OpenFileForReading(file_name);
 
@@ -447,6 +475,51 @@ uint trFileSystem::ReadFromFile(const char* file_name, char** buffer)
 	return size;
 }
 
+bool trFileSystem::Prefetch(const char* file_name)
+{
+	{
+		std::lock_guard<std::mutex> lock(prefetch_mutex);
+		if (prefetched.find(file_name) != prefetched.end())
+			return true;
+	}
+
+	PHYSFS_File* file = PHYSFS_openRead(file_name);
+	if (file == nullptr)
+		return false;
+
+	uint size = PHYSFS_fileLength(file);
+	char* buffer = new char[size];
+	bool ret = PHYSFS_readBytes(file, buffer, size) != -1;
+	PHYSFS_close(file);
+
+	if (!ret) {
+		RELEASE_ARRAY(buffer);
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(prefetch_mutex);
+
+	// Prefetched meanwhile from another thread
+	if (!prefetched.insert(std::make_pair(std::string(file_name), std::make_pair(buffer, size))).second)
+		RELEASE_ARRAY(buffer);
+
+	return true;
+}
+
+void trFileSystem::DropPrefetched(const std::vector<std::string>& file_names)
+{
+	std::lock_guard<std::mutex> lock(prefetch_mutex);
+
+	for (uint i = 0u; i < file_names.size(); ++i)
+	{
+		std::map<std::string, std::pair<char*, uint>>::iterator it = prefetched.find(file_names[i]);
+		if (it != prefetched.end()) {
+			RELEASE_ARRAY(it->second.first);
+			prefetched.erase(it);
+		}
+	}
+}
+
 void trFileSystem::GetFileFileNameFromPath(const char* file_path, std::string& file_name)
 {
 	std::string tmp = file_path;
@@ -4,6 +4,9 @@
 #define REFRESH_TIME 2.0f
 
 #include "trModule.h"
+#include <map>
+#include <mutex>
+#include <string>
 #include <vector>
 
 
@@ -46,6 +49,8 @@ public:
 	bool Update(float dt);
 	bool CleanUp();
 
+	void DeclareDependencies();
+
 	bool DoesFileExist(const char* file_name) const;
 	bool DoesDirExist(const char* dir_name) const;
 
@@ -53,8 +58,14 @@ public:
 	void RefreshDirectory(const char* dir_name);
 
 	bool WriteInFile(const char* file_name, char* buffer, uint size) const;
+	// Takes the prefetched buffer if there is one
 	uint ReadFromFile(const char* file_name, char** buffer);
 
+	// Any thread, nothing is logged. The whole file is kept until ReadFromFile takes it.
+	bool Prefetch(const char* file_name);
+	// Frees the ones nobody read
+	void DropPrefetched(const std::vector<std::string>& file_names);
+
 	void GetExtensionFromFile(const char* file_name, std::string& extension);
 	void GetFileFileNameFromPath(const char* file_path, std::string& file_name);
 	
@@ -67,6 +78,11 @@ public:
 	Directory* GetAssetsDirectory() const;
 
 	bool CopyFileFrom(const char* src_file_path);
+
+public:
+
+	// Set by the assets refresh when new files show up
+	bool assets_changed = false;
 		
 private:
 
@@ -81,6 +97,9 @@ private:
 
 
 private:
+	std::mutex prefetch_mutex;
+	std::map<std::string, std::pair<char*, uint>> prefetched;
+
 	float refresh_clock = 0;
 	uint assets_index = 0u;
 	Directory* assets_dir = nullptr;
@@ -0,0 +1,92 @@
+// ----------------------------------------------------
+// trFrameAllocator.cpp
+// Per frame bump allocator
+// ----------------------------------------------------
+
+#include "trFrameAllocator.h"
+#include "trLog.h"
+
+trFrameAllocator::trFrameAllocator(size_t capacity) : capacity(capacity)
+{
+	buffer = new char[capacity];
+	offset = 0u;
+}
+
+trFrameAllocator::~trFrameAllocator()
+{
+	Reset();
+	RELEASE_ARRAY(buffer);
+}
+
+// ---------------------------------------------
+void* trFrameAllocator::Allocate(size_t size, size_t alignment)
+{
+	size_t current = offset.load();
+	size_t aligned = 0u;
+
+	do
+	{
+		// Alignment is relative to the real address, alignment must be a power of two
+		size_t address = (size_t)buffer + current;
+		aligned = ((address + alignment - 1u) & ~(alignment - 1u)) - (size_t)buffer;
+
+		if (aligned + size > capacity)
+			return AllocateOverflow(size, alignment);
+
+	} while (!offset.compare_exchange_weak(current, aligned + size));
+
+	return buffer + aligned;
+}
+
+void* trFrameAllocator::AllocateOverflow(size_t size, size_t alignment)
+{
+	char* block = new char[size + alignment];
+
+	std::lock_guard<std::mutex> lock(overflow_mutex);
+	overflow_blocks.push_back(block);
+	overflow_size += size + alignment;
+
+	size_t address = (size_t)block;
+	return block + (((address + alignment - 1u) & ~(alignment - 1u)) - address);
+}
+
+// ---------------------------------------------
+void trFrameAllocator::Reset()
+{
+	size_t used = offset.load() + overflow_size;
+	peak = MAX(peak, used);
+
+	for (uint i = 0u; i < overflow_blocks.size(); ++i)
+		RELEASE_ARRAY(overflow_blocks[i]);
+	overflow_blocks.clear();
+
+	// Didn't fit this frame: grow so the next ones do
+	if (overflow_size > 0u)
+	{
+		while (capacity < used)
+			capacity *= 2u;
+
+		RELEASE_ARRAY(buffer);
+		buffer = new char[capacity];
+		overflow_size = 0u;
+		TR_LOG("trFrameAllocator: Frame arena grown to %u KB", (uint)(capacity / 1024u));
+	}
+
+	offset = 0u;
+}
+
+// ---------------------------------------------
+size_t trFrameAllocator::GetCapacity() const
+{
+	return capacity;
+}
+
+size_t trFrameAllocator::GetUsed() const
+{
+	return offset.load() + overflow_size;
+}
+
+size_t trFrameAllocator::GetPeak() const
+{
+	return peak;
+}
@@ -0,0 +1,90 @@
+#ifndef __trFRAMEALLOCATOR_H__
+#define __trFRAMEALLOCATOR_H__
+
+#include "trDefs.h"
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#define FRAME_ALLOCATOR_DEFAULT_SIZE (1024u * 1024u)
+
+// Linear scratch memory for data that doesn't outlive the frame.
+// Allocating bumps an offset, nothing is freed until Reset (end of frame).
+// If a frame needs more than the capacity the extra goes to the heap and
+// the arena grows on the next Reset, so the steady state doesn't touch the heap.
+class trFrameAllocator
+{
+public:
+
+	trFrameAllocator(size_t capacity = FRAME_ALLOCATOR_DEFAULT_SIZE);
+	~trFrameAllocator();
+
+	// Thread safe
+	void* Allocate(size_t size, size_t alignment = sizeof(void*));
+
+	template<typename T>
+	T* AllocateArray(size_t count)
+	{
+		return (T*)Allocate(sizeof(T) * count, alignof(T));
+	}
+
+	// Everything allocated this frame becomes invalid
+	void Reset();
+
+	size_t GetCapacity() const;
+	size_t GetUsed() const;
+	size_t GetPeak() const;
+
+private:
+
+	void* AllocateOverflow(size_t size, size_t alignment);
+
+private:
+
+	char* buffer = nullptr;
+	size_t capacity = 0u;
+	std::atomic<size_t> offset;
+	size_t peak = 0u;
+
+	// Only used when a frame doesn't fit
+	std::mutex overflow_mutex;
+	std::vector<char*> overflow_blocks;
+	size_t overflow_size = 0u;
+};
+
+// STL adapter. Deallocate is a no-op, the memory goes back on Reset.
+template<typename T>
+class trFrameStlAllocator
+{
+public:
+
+	typedef T value_type;
+
+	trFrameStlAllocator(trFrameAllocator& arena) : arena(&arena) {}
+
+	template<typename U>
+	trFrameStlAllocator(const trFrameStlAllocator<U>& other) : arena(other.arena) {}
+
+	T* allocate(size_t count) { return arena->AllocateArray<T>(count); }
+	void deallocate(T* pointer, size_t count) {}
+
+	template<typename U>
+	bool operator==(const trFrameStlAllocator<U>& other) const { return arena == other.arena; }
+	template<typename U>
+	bool operator!=(const trFrameStlAllocator<U>& other) const { return arena != other.arena; }
+
+public:
+
+	trFrameAllocator* arena = nullptr;
+};
+
+// Containers on the frame arena, construct them with the arena: FrameVector<int> numbers(App->frame_allocator);
+template<typename T>
+using FrameVector = std::vector<T, trFrameStlAllocator<T>>;
+
+template<typename Key, typename T, typename Compare = std::less<Key>>
+using FrameMap = std::map<Key, T, Compare, trFrameStlAllocator<std::pair<const Key, T>>>;
+
+#endif // __trFRAMEALLOCATOR_H__
@@ -0,0 +1,155 @@
+// ----------------------------------------------------
+// trFramePacer.cpp
+// Deadline based frame cap with hybrid sleep/spin
+// ----------------------------------------------------
+
+#include "trFramePacer.h"
+#include "trPerfTimer.h"
+#include "SDL\include\SDL_timer.h"
+
+#include <emmintrin.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#pragma comment (lib, "winmm.lib")
+#endif
+
+#define MIN_SPIN_MS 0.2
+#define MAX_SPIN_MS 2.0
+
+trFramePacer::trFramePacer()
+{
+	frequency = trPerfTimer::GetFrequency();
+	last_frame_end = next_deadline = SDL_GetPerformanceCounter();
+
+	memset(history, 0, sizeof(history));
+	memset(buckets, 0, sizeof(buckets));
+
+#ifdef _WIN32
+	// 1ms scheduler granularity, otherwise SDL_Delay can't get below ~15ms
+	timeBeginPeriod(1);
+#endif
+}
+
+trFramePacer::~trFramePacer()
+{
+#ifdef _WIN32
+	timeEndPeriod(1);
+#endif
+}
+
+// ---------------------------------------------
+void trFramePacer::SetTargetFramerate(uint framerate)
+{
+	period = framerate > 0u ? frequency / framerate : 0u;
+	next_deadline = SDL_GetPerformanceCounter();
+}
+
+void trFramePacer::EndFrame(bool cap)
+{
+	if (cap && period > 0u)
+	{
+		next_deadline += period;
+
+		uint64 now = SDL_GetPerformanceCounter();
+
+		// A missed deadline moves the schedule instead of rushing the next frames
+		if (now >= next_deadline)
+			next_deadline = now;
+		else
+			WaitUntil(next_deadline);
+	}
+	else
+		next_deadline = SDL_GetPerformanceCounter();
+
+	uint64 frame_end = SDL_GetPerformanceCounter();
+	Record((float)TicksToMs(frame_end - last_frame_end));
+	last_frame_end = frame_end;
+}
+
+// ---------------------------------------------
+float trFramePacer::GetPercentileMs(float percentile) const
+{
+	if (history_count == 0u)
+		return 0.f;
+
+	uint target = (uint)(percentile * (float)history_count);
+	if (target >= history_count)
+		target = history_count - 1u;
+
+	uint accumulated = 0u;
+	for (uint i = 0u; i < FRAME_HISTOGRAM_BUCKETS; ++i)
+	{
+		accumulated += buckets[i];
+		if (accumulated > target)
+			return (float)(i + 1u) * FRAME_BUCKET_MS; // upper bound of the bucket
+	}
+
+	return (float)FRAME_HISTOGRAM_BUCKETS * FRAME_BUCKET_MS;
+}
+
+float trFramePacer::GetLastFrameMs() const
+{
+	if (history_count == 0u)
+		return 0.f;
+
+	return history[(history_index + FRAME_HISTORY - 1u) % FRAME_HISTORY];
+}
+
+float trFramePacer::GetMaxFrameMs() const
+{
+	float max_ms = 0.f;
+	for (uint i = 0u; i < history_count; ++i)
+		max_ms = MAX(max_ms, history[i]);
+
+	return max_ms;
+}
+
+// ---------------------------------------------
+void trFramePacer::WaitUntil(uint64 deadline)
+{
+	uint64 now = SDL_GetPerformanceCounter();
+	double remaining_ms = TicksToMs(deadline - now);
+
+	// Coarse sleep, leaving the usual oversleep to the spin
+	if (remaining_ms > spin_ms)
+	{
+		Uint32 sleep_ms = (Uint32)(remaining_ms - spin_ms);
+		if (sleep_ms > 0u)
+		{
+			SDL_Delay(sleep_ms);
+
+			uint64 after_sleep = SDL_GetPerformanceCounter();
+			double oversleep_ms = TicksToMs(after_sleep - now) - (double)sleep_ms;
+			spin_ms = spin_ms * 0.9 + (oversleep_ms + MIN_SPIN_MS) * 0.1;
+			spin_ms = MAX(MIN_SPIN_MS, MIN(MAX_SPIN_MS, spin_ms));
+		}
+	}
+
+	while (SDL_GetPerformanceCounter() < deadline)
+		_mm_pause();
+}
+
+void trFramePacer::Record(float frame_ms)
+{
+	// Evict the oldest frame from the histogram once the window is full
+	if (history_count == FRAME_HISTORY)
+	{
+		uint old_bucket = MIN((uint)(history[history_index] / FRAME_BUCKET_MS), FRAME_HISTOGRAM_BUCKETS - 1u);
+		buckets[old_bucket]--;
+	}
+	else
+		history_count++;
+
+	history[history_index] = frame_ms;
+	history_index = (history_index + 1u) % FRAME_HISTORY;
+
+	uint bucket = MIN((uint)(frame_ms / FRAME_BUCKET_MS), FRAME_HISTOGRAM_BUCKETS - 1u);
+	buckets[bucket]++;
+}
+
+double trFramePacer::TicksToMs(uint64 ticks) const
+{
+	return 1000.0 * (double)ticks / (double)frequency;
+}
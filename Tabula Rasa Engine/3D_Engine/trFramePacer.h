@@ -0,0 +1,51 @@
+#ifndef __trFRAMEPACER_H__
+#define __trFRAMEPACER_H__
+
+#include "trDefs.h"
+
+#define FRAME_HISTORY 600			// frames kept for the percentiles
+#define FRAME_HISTOGRAM_BUCKETS 500
+#define FRAME_BUCKET_MS 0.1f		// last bucket collects everything above 50ms
+
+// Caps the framerate against a deadline: coarse sleep first, then spins the last part.
+// Also keeps a rolling histogram of frame times.
+class trFramePacer
+{
+public:
+
+	trFramePacer();
+	~trFramePacer();
+
+	// 0 means uncapped
+	void SetTargetFramerate(uint framerate);
+
+	// Called once at the end of each frame. Waits for the deadline if capped and records the frame time.
+	void EndFrame(bool cap);
+
+	float GetPercentileMs(float percentile) const;
+	float GetLastFrameMs() const;
+	float GetMaxFrameMs() const;
+
+private:
+
+	void WaitUntil(uint64 deadline);
+	void Record(float frame_ms);
+	double TicksToMs(uint64 ticks) const;
+
+private:
+
+	uint64 frequency = 0u;
+	uint64 period = 0u;			// ticks per frame, 0 if uncapped
+	uint64 next_deadline = 0u;
+	uint64 last_frame_end = 0u;
+
+	// Adaptive: how much we usually oversleep, the spin covers it
+	double spin_ms = 0.5;
+
+	float history[FRAME_HISTORY];
+	uint history_index = 0u;
+	uint history_count = 0u;
+	uint buckets[FRAME_HISTOGRAM_BUCKETS];
+};
+
+#endif // __trFRAMEPACER_H__
@@ -0,0 +1,118 @@
+// ----------------------------------------------------
+// trFrustumCuller.cpp
+// SoA boxes against the frustum planes, 4 per test
+// ----------------------------------------------------
+
+#include "trFrustumCuller.h"
+#include "trProfiler.h"
+
+#include <xmmintrin.h>
+
+trFrustumCuller::trFrustumCuller()
+{
+	for (uint p = 0u; p < 6u; ++p)
+		planes[p][0] = planes[p][1] = planes[p][2] = planes[p][3] = 0.f;
+}
+
+trFrustumCuller::~trFrustumCuller()
+{}
+
+// ---------------------------------------------
+void trFrustumCuller::SetFrustum(const Frustum & frustum)
+{
+	Plane frustum_planes[6];
+	frustum.GetPlanes(frustum_planes);
+
+	for (uint p = 0u; p < 6u; ++p)
+	{
+		planes[p][0] = frustum_planes[p].normal.x;
+		planes[p][1] = frustum_planes[p].normal.y;
+		planes[p][2] = frustum_planes[p].normal.z;
+		planes[p][3] = frustum_planes[p].d;
+	}
+}
+
+void trFrustumCuller::Resize(uint count)
+{
+	this->count = count;
+
+	uint padded = (count + CULLER_LANES - 1u) / CULLER_LANES * CULLER_LANES;
+	center_x.resize(padded);
+	center_y.resize(padded);
+	center_z.resize(padded);
+	extent_x.resize(padded);
+	extent_y.resize(padded);
+	extent_z.resize(padded);
+}
+
+void trFrustumCuller::SetBox(uint index, const AABB & box)
+{
+	float3 center = box.CenterPoint();
+	float3 extents = box.HalfSize();
+
+	center_x[index] = center.x;
+	center_y[index] = center.y;
+	center_z[index] = center.z;
+	extent_x[index] = extents.x;
+	extent_y[index] = extents.y;
+	extent_z[index] = extents.z;
+}
+
+uint trFrustumCuller::GetCount() const
+{
+	return count;
+}
+
+// ---------------------------------------------
+void trFrustumCuller::Cull(FrameVector<uint>& visible) const
+{
+	TR_PROFILE_SCOPE("trFrustumCuller::Cull");
+
+	// Every plane value in all the lanes, once per call
+	__m128 normal_x[6], normal_y[6], normal_z[6];
+	__m128 abs_x[6], abs_y[6], abs_z[6];
+	__m128 d[6];
+
+	for (uint p = 0u; p < 6u; ++p)
+	{
+		normal_x[p] = _mm_set1_ps(planes[p][0]);
+		normal_y[p] = _mm_set1_ps(planes[p][1]);
+		normal_z[p] = _mm_set1_ps(planes[p][2]);
+		abs_x[p] = _mm_set1_ps(Abs(planes[p][0]));
+		abs_y[p] = _mm_set1_ps(Abs(planes[p][1]));
+		abs_z[p] = _mm_set1_ps(Abs(planes[p][2]));
+		d[p] = _mm_set1_ps(planes[p][3]);
+	}
+
+	for (uint i = 0u; i < count; i += CULLER_LANES)
+	{
+		__m128 cx = _mm_loadu_ps(&center_x[i]);
+		__m128 cy = _mm_loadu_ps(&center_y[i]);
+		__m128 cz = _mm_loadu_ps(&center_z[i]);
+		__m128 ex = _mm_loadu_ps(&extent_x[i]);
+		__m128 ey = _mm_loadu_ps(&extent_y[i]);
+		__m128 ez = _mm_loadu_ps(&extent_z[i]);
+
+		// All the planes, no branches: a lane is out as soon as one plane leaves it out
+		__m128 outside = _mm_setzero_ps();
+		for (uint p = 0u; p < 6u; ++p)
+		{
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(normal_x[p], cx), _mm_mul_ps(normal_y[p], cy)), _mm_mul_ps(normal_z[p], cz));
+			distance = _mm_sub_ps(distance, d[p]);
+			__m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(abs_x[p], ex), _mm_mul_ps(abs_y[p], ey)), _mm_mul_ps(abs_z[p], ez));
+
+			outside = _mm_or_ps(outside, _mm_cmpgt_ps(distance, radius));
+		}
+
+		int inside_mask = ~_mm_movemask_ps(outside) & 0xF;
+		if (inside_mask == 0)
+			continue;
+
+		// Lanes past count are padding
+		for (uint lane = 0u; lane < CULLER_LANES && i + lane < count; ++lane)
+		{
+			if (inside_mask & (1 << lane))
+				visible.push_back(i + lane);
+		}
+	}
+}
@@ -0,0 +1,42 @@
+#ifndef __trFRUSTUMCULLER_H__
+#define __trFRUSTUMCULLER_H__
+
+#include "trDefs.h"
+#include "MathGeoLib/MathGeoLib.h"
+#include "trFrameAllocator.h"
+
+#include <vector>
+
+#define CULLER_LANES 4 // boxes per SSE test, the arrays are padded to a multiple of it
+
+// Frustum culling of a batch of boxes. The 6 planes are extracted once per SetFrustum and the
+// boxes are kept SoA as centers and extents, so every test takes CULLER_LANES boxes against a
+// plane: a box is culled when its center is further out than its extents projected on the normal.
+class trFrustumCuller
+{
+public:
+
+	trFrustumCuller();
+	~trFrustumCuller();
+
+	void SetFrustum(const Frustum& frustum);
+
+	// The boxes of the last frame can be overwritten, the memory is kept
+	void Resize(uint count);
+	// Different indices can be set from different threads
+	void SetBox(uint index, const AABB& box);
+	uint GetCount() const;
+
+	// Appends the indices of the boxes touching the frustum, ascending
+	void Cull(FrameVector<uint>& visible) const;
+
+private:
+
+	float planes[6][4];	// normal and d, positive side is outside
+	uint count = 0u;
+
+	std::vector<float> center_x, center_y, center_z;
+	std::vector<float> extent_x, extent_y, extent_z;
+};
+
+#endif // __trFRUSTUMCULLER_H__
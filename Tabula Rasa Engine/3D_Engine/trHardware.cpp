@@ -7,20 +7,10 @@
 trHardware::trHardware()
 {
 	this->name = "Hardware";
-}
-
-trHardware::~trHardware()
-{
-}
-
-bool trHardware::Start()
-{
-	SDL_version sdl_version;
-	SDL_GetVersion(&sdl_version);
-	hw_info.sdl_version[0] = sdl_version.major;
-	hw_info.sdl_version[1] = sdl_version.minor;
-	hw_info.sdl_version[2] = sdl_version.patch;
+	phases = PHASE_NONE;
+	concurrent_awake = true;
 
+	// CPU info is read on construction, the job system is sized from it before any Awake
 	hw_info.cpu_count = SDL_GetCPUCount();
 	hw_info.cache_line_size = SDL_GetCPUCacheLineSize();
 
@@ -36,6 +26,28 @@ bool trHardware::Start()
 	hw_info.has_sse3 = SDL_HasSSE3();
 	hw_info.has_sse41 = SDL_HasSSE41();
 	hw_info.has_sse42 = SDL_HasSSE42();
+}
+
+trHardware::~trHardware()
+{
+}
+
+bool trHardware::Awake(JSON_Object* config)
+{
+	SDL_version sdl_version;
+	SDL_GetVersion(&sdl_version);
+	hw_info.sdl_version[0] = sdl_version.major;
+	hw_info.sdl_version[1] = sdl_version.minor;
+	hw_info.sdl_version[2] = sdl_version.patch;
+
+	return true;
+}
+
+bool trHardware::Start()
+{
+	// No GL context to query
+	if (App->IsHeadless())
+		return true;
 
 	hw_info.gpu_vendor = (char*)glGetString(GL_VENDOR);
 	hw_info.gpu_model = (char*)glGetString(GL_RENDERER);
@@ -53,6 +65,11 @@ trHardware::HWInfo trHardware::GetHardwareInfo() const
 	return hw_info;
 }
 
+uint trHardware::GetCPUCount() const
+{
+	return hw_info.cpu_count;
+}
+
 void trHardware::UpdateVRAMInfo()
 {
 	glGetIntegerv(GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX, &hw_info.vram_available);
@@ -56,9 +56,11 @@ public:
 
 	// Destructor
 	~trHardware();
+	bool Awake(JSON_Object* config = nullptr);
 	bool Start();
 
 	HWInfo GetHardwareInfo() const;
+	uint GetCPUCount() const;
 	void UpdateVRAMInfo();
 
 
@@ -16,6 +16,7 @@
 trInput::trInput() : trModule()
 {
 	this->name = "Input";
+	phases = PHASE_PRE_UPDATE;
 	keyboard = new KEY_STATE[MAX_KEYS];
 	memset(keyboard, KEY_IDLE, sizeof(KEY_STATE) * MAX_KEYS);
 	memset(mouse_buttons, KEY_IDLE, sizeof(KEY_STATE) * MAX_MOUSE_BUTTONS);
@@ -27,6 +28,15 @@ trInput::~trInput()
 	delete[] keyboard;
 }
 
+// ---------------------------------------------
+void trInput::DeclareDependencies()
+{
+	// Resizes and dropped files
+	Writes(App->window);
+	Writes(App->render);
+	Writes(App->file_system);
+}
+
 // Called before render is available
 bool trInput::Init()
 {
@@ -98,7 +108,8 @@ bool trInput::PreUpdate(float dt)
 	SDL_Event e;
 	while (SDL_PollEvent(&e))
 	{
-		ImGui_ImplSDL2_ProcessEvent(&e);
+		if (!App->IsHeadless())
+			ImGui_ImplSDL2_ProcessEvent(&e);
 
 		switch (e.type)
 		{
@@ -24,6 +24,8 @@ public:
 	bool PreUpdate(float dt);
 	bool CleanUp();
 
+	void DeclareDependencies();
+
 	KEY_STATE GetKey(int id) const
 	{
 		return keyboard[id];
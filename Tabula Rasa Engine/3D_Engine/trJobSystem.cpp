@@ -0,0 +1,245 @@
+// ----------------------------------------------------
+// trJobSystem.cpp
+// Work-stealing job system shared by all modules
+// ----------------------------------------------------
+
+#include "trJobSystem.h"
+#include "trLog.h"
+
+// Queue owned by the calling thread. -1 for threads the job system didn't create (other than main).
+static thread_local int thread_queue_index = -1;
+
+trJobSystem::trJobSystem(uint worker_count)
+{
+	pending_jobs = 0;
+	quit = false;
+
+	queue_count = worker_count + 1u;
+	queues = new WorkQueue[queue_count];
+
+	// Created on the main thread
+	thread_queue_index = 0;
+
+	for (uint i = 1u; i < queue_count; ++i)
+		workers.push_back(std::thread(&trJobSystem::WorkerLoop, this, i));
+
+	TR_LOG("trJobSystem: %u worker threads created", worker_count);
+}
+
+trJobSystem::~trJobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex);
+		quit = true;
+	}
+	wake_up.notify_all();
+
+	for (uint i = 0u; i < workers.size(); ++i)
+		workers[i].join();
+	workers.clear();
+
+	RELEASE_ARRAY(queues);
+}
+
+// ---------------------------------------------
+void trJobSystem::Run(const JobFunction& job, JobCounter* counter, JobCounter* dependency)
+{
+	if (counter != nullptr)
+		counter->fetch_add(1);
+
+	Job new_job;
+	new_job.func = job;
+	new_job.counter = counter;
+	new_job.dependency = dependency;
+
+	// Checked under the lock ReleaseBlocked takes after the counter reaches zero, so it can't be missed
+	if (dependency != nullptr)
+	{
+		std::lock_guard<std::mutex> lock(blocked_mutex);
+		if (dependency->load() > 0) {
+			blocked.push_back(new_job);
+			return;
+		}
+	}
+
+	Push(new_job);
+}
+
+void trJobSystem::Push(const Job& new_job)
+{
+	// Counted first, so it never goes below zero when the job is taken right away
+	pending_jobs.fetch_add(1);
+
+	WorkQueue& queue = queues[thread_queue_index >= 0 ? thread_queue_index : 0];
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.jobs.push_back(new_job);
+	}
+
+	// Taking the lock avoids a worker missing the notification between its check and its wait
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex);
+	}
+	wake_up.notify_one();
+}
+
+// ---------------------------------------------
+void trJobSystem::Wait(JobCounter* counter)
+{
+	if (counter == nullptr)
+		return;
+
+	while (counter->load() > 0)
+	{
+		if (ExecuteNext())
+			continue;
+
+		// Nothing to help with: sleep until a job is queued or a counter is done
+		std::unique_lock<std::mutex> lock(sleep_mutex);
+		wake_up.wait(lock, [this, counter]() { return pending_jobs.load() > 0 || counter->load() <= 0; });
+	}
+}
+
+// ---------------------------------------------
+void trJobSystem::ParallelFor(uint begin, uint end, uint grain, const RangeFunction& func)
+{
+	if (end <= begin)
+		return;
+
+	uint count = end - begin;
+
+	if (grain == 0u)
+	{
+		grain = count / (queue_count * 4u);
+		if (grain == 0u)
+			grain = 1u;
+	}
+
+	if (count <= grain || workers.empty())
+	{
+		func(begin, end);
+		return;
+	}
+
+	JobCounter counter(0);
+
+	for (uint first = begin; first < end; first += grain)
+	{
+		uint last = MIN(first + grain, end);
+		Run([&func, first, last]() { func(first, last); }, &counter);
+	}
+
+	Wait(&counter);
+}
+
+// ---------------------------------------------
+uint trJobSystem::GetThreadCount() const
+{
+	return queue_count;
+}
+
+bool trJobSystem::IsMainThread() const
+{
+	return thread_queue_index == 0;
+}
+
+// ---------------------------------------------
+void trJobSystem::WorkerLoop(uint queue_index)
+{
+	thread_queue_index = (int)queue_index;
+
+	while (!quit)
+	{
+		if (ExecuteNext())
+			continue;
+
+		// Blocked jobs are not pending, they are queued again when their dependency is done
+		std::unique_lock<std::mutex> lock(sleep_mutex);
+		wake_up.wait(lock, [this]() { return pending_jobs.load() > 0 || quit; });
+	}
+}
+
+// ---------------------------------------------
+bool trJobSystem::ExecuteNext()
+{
+	uint own_index = thread_queue_index >= 0 ? (uint)thread_queue_index : 0u;
+
+	Job job;
+	if (!PopJob(own_index, job) && !StealJob(own_index, job))
+		return false;
+
+	job.func();
+
+	if (job.counter != nullptr && job.counter->fetch_sub(1) == 1)
+	{
+		ReleaseBlocked(job.counter);
+
+		// Wakes whoever sleeps in Wait on it
+		{
+			std::lock_guard<std::mutex> lock(sleep_mutex);
+		}
+		wake_up.notify_all();
+	}
+
+	return true;
+}
+
+// The counter just reached zero
+void trJobSystem::ReleaseBlocked(JobCounter* counter)
+{
+	std::vector<Job> ready;
+	{
+		std::lock_guard<std::mutex> lock(blocked_mutex);
+
+		// More work may have been attached to it meanwhile
+		if (blocked.empty() || counter->load() > 0)
+			return;
+
+		for (uint i = 0u; i < blocked.size();)
+		{
+			if (blocked[i].dependency == counter) {
+				ready.push_back(blocked[i]);
+				blocked[i] = blocked.back();
+				blocked.pop_back();
+			}
+			else
+				++i;
+		}
+	}
+
+	for (uint i = 0u; i < ready.size(); ++i)
+		Push(ready[i]);
+}
+
+bool trJobSystem::PopJob(uint queue_index, Job& job)
+{
+	WorkQueue& queue = queues[queue_index];
+	std::lock_guard<std::mutex> lock(queue.mutex);
+
+	if (queue.jobs.empty())
+		return false;
+
+	job = queue.jobs.back();
+	queue.jobs.pop_back();
+	pending_jobs.fetch_sub(1);
+	return true;
+}
+
+bool trJobSystem::StealJob(uint thief_index, Job& job)
+{
+	for (uint i = 1u; i < queue_count; ++i)
+	{
+		WorkQueue& queue = queues[(thief_index + i) % queue_count];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+
+		if (queue.jobs.empty())
+			continue;
+
+		job = queue.jobs.front();
+		queue.jobs.pop_front();
+		pending_jobs.fetch_sub(1);
+		return true;
+	}
+
+	return false;
+}
@@ -0,0 +1,87 @@
+#ifndef __trJOBSYSTEM_H__
+#define __trJOBSYSTEM_H__
+
+#include "trDefs.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Jobs still pending on a counter. Zero means everything attached to it is done.
+typedef std::atomic<int> JobCounter;
+
+class trJobSystem
+{
+public:
+
+	typedef std::function<void()> JobFunction;
+	typedef std::function<void(uint begin, uint end)> RangeFunction;
+
+private:
+
+	struct Job
+	{
+		JobFunction func;
+		JobCounter* counter = nullptr;
+		JobCounter* dependency = nullptr;
+	};
+
+	// One per thread. The owner pushes/pops at the back, thieves take from the front.
+	struct WorkQueue
+	{
+		std::mutex mutex;
+		std::deque<Job> jobs;
+	};
+
+public:
+
+	// worker_count threads are spawned, the main thread is an extra executor while waiting
+	trJobSystem(uint worker_count);
+	~trJobSystem();
+
+	// Queues a job. counter (optional) is increased now and decreased once the job has been executed.
+	// The job won't start while dependency (optional) is above zero: it is parked, not polled, until
+	// the last job on that counter finishes.
+	void Run(const JobFunction& job, JobCounter* counter = nullptr, JobCounter* dependency = nullptr);
+
+	// Blocks until the counter reaches zero, executing pending jobs meanwhile
+	void Wait(JobCounter* counter);
+
+	// Splits [begin, end) in chunks of grain elements and waits for all of them.
+	// grain 0 lets the job system pick a chunk size from the number of threads.
+	void ParallelFor(uint begin, uint end, uint grain, const RangeFunction& func);
+
+	// Executes one pending job if there is any. For threads waiting on something else than a counter.
+	bool ExecuteNext();
+
+	uint GetThreadCount() const;
+	bool IsMainThread() const;
+
+private:
+
+	void WorkerLoop(uint queue_index);
+	void Push(const Job& job);
+	void ReleaseBlocked(JobCounter* counter);
+	bool PopJob(uint queue_index, Job& job);
+	bool StealJob(uint thief_index, Job& job);
+
+private:
+
+	std::vector<std::thread> workers;
+	WorkQueue* queues = nullptr; // [0] belongs to the main thread
+	uint queue_count = 0u;
+
+	std::mutex blocked_mutex;
+	std::vector<Job> blocked; // waiting on their dependency, not in any queue
+
+	std::atomic<int> pending_jobs; // in the queues, ready to run
+	std::atomic<bool> quit;
+	std::mutex sleep_mutex;
+	std::condition_variable wake_up;
+};
+
+#endif // __trJOBSYSTEM_H__
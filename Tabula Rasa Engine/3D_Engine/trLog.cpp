@@ -1,8 +1,15 @@
 #include "trLog.h"
 #include "trEditor.h"
 #include "trApp.h"
+
+#include <mutex>
+
 void log(const char file[], int line, const char* format, ...)
 {
+	// Jobs may log from worker threads, the editor queues the line for the main thread
+	static std::mutex log_mutex;
+	std::lock_guard<std::mutex> lock(log_mutex);
+
 	static char tmp_string[4096];
 	static char tmp_string2[4096];
 	static va_list  ap;
@@ -13,6 +20,8 @@ void log(const char file[], int line, const char* format, ...)
 	va_end(ap);
 	sprintf_s(tmp_string2, 4096, "\n%s(%d) : %s", file, line, tmp_string);
 	OutputDebugString(tmp_string2);
+	if (App != nullptr && App->IsHeadless())
+		printf("%s", tmp_string2); // build servers read stdout
 	if(App != nullptr)
 		if(App->editor->active)
 			App->editor->Log(tmp_string);
@@ -8,7 +8,10 @@
 #include "ComponentCamera.h"
 #include "ComponentMesh.h"
 #include "ComponentBone.h"
+#include "ComponentMaterial.h"
+#include "ComponentTransform.h"
 #include "trEditor.h" //TODO: check this
+#include "trSceneSnapshot.h"
 
 #include "ResourceMesh.h"
 
@@ -16,20 +19,34 @@
 #include "DebugDraw.h"
 #include <iostream> 
 #include <stdio.h>
+#include <algorithm>
+#include <functional>
+#include <memory>
 #include "trFileSystem.h"
 #include "trInput.h"
 
 #include "trAnimation.h"
+#include "trProfiler.h"
 
 trMainScene::trMainScene() : trModule()
 {
 	name = "main_scene";
+	fixed_step = true;
+	phases = PHASE_ALL;
 }
 
 // Destructor
 trMainScene::~trMainScene()
 {}
 
+// ---------------------------------------------
+void trMainScene::DeclareDependencies()
+{
+	Reads(App->input);
+	Reads(App->camera);
+	Writes(App->animation);
+}
+
 // Called before render is available
 bool trMainScene::Awake(JSON_Object* config)
 {
@@ -50,7 +67,16 @@ bool trMainScene::Awake(JSON_Object* config)
 	rot = rot.RotateAxisAngle(float3(0.0f, 1.0f, 0.0f), math::pi);
 	main_camera->GetTransform()->Setup(float3(0.732f, 1.619f, 5.518f), float3::one, rot);
 
-	quadtree.Create(AABB(AABB(float3(-500, -100, -500), float3(500, 100, 500))));
+	world_bounds = AABB(float3(-500, -100, -500), float3(500, 100, 500));
+	quadtree.Create(world_bounds);
+
+	if (config != nullptr) {
+		use_bvh = json_object_has_value(config, "use_bvh") ? json_object_get_boolean(config, "use_bvh") != 0 : false;
+		streamer.SetLoadRadius(json_object_has_value(config, "stream_load_radius") ? json_object_get_number(config, "stream_load_radius") : STREAM_LOAD_RADIUS);
+		streamer.SetHysteresis(json_object_has_value(config, "stream_hysteresis") ? json_object_get_number(config, "stream_hysteresis") : STREAM_HYSTERESIS);
+		streamer.SetMemoryBudget(json_object_has_value(config, "stream_memory_budget_mb") ? (uint64)json_object_get_number(config, "stream_memory_budget_mb") * 1024u * 1024u : STREAM_MEMORY_BUDGET);
+		streamer.SetObjectsPerFrame(json_object_has_value(config, "stream_objects_per_frame") ? (uint)json_object_get_number(config, "stream_objects_per_frame") : STREAM_OBJECTS_PER_FRAME);
+	}
 
 	//scene_name = "TR Unnamed Scene";
 
@@ -77,7 +103,11 @@ bool trMainScene::Start()
 // Called each loop iteration
 bool trMainScene::PreUpdate(float dt)
 {
-	root->DestroyGameObjectsIfNeeded();
+	DestroyQueued();
+
+	// Cells come in and out around the game camera
+	if (streamer.IsOpen() && main_camera != nullptr && App->render->active_camera != nullptr)
+		streamer.Update(App->render->active_camera->frustum.pos);
 
 	// PreUpdate GOS with game dt if runtime
 	for (std::list<GameObject*>::iterator it = root->childs.begin(); it != root->childs.end(); it++) 
@@ -125,7 +155,7 @@ bool trMainScene::PostUpdate(float dt)
 void trMainScene::DrawDebug()
 {
 	// Draw quadtree AABBs
-	std::vector<AABB> quad_aabbs;
+	FrameVector<AABB> quad_aabbs(App->frame_allocator);
 	quadtree.FillWithAABBs(quad_aabbs);
 	for (uint i = 0; i < quad_aabbs.size(); i++)
 		DebugDraw(quad_aabbs[i], White);
@@ -167,19 +197,132 @@ void trMainScene::RecursiveDebugDrawGameObjects(GameObject * go)
 
 void trMainScene::RecursiveDeleteGos(GameObject * go, bool and_camera)
 {
-	if (and_camera) {
+	// The whole subtree goes with it
+	if (and_camera || go != main_camera) {
+		Destroy(go);
+		return;
+	}
+
+	for (std::list<GameObject*>::iterator it = go->childs.begin(); it != go->childs.end(); it++) {
+		RecursiveDeleteGos((*it), and_camera);
+	}
+}
+
+void trMainScene::Destroy(GameObject * go)
+{
+	// Already queued, itself or through a parent
+	if (go == nullptr || go == root || go->to_destroy)
+		return;
+
+	MarkToDestroy(go);
+}
+
+// Every flagged object is queued, one reparented out of a queued subtree still goes
+void trMainScene::MarkToDestroy(GameObject * go)
+{
+	if (!go->to_destroy) {
 		go->to_destroy = true;
 		go->is_active = false; // doing this, renderer will ignore it till is destroyed
+		destroy_queue.push_back(go);
 	}
-	else {
-		if (go != main_camera) {
-			go->to_destroy = true;
-			go->is_active = false; // doing this, renderer will ignore it till is destroyed
-		}
+
+	for (std::list<GameObject*>::iterator it = go->childs.begin(); it != go->childs.end(); it++)
+		MarkToDestroy((*it));
+}
+
+void trMainScene::CollectSubtree(GameObject * go, FrameVector<GameObject*>& output) const
+{
+	output.push_back(go);
+
+	for (std::list<GameObject*>::const_iterator it = go->childs.begin(); it != go->childs.end(); it++)
+		CollectSubtree((*it), output);
+}
+
+void trMainScene::DestroyQueued()
+{
+	if (destroy_queue.empty())
+		return;
+
+	TR_PROFILE_SCOPE("trMainScene::DestroyQueued");
+
+	// Objects under another queued one are released with it, the rest are unlinked from where they are now
+	FrameVector<GameObject*> tops(App->frame_allocator);
+	for (uint i = 0u; i < destroy_queue.size(); ++i)
+	{
+		bool under_queued = false;
+		for (GameObject* parent = destroy_queue[i]->GetParent(); parent != nullptr && !under_queued; parent = parent->GetParent())
+			under_queued = parent->to_destroy;
+
+		if (!under_queued)
+			tops.push_back(destroy_queue[i]);
 	}
-	for (std::list<GameObject*>::iterator it = go->childs.begin(); it != go->childs.end(); it++) {
-		RecursiveDeleteGos((*it), and_camera);
+	destroy_queue.clear();
+
+	FrameVector<GameObject*> dying(App->frame_allocator);
+	for (uint i = 0u; i < tops.size(); ++i)
+		CollectSubtree(tops[i], dying);
+	std::sort(dying.begin(), dying.end());
+
+	// Unlink everything at once
+	std::function<bool(GameObject*)> is_dying = [&dying](GameObject* go) { return std::binary_search(dying.begin(), dying.end(), go); };
+
+	if (main_camera != nullptr && is_dying(main_camera))
+		main_camera = nullptr;
+
+	// The editor drops its selection on GAMEOBJECT_DESTROYED
+	for (uint i = 0u; i < tops.size(); ++i)
+	{
+		GameObject* go = tops[i];
+		go->PublishDestroyed();
+
+		if (go->GetParent() != nullptr)
+			go->GetParent()->childs.remove(go);
+
+		RELEASE(go);
+	}
+}
+
+void trMainScene::UpdateTransforms()
+{
+	TR_PROFILE_SCOPE("trMainScene::UpdateTransforms");
+
+	App->transforms.UpdateWorldMatrices();
+}
+
+void trMainScene::UpdateBoundingBoxes()
+{
+	TR_PROFILE_SCOPE("trMainScene::UpdateBoundingBoxes");
+
+	for (uint i = 0u; i < dirty_bounds.size(); ++i)
+	{
+		// Destroyed while queued
+		GameObject* go = dirty_bounds[i];
+		if (go == nullptr)
+			continue;
+
+		go->UpdateBoundingBox();
+		go->bounds_dirty = false;
+		go->bounds_slot = BOUNDS_NO_SLOT;
 	}
+
+	dirty_bounds.clear();
+
+	// Refit with the new boxes, or build again if the tree got too loose
+	if (use_bvh)
+		bvh.Refresh();
+}
+
+void trMainScene::QueueBoundsUpdate(GameObject * go)
+{
+	go->bounds_slot = dirty_bounds.size();
+	dirty_bounds.push_back(go);
+}
+
+// O(1), the batched pass skips the hole
+void trMainScene::CancelBoundsUpdate(GameObject * go)
+{
+	dirty_bounds[go->bounds_slot] = nullptr;
+	go->bounds_slot = BOUNDS_NO_SLOT;
 }
 
 void trMainScene::RecursiveSetupGo(GameObject * go, bool only_animation)
@@ -189,13 +332,13 @@ void trMainScene::RecursiveSetupGo(GameObject * go, bool only_animation)
 	}
 
 	for (std::list<GameObject*>::iterator it = go->childs.begin(); it != go->childs.end(); it++) {
-		if ((*it)->is_static && (*it)->to_destroy == false && !(*it)->FindComponentByType(ComponentMesh::COMPONENT_BONE)){
+		if ((*it)->is_static && (*it)->to_destroy == false){
 			App->main_scene->InsertGoInQuadtree((*it));
 		}
 	}
 
 	for (std::list<GameObject*>::iterator it = go->childs.begin(); it != go->childs.end(); it++) {
-		if ((*it)->to_destroy == false && (*it)->FindComponentByType(ComponentMesh::COMPONENT_MESH)) {
+		if ((*it)->to_destroy == false && (*it)->HasComponent(ComponentMesh::COMPONENT_MESH)) {
 			(*it)->FindComponentByType(ComponentMesh::COMPONENT_MESH)->Start();
 		}
 	}
@@ -212,7 +355,9 @@ void trMainScene::RecursiveSetupGo(GameObject * go, bool only_animation)
 bool trMainScene::CleanUp()
 {
 	RELEASE(grid);
+	streamer.Close();
 	RELEASE(root);
+	dirty_bounds.clear();
 	return true;
 }
 
@@ -220,17 +365,14 @@ void trMainScene::ClearScene(bool delete_camera)
 {
 	//todo rec
 
+	streamer.Close();
+
 	for (std::list<GameObject*>::iterator it = root->childs.begin(); it != root->childs.end(); it++) {
 		RecursiveDeleteGos((*it), delete_camera);
 	}
 
 	if(delete_camera)
 		this->main_camera = nullptr;
-
-	static_go.clear();
-	dinamic_go.clear();
-
-	ReDoQuadtree();
 }
 
 void trMainScene::Draw()
@@ -258,40 +400,35 @@ bool trMainScene::SerializeScene(std::string& output_file, const char* force_nam
 	App->file_system->GetFileFileNameFromPath(force_name, file_name);
 	this->scene_name = file_name;
 
-	JSON_Value* root_value = nullptr;
-	JSON_Object* root_obj = nullptr;
-	JSON_Array* array = nullptr;
-
-	root_value = json_value_init_object();
-
-	// Scene stuff
-	root_obj = json_value_get_object(root_value);
-	json_object_set_string(root_obj, "Name", scene_name.c_str());
-
-	// Go's stuff
-	JSON_Value* go_value = json_value_init_array();
-	array = json_value_get_array(go_value);
-	json_object_set_value(root_obj, "GameObjects", go_value);
+	// Only plain data is copied here, the DOM is built and written on the io thread
+	std::shared_ptr<trSceneSnapshot> snapshot = std::make_shared<trSceneSnapshot>();
 
 	/// Iterating between all gos
 	for (std::list<GameObject*>::const_iterator it = root->childs.begin(); it != root->childs.end(); it++) {
 		if(!(*it)->to_destroy)
-			(*it)->Save(array);
+			snapshot->Capture(*it);
 	}
 
-	char *serialized_string = NULL;
-
-	serialized_string = json_serialize_to_string_pretty(root_value);
-	puts(serialized_string);
-
 	std::string final_path = A_SCENES_DIR;
 	final_path.append("/");
 	final_path.append(scene_name.c_str());
 	final_path.append(".trScene");
-	json_serialize_to_file(root_value, final_path.c_str());
 	output_file = final_path;
-	json_free_serialized_string(serialized_string);
-	json_value_free(root_value);
+
+	// Loads read on the io thread too, so they always come after this write
+	std::string name(scene_name);
+	App->async_io.Submit([snapshot, name, final_path]()
+	{
+		JSON_Value* root_value = snapshot->ToJson(name.c_str());
+		bool ret = json_serialize_to_file(root_value, final_path.c_str()) == JSONSuccess;
+		json_value_free(root_value);
+		return ret;
+	},
+	[final_path](bool success)
+	{
+		if (!success)
+			TR_LOG("trMainScene: Error writing %s", final_path.c_str());
+	});
 
 	return true;
 }
@@ -299,6 +436,18 @@ bool trMainScene::SerializeScene(std::string& output_file, const char* force_nam
 bool trMainScene::DeSerializeScene(const char * string, bool only_animation)
 {
 	JSON_Value* root_value = json_parse_string(string);
+	if (root_value == nullptr)
+		return false;
+
+	bool ret = DeSerializeScene(root_value, only_animation);
+	json_value_free(root_value);
+
+	return ret;
+}
+
+// Main thread, the value can be parsed anywhere
+bool trMainScene::DeSerializeScene(const JSON_Value* root_value, bool only_animation)
+{
 	JSON_Object* root_obj = json_value_get_object(root_value); 
 	
 	//JSON_Object* description = json_object_get_object(root, "");
@@ -314,7 +463,9 @@ bool trMainScene::DeSerializeScene(const char * string, bool only_animation)
 	if (array != nullptr) {
 		uint go_size = json_array_get_count(array);
 
-		
+		// Every object and its transform come from the same slabs
+		ReserveGameObjects(go_size);
+
 		for (uint i = 0u; i < go_size; ++i)
 		{
 			GameObject* go = this->CreateGameObject("unnamed for now");
@@ -322,8 +473,8 @@ bool trMainScene::DeSerializeScene(const char * string, bool only_animation)
 			JSON_Object* go_obj = json_array_get_object(array, i);
 
 			go->Load(go_obj, uuid_relations);
-			if (only_animation && go->FindComponentByType(Component::component_type::COMPONENT_CAMERA) == nullptr)
-				go->to_destroy = true;
+			if (only_animation && !go->HasComponent(Component::component_type::COMPONENT_CAMERA))
+				Destroy(go);
 		}
 	}
 
@@ -334,7 +485,7 @@ bool trMainScene::DeSerializeScene(const char * string, bool only_animation)
 
 		if (parent_id > 0)
 		{
-			GameObject* parent_go = FindGoByUUID(parent_id, this->GetRoot());
+			GameObject* parent_go = FindGoByUUID(parent_id);
 			if (parent_go != nullptr)
 				go->SetParent(parent_go);
 		}
@@ -346,7 +497,7 @@ bool trMainScene::DeSerializeScene(const char * string, bool only_animation)
 
 	for (std::list<GameObject*>::iterator it = App->main_scene->GetRoot()->childs.begin(); it != App->main_scene->GetRoot()->childs.end(); it++)
 	{
-		if (!(*it)->to_destroy && (*it)->FindComponentByType(ComponentMesh::COMPONENT_MESH) != nullptr)
+		if (!(*it)->to_destroy && (*it)->HasComponent(ComponentMesh::COMPONENT_MESH))
 		{
 			AABB current_bb = (*it)->bounding_box;
 			scene_bb.Enclose(current_bb);
@@ -366,170 +517,210 @@ bool trMainScene::DeSerializeScene(const char * string, bool only_animation)
 	return true;
 }
 
-GameObject * trMainScene::FindGoByUUID(UID uid, GameObject* go)
+GameObject * trMainScene::FindGoByUUID(UID uid) const
 {
-	if (uid == go->GetUUID() && go->to_destroy == false)
-		return go;
+	std::pair<std::unordered_multimap<UID, GameObject*>::const_iterator, std::unordered_multimap<UID, GameObject*>::const_iterator> range = go_index.equal_range(uid);
 
-	GameObject* ret = nullptr;
+	for (std::unordered_multimap<UID, GameObject*>::const_iterator it = range.first; it != range.second; ++it)
+	{
+		if (it->second->to_destroy == false)
+			return it->second;
+	}
 
-	for (std::list<GameObject*>::const_iterator it = go->childs.begin(); it != go->childs.end() && ret == nullptr; ++it)
-		ret = FindGoByUUID(uid, *it);
+	return nullptr;
+}
 
-	return ret;
+void trMainScene::IndexGo(GameObject * go)
+{
+	go_index.insert(std::pair<UID, GameObject*>(go->GetUUID(), go));
 }
 
-GameObject * trMainScene::GetRoot() const
+GameObject * trMainScene::GetGameObject(GameObjectHandle handle) const
 {
-	return root;
+	if (handle.index >= go_slots.size() || go_slots[handle.index].generation != handle.generation)
+		return nullptr;
+
+	return go_slots[handle.index].go;
 }
 
-void trMainScene::InsertGoInQuadtree(GameObject * go) // This GO is now static
+GameObjectHandle trMainScene::CreateHandle(GameObject * go)
 {
-	if (go->FindComponentByType(ComponentMesh::COMPONENT_BONE))
-		return;
+	GameObjectHandle handle;
 
-	if (go != main_camera) {
-		if (!go->to_destroy) {
-			static_go.push_back(go);
-			quadtree.Insert(go);
-		}
-		for (std::list<GameObject*>::iterator it = dinamic_go.begin(); it != dinamic_go.end(); it++) {
-			if ((*it) == go) {
-				dinamic_go.erase(it);
-				break;
-			}
-		}
-			
+	if (!free_go_slots.empty()) {
+		handle.index = free_go_slots.back();
+		free_go_slots.pop_back();
+	}
+	else {
+		handle.index = go_slots.size();
+		go_slots.push_back(GoSlot());
 	}
+
+	go_slots[handle.index].go = go;
+	handle.generation = go_slots[handle.index].generation;
+
+	return handle;
 }
 
-void trMainScene::EraseGoInQuadtree(GameObject * go) // This go is now dinamic
+void trMainScene::DestroyHandle(GameObjectHandle handle)
 {
-	if (go->FindComponentByType(ComponentMesh::COMPONENT_BONE))
+	if (GetGameObject(handle) == nullptr)
 		return;
 
-	if (go != main_camera) {
-		if(!go->to_destroy)
-			dinamic_go.push_back(go);
-		for (std::list<GameObject*>::iterator it = static_go.begin(); it != static_go.end(); it++) {
-			if (go == (*it)) {
-				static_go.erase(it);
-				ReDoQuadtree();
-				break;
-			}
+	// Every handle taken so far becomes stale
+	go_slots[handle.index].go = nullptr;
+	go_slots[handle.index].generation++;
+	free_go_slots.push_back(handle.index);
+}
+
+void trMainScene::UnindexGo(GameObject * go)
+{
+	std::pair<std::unordered_multimap<UID, GameObject*>::iterator, std::unordered_multimap<UID, GameObject*>::iterator> range = go_index.equal_range(go->GetUUID());
+
+	for (std::unordered_multimap<UID, GameObject*>::iterator it = range.first; it != range.second; ++it)
+	{
+		if (it->second == go)
+		{
+			go_index.erase(it);
+			return;
 		}
 	}
 }
 
-void trMainScene::CollectDinamicGOs(std::vector<GameObject*>& dinamic_vector)
+GameObject * trMainScene::GetRoot() const
 {
-	for (std::list<GameObject*>::iterator it = dinamic_go.begin(); it != dinamic_go.end(); it++) {
-		if (!(*it)->to_destroy)
-			dinamic_vector.push_back((*it));
+	return root;
+}
+
+void trMainScene::InsertGoInQuadtree(GameObject * go)
+{
+	// Bones are skipped by the quadtree itself
+	if (go != main_camera && !go->to_destroy) {
+		quadtree.Insert(go);
+		if (use_bvh)
+			bvh.Insert(go);
 	}
-		
 }
 
-void trMainScene::ReDoQuadtree()
+void trMainScene::CollectInFrustum(const Frustum & frustum, FrameVector<GameObject*>& output, FrameVector<GameObject*>* candidates) const
 {
-	quadtree.Clear();
-	quadtree.Create(AABB(AABB(float3(-500, -100, -500), float3(500, 100, 500))));
+	if (use_bvh)
+		bvh.CollectsGOs(frustum, output, candidates);
+	else
+		quadtree.CollectsGOs(frustum, output, candidates);
+}
 
-	for (std::list<GameObject*>::iterator it = static_go.begin(); it != static_go.end(); it++) {
-		if(!(*it)->to_destroy)
-			quadtree.Insert((*it));
-	}
-			
+void trMainScene::CollectAll(FrameVector<GameObject*>& output) const
+{
+	if (use_bvh)
+		bvh.CollectAllGOs(output);
+	else
+		quadtree.CollectAllGOs(output);
 }
 
-void trMainScene::TestAgainstRay(LineSegment line_segment) 
+void trMainScene::CollectIntersectingGOs(const LineSegment & line_segment, FrameVector<std::pair<float, GameObject*>>& intersections) const
 {
-	std::map<float, GameObject*> intersect_map;
-	GameObject* selected_go = nullptr;
-	float min_distance = App->camera->dummy_camera->frustum.farPlaneDistance;
+	if (use_bvh)
+		bvh.CollectIntersectingGOs(line_segment, intersections);
+	else
+		quadtree.CollectIntersectingGOs(line_segment, intersections);
 
-	// Collecting all STATIC gameobjects whose AABBs have intersected with the line segment
-	quadtree.CollectIntersectingGOs(line_segment, intersect_map);
+	// Nearest box first. Equal distances are all kept, a map by distance would drop them.
+	std::sort(intersections.begin(), intersections.end(), [](const std::pair<float, GameObject*>& a, const std::pair<float, GameObject*>& b) { return a.first < b.first; });
+}
 
-	// Collecting all DYNAMIC gameobjects (as they are not in the quadtree, it only accepts STATIC objects inside)
-	std::vector<GameObject*> intersect_dynamic_vec;
-	CollectDinamicGOs(intersect_dynamic_vec);
+void trMainScene::SetWorldBounds(const AABB & bounds)
+{
+	world_bounds = bounds;
+	quadtree.Create(world_bounds);
+}
 
-	/* Checking if these dynamic gameobjects are inside the fustrum. If so, checking if they intersect with the line
-	   segment; in that case, we put them in our map along with their hit distance. As we use a map (with hit distance 
-	   value as key) it is already ordered in ascending order by default. This means the gameobjects are already sorted 
-	   by their AABBs distance to the camera, so we will check first the closer gameobjects to speed up the process. */
-	for (uint i = 0; i < intersect_dynamic_vec.size(); i++)
+bool trMainScene::RayCast(const LineSegment & line_segment, RayHit & hit) const
+{
+	FrameVector<std::pair<float, GameObject*>> intersections(App->frame_allocator);
+	bool found = false;
+
+	// Collecting all gameobjects whose AABBs have intersected with the line segment, static and dynamic ones.
+	// They come sorted by their AABBs distance to the camera, so we will check first the closer gameobjects
+	// to speed up the process.
+	CollectIntersectingGOs(line_segment, intersections);
+
+	for (FrameVector<std::pair<float, GameObject*>>::iterator it = intersections.begin(); it != intersections.end(); it++)
 	{
-		AABB current_bounding_box = intersect_dynamic_vec[i]->bounding_box;
-		if (App->camera->dummy_camera->FrustumContainsAaBox(current_bounding_box))
+		// The box is already further away than the closest triangle, so are the rest of them
+		if (found && it->first >= hit.distance)
+			break;
+
+		const ComponentMesh* mesh_comp = (ComponentMesh*)it->second->FindComponentByType(Component::COMPONENT_MESH);
+		if (mesh_comp == nullptr || mesh_comp->GetResource() == nullptr)
+			continue;
+
+		ResourceMesh* mesh = (ResourceMesh*)mesh_comp->GetResource();
+
+		// Transforming line segment into intersecting gameobject's local space, distances along it don't change
+		float4x4 transform = it->second->GetTransform()->GetMatrix();
+		LineSegment segment_local_space(line_segment);
+		segment_local_space.Transform(transform.Inverted());
+
+		MeshHit mesh_hit;
+		if (mesh->RayCast(segment_local_space, mesh_hit) && (!found || mesh_hit.distance < hit.distance))
 		{
-			float hit_distance;
-			float out_distance;
-			if (line_segment.Intersects(current_bounding_box, hit_distance, out_distance))
-				intersect_map.insert(std::pair<float, GameObject*>(hit_distance, intersect_dynamic_vec[i]));
+			hit.go = it->second;
+			hit.distance = mesh_hit.distance;
+			hit.point = transform.TransformPos(mesh_hit.point);
+			hit.triangle = mesh_hit.triangle;
+			found = true;
 		}
 	}
-	
-	// Now we can go through the map checking each gameobject's triangle against the line segment
-	for (std::map<float, GameObject*>::iterator it_map = intersect_map.begin(); it_map != intersect_map.end(); it_map++)
+
+	return found;
+}
+
+uint trMainScene::RayCastAll(const LineSegment & line_segment, std::vector<RayHit>& hits) const
+{
+	hits.clear();
+
+	FrameVector<std::pair<float, GameObject*>> intersections(App->frame_allocator);
+	CollectIntersectingGOs(line_segment, intersections);
+
+	std::vector<MeshHit> mesh_hits;
+
+	for (FrameVector<std::pair<float, GameObject*>>::iterator it = intersections.begin(); it != intersections.end(); it++)
 	{
-		const ComponentMesh* mesh_comp = (ComponentMesh*)it_map->second->FindComponentByType(Component::COMPONENT_MESH);
-		
-		// Making sure the intersecting gameobject has a mesh component
-		if (mesh_comp != nullptr && mesh_comp->GetResource() != nullptr)
+		const ComponentMesh* mesh_comp = (ComponentMesh*)it->second->FindComponentByType(Component::COMPONENT_MESH);
+		if (mesh_comp == nullptr || mesh_comp->GetResource() == nullptr)
+			continue;
+
+		ResourceMesh* mesh = (ResourceMesh*)mesh_comp->GetResource();
+
+		float4x4 transform = it->second->GetTransform()->GetMatrix();
+		LineSegment segment_local_space(line_segment);
+		segment_local_space.Transform(transform.Inverted());
+
+		mesh->RayCastAll(segment_local_space, mesh_hits);
+
+		for (uint i = 0u; i < mesh_hits.size(); ++i)
 		{
-			ResourceMesh* mesh = (ResourceMesh*)mesh_comp->GetResource();
-			/* Checking if the current minimum distance to the camera is greater than the AABB's hit distance of 
-			   the current intersecting gameobject in the loop. If it's not, we can safely discard this gameobject 
-			   as it's further away from the previous one. This way, we prevent the program from calculating all 
-			   the mesh triangles so the mouse picking process will be faster. */
-			if (min_distance >= (*it_map).first)
-			{
-				// Transforming line segment into intersecting gameobject's local space
-				LineSegment segment_local_space(line_segment);
-				segment_local_space.Transform(it_map->second->GetTransform()->GetMatrix().Inverted());
-
-				Triangle tri;
-				uint index_counter = 0;
-
-				while (index_counter < mesh->index_size)
-				{
-					// Creating gameobject's mesh triangles
-					tri.a.x = mesh->vertices[mesh->indices[index_counter] * 3];
-					tri.a.y = mesh->vertices[mesh->indices[index_counter] * 3 + 1];
-					tri.a.z = mesh->vertices[mesh->indices[index_counter++] * 3 + 2];
-
-					tri.b.x = mesh->vertices[mesh->indices[index_counter] * 3];
-					tri.b.y = mesh->vertices[mesh->indices[index_counter] * 3 + 1];
-					tri.b.z = mesh->vertices[mesh->indices[index_counter++] * 3 + 2];
-
-					tri.c.x = mesh->vertices[mesh->indices[index_counter] * 3];
-					tri.c.y = mesh->vertices[mesh->indices[index_counter] * 3 + 1];
-					tri.c.z = mesh->vertices[mesh->indices[index_counter++] * 3 + 2];
-
-					// Checking if line has interseted with each triangle
-					float hit_distance = 0.0f;
-					float3 hit_point = float3::zero;
-
-					if (segment_local_space.Intersects(tri, &hit_distance, &hit_point))
-					{
-						// If triangle intersects we neeed to check if it's the closest one of all of them
-						if (hit_distance < min_distance)
-						{
-							// If it is we save its hit distance (unless another triangle is closer in next lap)
-							min_distance = hit_distance;
-							selected_go = it_map->second;
-						}
-					}
-				}
-			}
+			RayHit hit;
+			hit.go = it->second;
+			hit.distance = mesh_hits[i].distance;
+			hit.point = transform.TransformPos(mesh_hits[i].point);
+			hit.triangle = mesh_hits[i].triangle;
+			hits.push_back(hit);
 		}
 	}
 
+	std::sort(hits.begin(), hits.end(), [](const RayHit& a, const RayHit& b) { return a.distance < b.distance; });
+
+	return hits.size();
+}
+
+void trMainScene::TestAgainstRay(LineSegment line_segment) 
+{
+	RayHit hit;
+
 	// Finally, we set the resulting selected gameobject
-	App->editor->SetSelected(selected_go);
+	App->editor->SetSelected(RayCast(line_segment, hit) ? hit.go : nullptr);
 }											   
 											   
 
@@ -547,4 +738,121 @@ GameObject * trMainScene::CreateGameObject(const char* name, GameObject* parent)
 		parent = root;
 
 	return new GameObject(name, parent);
+}
+
+void trMainScene::CreateGameObjects(uint count, const char* name, GameObject* parent, std::vector<GameObject*>& output)
+{
+	if (parent == nullptr)
+		parent = root;
+
+	ReserveGameObjects(count);
+	output.reserve(output.size() + count);
+
+	for (uint i = 0u; i < count; ++i)
+	{
+		GameObject* go = new GameObject(name, parent);
+		go->CreateComponent(Component::component_type::COMPONENT_TRANSFORM);
+		output.push_back(go);
+	}
+}
+
+void trMainScene::ReserveGameObjects(uint count)
+{
+	GameObject::GetPool().Reserve(count);
+	ComponentTransform::GetPool().Reserve(count);
+}
+
+void trMainScene::Instantiate(GameObject * prototype, const float4x4 & where, uint count, std::vector<GameObject*>* output)
+{
+	if (prototype == nullptr || prototype == root || count == 0u)
+		return;
+
+	TR_PROFILE_SCOPE("trMainScene::Instantiate");
+
+	// Every copy comes from pool memory reserved up front
+	FrameVector<GameObject*> prototype_gos(App->frame_allocator);
+	CollectSubtree(prototype, prototype_gos);
+
+	uint meshes = 0u, materials = 0u;
+	for (uint i = 0u; i < prototype_gos.size(); ++i)
+	{
+		if (prototype_gos[i]->HasComponent(Component::component_type::COMPONENT_MESH))
+			meshes++;
+		if (prototype_gos[i]->HasComponent(Component::component_type::COMPONENT_MATERIAL))
+			materials++;
+	}
+
+	ReserveGameObjects(prototype_gos.size() * count);
+	ComponentMesh::GetPool().Reserve(meshes * count);
+	ComponentMaterial::GetPool().Reserve(materials * count);
+
+	float3 position, scale;
+	Quat rotation;
+	where.Decompose(position, rotation, scale);
+
+	FrameVector<GameObject*> created(App->frame_allocator);
+	created.reserve(prototype_gos.size() * count);
+	if (output != nullptr)
+		output->reserve(output->size() + count);
+
+	for (uint i = 0u; i < count; ++i)
+	{
+		GameObject* copy = CloneRecursive(prototype, root, created);
+		copy->GetTransform()->Setup(position, scale, rotation, true);
+
+		if (output != nullptr)
+			output->push_back(copy);
+	}
+
+	// World matrices and boxes once for every copy, then the spatial structure in bulk
+	App->transforms.UpdateWorldMatrices();
+
+	for (uint i = 0u; i < created.size(); ++i)
+	{
+		// Up to date here, the next bounds pass has nothing left to do for them
+		created[i]->UpdateBoundingBox();
+		created[i]->bounds_dirty = false;
+		if (created[i]->bounds_slot != BOUNDS_NO_SLOT)
+			CancelBoundsUpdate(created[i]);
+
+		quadtree.Insert(created[i]);
+		if (use_bvh)
+			bvh.Insert(created[i]);
+	}
+}
+
+GameObject * trMainScene::CloneRecursive(const GameObject * source, GameObject * parent, FrameVector<GameObject*>& created)
+{
+	GameObject* copy = new GameObject(source->GetName(), parent);
+
+	for (std::list<Component*>::const_iterator it = source->components.begin(); it != source->components.end(); ++it)
+	{
+		const Component* component = (*it);
+
+		switch (component->GetType())
+		{
+		case Component::component_type::COMPONENT_TRANSFORM: {
+			const ComponentTransform* transform = (const ComponentTransform*)component;
+			copy->CreateComponent(Component::component_type::COMPONENT_TRANSFORM);
+			copy->GetTransform()->Setup(transform->GetTranslation(), transform->GetScale(), transform->GetRotation(), true);
+			break;
+		}
+		case Component::component_type::COMPONENT_CAMERA:
+			break; // a single camera per scene
+		default: {
+			// Same resource, one more reference
+			Component* component_copy = copy->CreateComponent(component->GetType());
+			if (component_copy != nullptr && component->GetResourceUID() != 0u)
+				component_copy->SetResource(component->GetResourceUID());
+			break;
+		}
+		}
+	}
+
+	created.push_back(copy);
+
+	for (std::list<GameObject*>::const_iterator it = source->childs.begin(); it != source->childs.end(); ++it)
+		CloneRecursive((*it), copy, created);
+
+	return copy;
 }
\ No newline at end of file
@@ -3,11 +3,24 @@
 
 #include "trModule.h"
 #include "Quadtree.h"
+#include "SceneBVH.h"
+#include "GameObjectHandle.h"
+#include "trSceneStreamer.h"
 #include <string>
+#include <vector>
+#include <unordered_map>
 
 class GameObject;
 class PGrid;
 
+struct RayHit
+{
+	GameObject* go = nullptr;
+	float distance = 0.f;			// normalized along the segment, 0 at a and 1 at b
+	float3 point = float3::zero;	// world space
+	uint triangle = 0u;				// in the mesh of go
+};
+
 class trMainScene : public trModule
 {
 public:
@@ -32,11 +45,24 @@ public:
 	void RecursiveDebugDrawGameObjects(GameObject* go);
 	void RecursiveDeleteGos(GameObject* go, bool and_camera);
 
+	// Queues the object and its childs, they are destroyed at the start of the next frame
+	void Destroy(GameObject* go);
+
 	void RecursiveSetupGo(GameObject* go, bool only_animation = false);
 
+	// Top-down pass recalculating the dirty world matrices
+	void UpdateTransforms();
+
+	// Recalculates the queued world bounding boxes, after UpdateTransforms
+	void UpdateBoundingBoxes();
+	void QueueBoundsUpdate(GameObject* go);
+	void CancelBoundsUpdate(GameObject* go);
+
 	// Called before quitting
 	bool CleanUp();
 
+	void DeclareDependencies();
+
 	void ClearScene(bool delete_camera = false);
 
 	void Draw();
@@ -47,34 +73,95 @@ public:
 
 	bool SerializeScene(std::string& output_file, const char* force_name = nullptr);
 	bool DeSerializeScene(const char * string, bool only_animation = false);
+	bool DeSerializeScene(const JSON_Value* root_value, bool only_animation = false);
+
+	// O(1), skips objects waiting to be destroyed
+	GameObject* FindGoByUUID(UID uid) const;
+
+	// Kept up to date by GameObject on construction, destruction and load
+	void IndexGo(GameObject* go);
+	void UnindexGo(GameObject* go);
 
-	GameObject* FindGoByUUID(UID uid, GameObject* go);
+	// nullptr once the object is destroyed, O(1)
+	GameObject* GetGameObject(GameObjectHandle handle) const;
+	GameObjectHandle CreateHandle(GameObject* go);
+	void DestroyHandle(GameObjectHandle handle);
 
 	GameObject* GetRoot()const;
 
+	// Indexed until destroyed in the quadtree (bones excepted) and the BVH, static or not: a moved object follows its box
 	void InsertGoInQuadtree(GameObject* go);
-	void EraseGoInQuadtree(GameObject* go);
 
-	void CollectDinamicGOs(std::vector<GameObject*>& dinamic_vector);
+	// From the BVH if use_bvh, animated objects included, otherwise from the quadtree
+	// With candidates, the ones that still need a test of their own go there (see trFrustumCuller)
+	void CollectInFrustum(const Frustum& frustum, FrameVector<GameObject*>& output, FrameVector<GameObject*>* candidates = nullptr) const;
+	// Every indexed object, for the cameras that don't cull
+	void CollectAll(FrameVector<GameObject*>& output) const;
+	// Box hit distance and object, nearest first
+	void CollectIntersectingGOs(const LineSegment& line_segment, FrameVector<std::pair<float, GameObject*>>& intersections) const;
 
-	void ReDoQuadtree();
+	// Area covered by the quadtree, the indexed objects are placed again
+	void SetWorldBounds(const AABB& bounds);
 
+	// Against the triangles of the meshes whose box is crossed, through their triangle BVH
+	bool RayCast(const LineSegment& line_segment, RayHit& hit) const;
+	// Every hit, nearest first
+	uint RayCastAll(const LineSegment& line_segment, std::vector<RayHit>& hits) const;
+
+	// Selects the closest object under the segment
 	void TestAgainstRay(LineSegment line_segment);
 
 	GameObject* CreateGameObject(GameObject* parent);
 	GameObject* CreateGameObject(const char* name, GameObject* parent = nullptr);
 
+	// Spawns count childs of parent (root if null) with their transforms, from contiguous pool memory
+	void CreateGameObjects(uint count, const char* name, GameObject* parent, std::vector<GameObject*>& output);
+
+	// Makes room in the GameObject and transform pools for count more objects
+	void ReserveGameObjects(uint count);
+
+	// count deep copies of the prototype hierarchy as childs of the root, placed at where.
+	// Resources are shared (refcounted), copies are indexed in one go.
+	void Instantiate(GameObject* prototype, const float4x4& where, uint count, std::vector<GameObject*>* output = nullptr);
+
 private:
 
 	PGrid* grid = nullptr;
 
 	GameObject* root = nullptr;
-	
-	std::list<GameObject*> static_go;
-	std::list<GameObject*> dinamic_go;
+
+	AABB world_bounds;
+
+
+	// A reload can keep two objects with the same UUID until the old one is destroyed
+	std::unordered_multimap<UID, GameObject*> go_index;
+
+	// Slot table behind GameObjectHandle
+	struct GoSlot
+	{
+		GameObject* go = nullptr;
+		uint generation = 1u;
+	};
+	std::vector<GoSlot> go_slots;
+	std::vector<uint> free_go_slots;
+
+	std::vector<GameObject*> dirty_bounds;
+
+	std::vector<GameObject*> destroy_queue;	// every flagged object, not only the ones passed to Destroy
+
+private:
+
+	// Unlinks and releases every queued object in one pass, nothing to do if the queue is empty
+	void DestroyQueued();
+	void MarkToDestroy(GameObject* go);
+	void CollectSubtree(GameObject* go, FrameVector<GameObject*>& output) const;
+	GameObject* CloneRecursive(const GameObject* source, GameObject* parent, FrameVector<GameObject*>& created);
 	
 public:
 	Quadtree quadtree;
+	SceneBVH bvh;			// only kept when use_bvh, read once from the config
+	bool use_bvh = false;
+	trSceneStreamer streamer;
 	GameObject* main_camera = nullptr;
 	AABB scene_bb;
 	std::string scene_name;
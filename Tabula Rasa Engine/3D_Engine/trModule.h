@@ -7,14 +7,27 @@
 #define __trMODULE_H__
 
 #include <string>
+#include <vector>
 #include "ParsonJson/parson.h"
-#include "Event.h"
+#include "trDefs.h"
 
 class trApp;
 
 class trModule
 {
 
+public:
+
+	// Update phases a module implements, used by trApp to schedule it
+	enum update_phase
+	{
+		PHASE_NONE = 0,
+		PHASE_PRE_UPDATE = 1 << 0,
+		PHASE_UPDATE = 1 << 1,
+		PHASE_POST_UPDATE = 1 << 2,
+		PHASE_ALL = PHASE_PRE_UPDATE | PHASE_UPDATE | PHASE_POST_UPDATE
+	};
+
 public:
 
 	trModule() : active(false)
@@ -82,13 +95,33 @@ public:
 		active = !active;
 	}
 
-	virtual void OnEventReceived(const Event& event) {}
+	// Called once after Start. Declare here the modules whose data is touched during
+	// PreUpdate / Update / PostUpdate (the module itself is always written).
+	virtual void DeclareDependencies() {}
+
+	void Reads(const trModule* module)
+	{
+		reads.push_back(module);
+	}
+
+	void Writes(const trModule* module)
+	{
+		writes.push_back(module);
+	}
 
 public:
 
 	std::string		name;
 	bool		active = false;
 
+	// Scheduling
+	uint		phases = PHASE_ALL;
+	bool		main_thread_only = true; // SDL, GL and ImGui calls must stay on the main thread
+	bool		fixed_step = false; // simulation, ticked at the fixed rate when the app runs with a fixed timestep
+	bool		concurrent_awake = false; // Awake doesn't need SDL video, GL nor other modules, it runs on a worker
+	std::vector<const trModule*> reads;
+	std::vector<const trModule*> writes;
+
 };
 
 #endif // __trMODULE_H__
\ No newline at end of file
@@ -0,0 +1,209 @@
+// ----------------------------------------------------
+// trModuleScheduler.cpp
+// Runs one update phase of the modules as a DAG
+// ----------------------------------------------------
+
+#include "trModuleScheduler.h"
+#include "trApp.h"
+#include "trJobSystem.h"
+#include "trLog.h"
+
+#include <algorithm>
+
+trModuleScheduler::trModuleScheduler()
+{
+	phase_ret = true;
+	nodes_left = 0;
+}
+
+trModuleScheduler::~trModuleScheduler()
+{
+	Clear();
+}
+
+// ---------------------------------------------
+void trModuleScheduler::Build(const std::list<trModule*>& modules, trModule::update_phase phase, const trModule* final_stage)
+{
+	Clear();
+
+	for (std::list<trModule*>::const_iterator it = modules.begin(); it != modules.end(); ++it)
+	{
+		// Inactive modules are kept, they can be turned on at runtime
+		if (((*it)->phases & phase) == 0)
+			continue;
+
+		Node node;
+		node.module = (*it);
+		nodes.push_back(node);
+	}
+
+	// Edges always go from an earlier module to a later one, so list order is a topological order
+	for (uint i = 0u; i < nodes.size(); ++i)
+	{
+		for (uint j = i + 1u; j < nodes.size(); ++j)
+		{
+			const trModule* first = nodes[i].module;
+			const trModule* second = nodes[j].module;
+
+			// Sharing the main thread is no dependency, they are serialized there anyway
+			bool depends = second == final_stage || Conflicts(first, second);
+
+			if (depends)
+			{
+				nodes[i].successors.push_back(j);
+				nodes[j].predecessor_count++;
+			}
+		}
+	}
+
+	if (!nodes.empty())
+		pending = new std::atomic<int>[nodes.size()];
+}
+
+void trModuleScheduler::Clear()
+{
+	nodes.clear();
+	RELEASE_ARRAY(pending);
+}
+
+// ---------------------------------------------
+bool trModuleScheduler::Execute(const PhaseCall& call)
+{
+	if (nodes.empty())
+		return true;
+
+	current_call = &call;
+	phase_ret = true;
+	nodes_left = (int)nodes.size();
+	main_ready.clear();
+
+	for (uint i = 0u; i < nodes.size(); ++i)
+		pending[i] = (int)nodes[i].predecessor_count;
+
+	for (uint i = 0u; i < nodes.size(); ++i)
+	{
+		if (nodes[i].predecessor_count == 0u)
+			Launch(i);
+	}
+
+	// Main thread only modules are executed here, the rest of the time we help the workers.
+	// With no job to take we sleep until a main thread module is ready or the phase is done.
+	while (nodes_left > 0)
+	{
+		int main_node = -1;
+		{
+			std::lock_guard<std::mutex> lock(main_mutex);
+			if (!main_ready.empty())
+			{
+				// List order among the ready ones
+				std::vector<uint>::iterator first = std::min_element(main_ready.begin(), main_ready.end());
+				main_node = (int)(*first);
+				main_ready.erase(first);
+			}
+		}
+
+		if (main_node >= 0)
+			RunNode((uint)main_node);
+		else if (!App->job_system->ExecuteNext())
+		{
+			std::unique_lock<std::mutex> lock(main_mutex);
+			main_wake.wait(lock, [this]() { return !main_ready.empty() || nodes_left <= 0; });
+		}
+	}
+
+	current_call = nullptr;
+
+	return phase_ret;
+}
+
+// ---------------------------------------------
+uint trModuleScheduler::GetModuleCount() const
+{
+	return nodes.size();
+}
+
+uint trModuleScheduler::GetCriticalPathLength() const
+{
+	// Longest chain of modules, nodes are already topologically sorted
+	std::vector<uint> length(nodes.size(), 1u);
+	uint longest = 0u;
+
+	for (uint i = 0u; i < nodes.size(); ++i)
+	{
+		for (uint s = 0u; s < nodes[i].successors.size(); ++s)
+		{
+			uint successor = nodes[i].successors[s];
+			length[successor] = MAX(length[successor], length[i] + 1u);
+		}
+		longest = MAX(longest, length[i]);
+	}
+
+	return longest;
+}
+
+// ---------------------------------------------
+bool trModuleScheduler::Conflicts(const trModule* first, const trModule* second)
+{
+	// Write/write or read/write on the same module data
+	if (Touches(first, second->reads) || Touches(first, second->writes))
+		return true;
+
+	if (Touches(second, first->reads))
+		return true;
+
+	return false;
+}
+
+bool trModuleScheduler::Touches(const trModule* module, const std::vector<const trModule*>& data)
+{
+	// A module always writes its own data
+	if (std::find(data.begin(), data.end(), module) != data.end())
+		return true;
+
+	for (uint i = 0u; i < module->writes.size(); ++i)
+	{
+		if (std::find(data.begin(), data.end(), module->writes[i]) != data.end())
+			return true;
+	}
+
+	return false;
+}
+
+// ---------------------------------------------
+void trModuleScheduler::Launch(uint node_index)
+{
+	if (nodes[node_index].module->main_thread_only)
+	{
+		std::lock_guard<std::mutex> lock(main_mutex);
+		main_ready.push_back(node_index);
+		main_wake.notify_one();
+	}
+	else
+		App->job_system->Run([this, node_index]() { RunNode(node_index); });
+}
+
+void trModuleScheduler::RunNode(uint node_index)
+{
+	trModule* module = nodes[node_index].module;
+
+	// Same as the serial walk: once a module fails the rest of the phase is skipped
+	if (module->active && phase_ret)
+	{
+		if (!(*current_call)(module))
+			phase_ret = false;
+	}
+
+	const std::vector<uint>& successors = nodes[node_index].successors;
+	for (uint i = 0u; i < successors.size(); ++i)
+	{
+		if (pending[successors[i]].fetch_sub(1) == 1)
+			Launch(successors[i]);
+	}
+
+	if (nodes_left.fetch_sub(1) == 1)
+	{
+		// Under the lock, so the main thread can't miss it between its check and its wait
+		std::lock_guard<std::mutex> lock(main_mutex);
+		main_wake.notify_one();
+	}
+}
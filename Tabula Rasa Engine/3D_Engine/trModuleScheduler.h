@@ -0,0 +1,71 @@
+#ifndef __trMODULESCHEDULER_H__
+#define __trMODULESCHEDULER_H__
+
+#include "trModule.h"
+#include "trDefs.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <vector>
+
+// Dependency graph of the modules taking part in one update phase. Edges come only from the data
+// the modules declare (trModule::Reads/Writes), being main thread only adds none: modules that
+// don't touch each other's data run concurrently on the job system, main thread only ones run
+// on the calling thread, in list order when several are ready at once.
+class trModuleScheduler
+{
+public:
+
+	typedef std::function<bool(trModule*)> PhaseCall;
+
+private:
+
+	struct Node
+	{
+		trModule* module = nullptr;
+		std::vector<uint> successors;
+		uint predecessor_count = 0u;
+	};
+
+public:
+
+	trModuleScheduler();
+	~trModuleScheduler();
+
+	// Builds the graph keeping the list order between conflicting modules only.
+	// final_stage (optional) waits for every other module of the phase.
+	void Build(const std::list<trModule*>& modules, trModule::update_phase phase, const trModule* final_stage = nullptr);
+	void Clear();
+
+	// Calls every active module of the graph. Returns false if any of them did.
+	bool Execute(const PhaseCall& call);
+
+	uint GetModuleCount() const;
+	uint GetCriticalPathLength() const;
+
+private:
+
+	static bool Conflicts(const trModule* first, const trModule* second);
+	static bool Touches(const trModule* module, const std::vector<const trModule*>& data);
+
+	void Launch(uint node_index);
+	void RunNode(uint node_index);
+
+private:
+
+	std::vector<Node> nodes;
+	std::atomic<int>* pending = nullptr; // predecessors left per node while executing
+
+	// Execution state, valid during Execute
+	const PhaseCall* current_call = nullptr;
+	std::atomic<bool> phase_ret;
+	std::atomic<int> nodes_left;
+	std::mutex main_mutex;
+	std::condition_variable main_wake; // a main thread module got ready or the last node finished
+	std::vector<uint> main_ready;
+};
+
+#endif // __trMODULESCHEDULER_H__
@@ -33,4 +33,19 @@ double trPerfTimer::ReadMs() const
 uint64 trPerfTimer::ReadTicks() const
 {
 	return SDL_GetPerformanceCounter() - started_at;
+}
+
+// ---------------------------------------------
+uint64 trPerfTimer::GetStartTicks() const
+{
+	return started_at;
+}
+
+// ---------------------------------------------
+uint64 trPerfTimer::GetFrequency()
+{
+	if (frequency == 0)
+		frequency = SDL_GetPerformanceFrequency();
+
+	return frequency;
 }
\ No newline at end of file
@@ -13,6 +13,9 @@ public:
 	void Start();
 	double ReadMs() const;
 	uint64 ReadTicks() const;
+	uint64 GetStartTicks() const;
+
+	static uint64 GetFrequency();
 
 private:
 
@@ -0,0 +1,118 @@
+#ifndef __trPOOL_H__
+#define __trPOOL_H__
+
+#include "trDefs.h"
+
+#include <mutex>
+#include <new>
+#include <vector>
+
+#define POOL_DEFAULT_SLAB 256 // objects per slab when the pool runs out
+
+// Fixed size slots in contiguous slabs with an intrusive free list.
+// Freed slots are reused first, slabs are only released with the pool.
+// Consecutive allocations from a new slab are adjacent in memory.
+template<typename T>
+class trPool
+{
+private:
+
+	union Slot
+	{
+		Slot* next;
+		alignas(T) uchar storage[sizeof(T)];
+	};
+
+public:
+
+	trPool(uint slab_size = POOL_DEFAULT_SLAB) : slab_size(slab_size) {}
+
+	~trPool()
+	{
+		for (uint i = 0u; i < slabs.size(); ++i)
+			RELEASE_ARRAY(slabs[i]);
+	}
+
+	// Raw memory for one T, construct with placement new
+	void* Allocate()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		if (free_list == nullptr)
+			AddSlab(slab_size);
+
+		Slot* slot = free_list;
+		free_list = slot->next;
+		used++;
+
+		return slot;
+	}
+
+	// The object must be already destructed
+	void Free(void* pointer)
+	{
+		if (pointer == nullptr)
+			return;
+
+		std::lock_guard<std::mutex> lock(mutex);
+
+		Slot* slot = (Slot*)pointer;
+		slot->next = free_list;
+		free_list = slot;
+		used--;
+	}
+
+	// Makes room for count more objects, in a single slab if they don't fit already
+	void Reserve(uint count)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		if (capacity - used < count)
+			AddSlab(count - (capacity - used));
+	}
+
+	uint GetUsed() const { return used; }
+	uint GetCapacity() const { return capacity; }
+	uint GetSlabCount() const { return slabs.size(); }
+
+private:
+
+	void AddSlab(uint count)
+	{
+		Slot* slab = new Slot[count];
+		slabs.push_back(slab);
+		capacity += count;
+
+		// Linked in address order, so the slab is handed out front to back
+		for (uint i = count; i > 0u; --i)
+		{
+			slab[i - 1u].next = free_list;
+			free_list = &slab[i - 1u];
+		}
+	}
+
+private:
+
+	std::mutex mutex;
+	std::vector<Slot*> slabs;
+	Slot* free_list = nullptr;
+	uint slab_size = POOL_DEFAULT_SLAB;
+	uint used = 0u;
+	uint capacity = 0u;
+};
+
+// Routes new/delete of a class to its own pool. Put TR_POOLED_CLASS(Class) in the
+// class declaration and TR_POOLED_CLASS_IMPL(Class) in its .cpp. Derived classes
+// of a different size fall back to the heap.
+#define TR_POOLED_CLASS(type) \
+public: \
+	static void* operator new(size_t size); \
+	static void operator delete(void* pointer, size_t size); \
+	static trPool<type>& GetPool();
+
+#define TR_POOLED_CLASS_IMPL(type) \
+	trPool<type>& type::GetPool() { static trPool<type> pool; return pool; } \
+	void* type::operator new(size_t size) { return size == sizeof(type) ? GetPool().Allocate() : ::operator new(size); } \
+	void type::operator delete(void* pointer, size_t size) { if (size == sizeof(type)) GetPool().Free(pointer); else ::operator delete(pointer); }
+
+#endif // __trPOOL_H__
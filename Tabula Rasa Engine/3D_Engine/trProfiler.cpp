@@ -0,0 +1,206 @@
+// ----------------------------------------------------
+// trProfiler.cpp
+// Scoped zones in per thread rings, Chrome trace export
+// ----------------------------------------------------
+
+#include "trProfiler.h"
+#include "trApp.h"
+#include "trLog.h"
+
+#include <algorithm>
+#include <memory>
+#include <string>
+
+std::atomic<bool> trProfiler::enabled(true);
+std::atomic<uint> trProfiler::frame(0u);
+std::mutex trProfiler::rings_mutex;
+std::vector<trProfiler::ThreadRing*> trProfiler::rings;
+
+thread_local trProfiler::ThreadRing* trProfiler::thread_ring = nullptr;
+
+struct TraceEvent
+{
+	trProfileZone zone;
+	uint thread_index = 0u;
+};
+
+// ---------------------------------------------
+void trProfiler::BeginFrame()
+{
+	// Called from the main thread, it takes the first ring (named Main in the trace)
+	if (enabled.load(std::memory_order_relaxed))
+		GetThreadRing();
+
+	frame++;
+}
+
+uint trProfiler::GetFrame()
+{
+	return frame.load();
+}
+
+// ---------------------------------------------
+void trProfiler::Record(const char* name, uint64 start, uint64 end)
+{
+	if (!enabled.load(std::memory_order_relaxed))
+		return;
+
+	ThreadRing* ring = GetThreadRing();
+
+	uint index = ring->write_index.load(std::memory_order_relaxed);
+	ZoneSlot& slot = ring->zones[index % PROFILER_RING_SIZE];
+
+	// Odd before touching the fields, a dump reading them meanwhile drops the zone
+	slot.sequence.store(index * 2u + 1u, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	slot.name.store(name, std::memory_order_relaxed);
+	slot.start.store(start, std::memory_order_relaxed);
+	slot.end.store(end, std::memory_order_relaxed);
+	slot.frame.store(frame.load(std::memory_order_relaxed), std::memory_order_relaxed);
+
+	slot.sequence.store(index * 2u + 2u, std::memory_order_release);
+	ring->write_index.store(index + 1u, std::memory_order_release);
+}
+
+// False if the zone was being written or already overwritten by a newer one
+bool trProfiler::ReadZone(const ThreadRing* ring, uint index, trProfileZone& zone)
+{
+	const ZoneSlot& slot = ring->zones[index % PROFILER_RING_SIZE];
+
+	uint sequence = slot.sequence.load(std::memory_order_acquire);
+	if (sequence != index * 2u + 2u)
+		return false;
+
+	zone.name = slot.name.load(std::memory_order_relaxed);
+	zone.start = slot.start.load(std::memory_order_relaxed);
+	zone.end = slot.end.load(std::memory_order_relaxed);
+	zone.frame = slot.frame.load(std::memory_order_relaxed);
+
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return slot.sequence.load(std::memory_order_relaxed) == sequence;
+}
+
+trProfiler::ThreadRing* trProfiler::GetThreadRing()
+{
+	if (thread_ring == nullptr)
+	{
+		ThreadRing* ring = new ThreadRing();
+		ring->write_index = 0u;
+		for (uint i = 0u; i < PROFILER_RING_SIZE; ++i)
+			ring->zones[i].sequence = 0u;
+
+		std::lock_guard<std::mutex> lock(rings_mutex);
+		ring->thread_index = rings.size();
+		rings.push_back(ring);
+		thread_ring = ring;
+	}
+
+	return thread_ring;
+}
+
+// ---------------------------------------------
+bool trProfiler::DumpChromeTrace(const char* path, uint frame_count)
+{
+	uint last_frame = frame.load();
+	uint first_frame = last_frame > frame_count ? last_frame - frame_count : 0u;
+
+	std::shared_ptr<std::vector<TraceEvent>> events = std::make_shared<std::vector<TraceEvent>>();
+	uint thread_count = 0u;
+	{
+		std::lock_guard<std::mutex> lock(rings_mutex);
+		thread_count = rings.size();
+
+		for (uint r = 0u; r < rings.size(); ++r)
+		{
+			// Other threads keep recording, zones they overwrite while we copy are dropped
+			uint end = rings[r]->write_index.load(std::memory_order_acquire);
+			uint begin = end > PROFILER_RING_SIZE ? end - PROFILER_RING_SIZE : 0u;
+
+			for (uint i = begin; i < end; ++i)
+			{
+				trProfileZone zone;
+				if (!ReadZone(rings[r], i, zone))
+					continue;
+				if (zone.frame < first_frame || zone.frame > last_frame)
+					continue;
+
+				TraceEvent event;
+				event.zone = zone;
+				event.thread_index = rings[r]->thread_index;
+				events->push_back(event);
+			}
+		}
+	}
+
+	if (events->empty())
+	{
+		TR_LOG("trProfiler: Nothing recorded to dump");
+		return false;
+	}
+
+	std::string file_path(path);
+	uint event_count = events->size();
+
+	// Formatting and writing happen on the io thread
+	App->async_io.Submit([events, file_path, thread_count]()
+	{
+		FILE* file = nullptr;
+		if (fopen_s(&file, file_path.c_str(), "w") != 0 || file == nullptr)
+			return false;
+
+		uint64 base = events->front().zone.start;
+		for (uint i = 0u; i < events->size(); ++i)
+			base = MIN(base, (*events)[i].zone.start);
+
+		double ticks_to_us = 1000000.0 / (double)trPerfTimer::GetFrequency();
+
+		fprintf(file, "{\"traceEvents\":[\n");
+		for (uint t = 0u; t < thread_count; ++t)
+			fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":\"%s %u\"}},\n", t, t == 0u ? "Main" : "Thread", t);
+
+		for (uint i = 0u; i < events->size(); ++i)
+		{
+			const TraceEvent& event = (*events)[i];
+			fprintf(file, "{\"name\":\"%s\",\"cat\":\"frame %u\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}%s\n",
+				event.zone.name, event.zone.frame, event.thread_index,
+				(double)(event.zone.start - base) * ticks_to_us,
+				(double)(event.zone.end - event.zone.start) * ticks_to_us,
+				i + 1u < events->size() ? "," : "");
+		}
+		fprintf(file, "]}\n");
+		fclose(file);
+
+		return true;
+	},
+	[file_path, event_count](bool success)
+	{
+		if (success)
+			TR_LOG("trProfiler: %u zones written to %s", event_count, file_path.c_str());
+		else
+			TR_LOG("trProfiler: Error writing %s", file_path.c_str());
+	});
+
+	return true;
+}
+
+// ---------------------------------------------
+void trProfiler::SetEnabled(bool enabled)
+{
+	trProfiler::enabled = enabled;
+}
+
+bool trProfiler::IsEnabled()
+{
+	return enabled.load();
+}
+
+void trProfiler::ShutDown()
+{
+	enabled = false;
+
+	std::lock_guard<std::mutex> lock(rings_mutex);
+	for (uint i = 0u; i < rings.size(); ++i)
+		RELEASE(rings[i]);
+	rings.clear();
+}
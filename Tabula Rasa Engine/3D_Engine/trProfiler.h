@@ -0,0 +1,105 @@
+#ifndef __trPROFILER_H__
+#define __trPROFILER_H__
+
+#include "trDefs.h"
+#include "trPerfTimer.h"
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#define PROFILER_RING_SIZE 16384	// zones kept per thread
+#define PROFILER_DUMP_FRAMES 120	// frames written by a dump when none are asked
+#define PROFILER_TRACE_FILE "profile_trace.json"
+
+// Remove every zone from the build defining TR_PROFILER_DISABLED
+#ifndef TR_PROFILER_DISABLED
+#define TR_PROFILE_CONCAT_IMPL(a, b) a##b
+#define TR_PROFILE_CONCAT(a, b) TR_PROFILE_CONCAT_IMPL(a, b)
+#define TR_PROFILE_SCOPE(name) trProfileScope TR_PROFILE_CONCAT(profile_scope_, __LINE__)(name)
+#else
+#define TR_PROFILE_SCOPE(name)
+#endif
+
+struct trProfileZone
+{
+	const char* name = nullptr; // must outlive the dump: literals or module names
+	uint64 start = 0u;
+	uint64 end = 0u;
+	uint frame = 0u;
+};
+
+// Records timed zones in per thread rings. Recording doesn't lock, only the first zone
+// of a thread registers its ring. Dumps the last frames as Chrome trace_event JSON
+// (chrome://tracing or ui.perfetto.dev).
+class trProfiler
+{
+private:
+
+	// Seqlock per zone: odd sequence while the owner writes it, 2 * (index + 1) once written.
+	// The dump keeps a copy only if the sequence didn't change while copying.
+	struct ZoneSlot
+	{
+		std::atomic<uint> sequence;
+		std::atomic<const char*> name;
+		std::atomic<uint64> start;
+		std::atomic<uint64> end;
+		std::atomic<uint> frame;
+	};
+
+	// Only the owner thread writes, the dump reads up to write_index
+	struct ThreadRing
+	{
+		uint thread_index = 0u;
+		std::atomic<uint> write_index;
+		ZoneSlot zones[PROFILER_RING_SIZE];
+	};
+
+public:
+
+	static void BeginFrame();
+	static uint GetFrame();
+
+	static void Record(const char* name, uint64 start, uint64 end);
+
+	// Collects the zones of the last frame_count frames and writes them on the io thread
+	static bool DumpChromeTrace(const char* path = PROFILER_TRACE_FILE, uint frame_count = PROFILER_DUMP_FRAMES);
+
+	static void SetEnabled(bool enabled);
+	static bool IsEnabled();
+
+	// Once every thread that recorded is gone
+	static void ShutDown();
+
+private:
+
+	static ThreadRing* GetThreadRing();
+	static bool ReadZone(const ThreadRing* ring, uint index, trProfileZone& zone);
+
+private:
+
+	static std::atomic<bool> enabled;
+	static std::atomic<uint> frame;
+	static std::mutex rings_mutex;
+	static std::vector<ThreadRing*> rings;
+	static thread_local ThreadRing* thread_ring;
+};
+
+class trProfileScope
+{
+public:
+
+	trProfileScope(const char* name) : name(name) {}
+
+	~trProfileScope()
+	{
+		trProfiler::Record(name, timer.GetStartTicks(), timer.GetStartTicks() + timer.ReadTicks());
+	}
+
+private:
+
+	const char* name = nullptr;
+	trPerfTimer timer;
+};
+
+#endif // __trPROFILER_H__
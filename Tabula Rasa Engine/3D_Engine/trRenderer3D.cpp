@@ -16,10 +16,13 @@
 #include "ResourceTexture.h"
 
 #include "trOpenGL.h"
+#include "trJobSystem.h"
+#include "trProfiler.h"
 
 #define N_PLANE 0.125f
 #define F_PLANE 1024.0f
 #define FOV 60.0f
+#define CULLING_GRAIN 256
 
 #define DEFAULT_AMBIENT_COLOR {0.f,120.f,120.f,255.f}
 
@@ -27,6 +30,7 @@
 trRenderer3D::trRenderer3D() : trModule()
 {
 	name = "Renderer3D";
+	phases = PHASE_PRE_UPDATE | PHASE_POST_UPDATE;
 }
 
 // Destructor
@@ -36,6 +40,11 @@ trRenderer3D::~trRenderer3D()
 // Called before render is available
 bool trRenderer3D::Awake(JSON_Object* config)
 {
+	if (App->IsHeadless()) {
+		TR_LOG("Renderer3D: Headless mode, no GL context created");
+		return true;
+	}
+
 	TR_LOG("Renderer3D: Creating 3D Renderer context");
 
 	bool ret = true;
@@ -193,6 +202,9 @@ bool trRenderer3D::Awake(JSON_Object* config)
 // PreUpdate: clear buffer
 bool trRenderer3D::PreUpdate(float dt)
 {
+	if (App->IsHeadless())
+		return true;
+
 	ComponentCamera* camera_co = nullptr;
 
 	if (App->IsRunTime()) 
@@ -225,6 +237,10 @@ bool trRenderer3D::PreUpdate(float dt)
 // PostUpdate present buffer to screen
 bool trRenderer3D::PostUpdate(float dt)
 {
+	// Every module is done moving things, world matrices and boxes are brought up to date once for culling and drawing
+	App->main_scene->UpdateTransforms();
+	App->main_scene->UpdateBoundingBoxes();
+
 	// Filter the drawable gos:
 	ComponentCamera* camera_co = nullptr;
 
@@ -236,32 +252,44 @@ bool trRenderer3D::PostUpdate(float dt)
 		camera_co = App->camera->dummy_camera;
 	}
 
-	meshable_go.clear();
+	FrameVector<GameObject*> meshable_go(App->frame_allocator);
 	drawable_go.clear();
 
-	App->main_scene->CollectDinamicGOs(meshable_go);
-
 	// Camera culling
 	ComponentCamera* main_camera_co = (ComponentCamera*)App->main_scene->main_camera->FindComponentByType(Component::component_type::COMPONENT_CAMERA);
-	// Quadtree update
-
-	App->main_scene->quadtree.CollectsGOs(main_camera_co->frustum, meshable_go);
 
 	if (main_camera_co->frustum_culling) {
 
-		for (uint i = 0; i < meshable_go.size(); i++)
+		// Static and dynamic gos, the bounds pass above already moved them in the quadtree and refitted the BVH.
+		// Nodes fully inside the frustum are visible as they are, only the objects of the ones crossing it are tested.
+		FrameVector<GameObject*> candidates(App->frame_allocator);
+		App->main_scene->CollectInFrustum(main_camera_co->frustum, meshable_go, &candidates);
+
+		// Planes once per frame. Each go only writes its own slot, so chunks run on any core
+		culler.SetFrustum(main_camera_co->frustum);
+		culler.Resize(candidates.size());
+
+		App->job_system->ParallelFor(0u, candidates.size(), CULLING_GRAIN, [this, &candidates](uint begin, uint end)
 		{
-			if (main_camera_co->FrustumContainsAaBox(meshable_go.at(i)->bounding_box))
-				meshable_go.at(i)->in_camera = true;
-			else
-				meshable_go.at(i)->in_camera = false;
-		}
+			for (uint i = begin; i < end; i++)
+				culler.SetBox(i, candidates[i]->bounding_box);
+		});
 
-		CollectActiveInCameraGameObjects();
-	}
-	else {
-		CollectActiveGameObjects();
+		FrameVector<uint> visible(App->frame_allocator);
+		visible.reserve(candidates.size());
+		culler.Cull(visible);
+
+		for (uint i = 0u; i < visible.size(); i++)
+			meshable_go.push_back(candidates[visible[i]]);
 	}
+	else
+		App->main_scene->CollectAll(meshable_go); // no node test either
+
+	CollectActiveGameObjects(meshable_go);
+
+	// Headless only keeps the culling results
+	if (App->IsHeadless())
+		return true;
 
 	//RENDER GEOMETRY
 	if (App->main_scene != nullptr)
@@ -294,12 +322,16 @@ bool trRenderer3D::CleanUp()
 {
 	TR_LOG("Renderer3D: CleanUp");
 
-	SDL_GL_DeleteContext(context); // TODO: crash here whem importing scene multiple times
+	if (context != nullptr)
+		SDL_GL_DeleteContext(context); // TODO: crash here whem importing scene multiple times
 	return true;
 }
 
 bool trRenderer3D::Load(const JSON_Object * config)
 {
+	if (App->IsHeadless())
+		return true;
+
 	if (config != nullptr) {
 		wireframe = json_object_get_boolean(config, "wireframe");
 		depth_test = json_object_get_boolean(config, "depth_test");
@@ -488,6 +520,8 @@ const uint trRenderer3D::GetMeshesSize() const
 
 void trRenderer3D::Draw()
 {
+	TR_PROFILE_SCOPE("trRenderer3D::Draw");
+
 	glEnableClientState(GL_VERTEX_ARRAY);
 	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
 
@@ -495,7 +529,7 @@ void trRenderer3D::Draw()
 	while (it != drawable_go.end())
 	{
 		glPushMatrix();
-		glMultMatrixf((GLfloat*)(*it)->GetTransform()->GetMatrix().Transposed().ptr());
+		glMultMatrixf((GLfloat*)(*it)->GetTransform()->GetInterpolatedMatrix(App->GetInterpolationAlpha()).Transposed().ptr());
 
 		ComponentMesh* mesh_co = (ComponentMesh*)(*it)->FindComponentByType(Component::component_type::COMPONENT_MESH);
 		ResourceMesh* mesh = (ResourceMesh*)mesh_co->GetResource();
@@ -574,7 +608,7 @@ void trRenderer3D::DrawZBuffer()
 {
 	int width = App->window->GetWidth();
 	int height = App->window->GetHeight();
-	float* data = new float[width * height];
+	float* data = App->frame_allocator.AllocateArray<float>(width * height);
 
 	// First, we read the Z-Buffer and store its values in data
 	glReadPixels(0, 0, width, height, GL_DEPTH_COMPONENT, GL_FLOAT, data);
@@ -592,32 +626,16 @@ void trRenderer3D::DrawZBuffer()
 	}
 
 	glDrawPixels(width, height, GL_LUMINANCE, GL_FLOAT, first_data);
-	delete[] first_data;
 }
 
-void trRenderer3D::CollectActiveGameObjects()
+void trRenderer3D::CollectActiveGameObjects(const FrameVector<GameObject*>& meshable_go)
 {
 	for (uint i = 0u; i < meshable_go.size(); i++)
 	{
-		if (meshable_go.at(i)->is_active && !meshable_go.at(i)->to_destroy) {
-			ComponentMesh* mesh_co = (ComponentMesh*)meshable_go.at(i)->FindComponentByType(Component::component_type::COMPONENT_MESH);
-			if (mesh_co && mesh_co->GetResource())
-				drawable_go.push_back(meshable_go.at(i));
-		}
-	}
-}
-
-void trRenderer3D::CollectActiveInCameraGameObjects()
-{
-	for (uint i = 0u; i < meshable_go.size(); i++)
-	{
-		if (meshable_go.at(i)->is_active && meshable_go.at(i)->in_camera && !meshable_go.at(i)->to_destroy) {
-			ComponentMesh* mesh_co = (ComponentMesh*)meshable_go.at(i)->FindComponentByType(Component::component_type::COMPONENT_MESH);
-			if (mesh_co) {
-				ResourceMesh* mesh = (ResourceMesh*)mesh_co->GetResource();
-				if (mesh_co && mesh)
-					drawable_go.push_back(meshable_go.at(i));
-			}
+		GameObject* go = meshable_go.at(i);
+		if (go->is_active && !go->to_destroy && go->HasComponent(Component::component_type::COMPONENT_MESH)) {
+			if (go->FindComponentByType(Component::component_type::COMPONENT_MESH)->GetResource())
+				drawable_go.push_back(go);
 		}
 	}
 }
@@ -6,6 +6,7 @@
 #include "trDefs.h"
 
 #include "Light.h"
+#include "trFrustumCuller.h"
 
 #include "MathGeoLib/MathBuildConfig.h"
 #include "MathGeoLib/MathGeoLib.h"
@@ -48,8 +49,7 @@ public:
 
 	const uint GetMeshesSize() const;
 
-	void CollectActiveGameObjects();
-	void CollectActiveInCameraGameObjects();
+	void CollectActiveGameObjects(const FrameVector<GameObject*>& meshable_go);
 
 	void Draw();
 	void DrawZBuffer();
@@ -57,7 +57,7 @@ public:
 public:
 
 	Light lights[MAX_LIGHTS];
-	SDL_GLContext context;
+	SDL_GLContext context = nullptr;
 
 	ComponentCamera* active_camera = nullptr;
 
@@ -74,8 +74,11 @@ public:
 
 private:
 
-	std::vector<GameObject*> meshable_go;
+	// Kept between frames (the editor reads it), clear() keeps the capacity
 	std::vector<GameObject*> drawable_go;
 
+	// Boxes of the collected gos against the camera, its arrays are reused every frame
+	trFrustumCuller culler;
+
 };
 #endif
\ No newline at end of file
@@ -30,6 +30,8 @@ public:
 	bool Awake(JSON_Object* config = nullptr);
 	bool Start();
 	bool CleanUp();
+
+	void DeclareDependencies();
 	bool PostUpdate(float dt);
 
 	UID Find(const char* file_in_assets) const;
@@ -45,6 +47,11 @@ public:
 
 	Resource::Type TypeFromExtension(const char* extension) const;
 
+	SceneImporter* GetSceneImporter();
+	MaterialImporter* GetMaterialImporter();
+	// Never creates it, nullptr if nothing was imported or loaded through DevIL
+	MaterialImporter* FindMaterialImporter() const;
+
 	Resource* Get(UID uid);
 	Resource* CreateNewResource(Resource::Type type, UID uid_to_force = 0u, 
 		const char* file_name = nullptr, const char* imported_path = nullptr, const char* exported_path = nullptr);
@@ -53,9 +60,11 @@ private:
 	UID last_uid = 1;
 	std::map<UID, Resource*> resources;
 
-public:
+	// Created on first use, shared with the file loader
 	SceneImporter* mesh_importer = nullptr;
 	MaterialImporter* material_importer = nullptr;
+
+public:
 	BoneImporter* bone_importer = nullptr;
 	AnimationImporter* animation_importer = nullptr;
 
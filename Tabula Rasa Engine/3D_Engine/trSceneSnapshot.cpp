@@ -0,0 +1,143 @@
+// ----------------------------------------------------
+// trSceneSnapshot.cpp
+// Flat copy of the scene data for the io thread
+// ----------------------------------------------------
+
+#include "trSceneSnapshot.h"
+#include "GameObject.h"
+
+void trSnapshotRecord::AddNumber(const char * key, double value)
+{
+	Field field;
+	field.key = key;
+	field.type = FIELD_NUMBER;
+	field.number = value;
+	fields.push_back(field);
+}
+
+void trSnapshotRecord::AddBool(const char * key, bool value)
+{
+	Field field;
+	field.key = key;
+	field.type = FIELD_BOOL;
+	field.number = value ? 1.0 : 0.0;
+	fields.push_back(field);
+}
+
+void trSnapshotRecord::AddString(const char * key, const char * value)
+{
+	Field field;
+	field.key = key;
+	field.type = FIELD_STRING;
+	field.text = value != nullptr ? value : "";
+	fields.push_back(field);
+}
+
+void trSnapshotRecord::AddArray(const char * key, const float * values, uint count)
+{
+	Field field;
+	field.key = key;
+	field.type = FIELD_ARRAY;
+	field.numbers.assign(values, values + count);
+	fields.push_back(field);
+}
+
+// ---------------------------------------------
+void trSnapshotRecord::Write(JSON_Object * obj) const
+{
+	for (uint i = 0u; i < fields.size(); ++i)
+	{
+		const Field& field = fields[i];
+
+		switch (field.type)
+		{
+		case FIELD_NUMBER:
+			json_object_set_number(obj, field.key, field.number);
+			break;
+		case FIELD_BOOL:
+			json_object_set_boolean(obj, field.key, field.number != 0.0);
+			break;
+		case FIELD_STRING:
+			json_object_set_string(obj, field.key, field.text.c_str());
+			break;
+		case FIELD_ARRAY:
+		{
+			JSON_Value* array_value = json_value_init_array();
+			JSON_Array* array = json_value_get_array(array_value);
+			json_object_set_value(obj, field.key, array_value);
+			for (uint n = 0u; n < field.numbers.size(); ++n)
+				json_array_append_number(array, field.numbers[n]);
+			break;
+		}
+		}
+	}
+}
+
+// ---------------------------------------------
+void trSceneSnapshot::Capture(const GameObject * go)
+{
+	GameObjectData data;
+	go->Capture(data.record);
+	data.first_component = components.size();
+	data.component_count = go->components.size();
+	gos.push_back(data);
+
+	for (std::list<Component*>::const_iterator it = go->components.begin(); it != go->components.end(); ++it)
+	{
+		ComponentData copy;
+		copy.type = (*it)->GetType();
+		(*it)->Capture(copy.record);
+		components.push_back(copy);
+	}
+
+	for (std::list<GameObject*>::const_iterator it = go->childs.begin(); it != go->childs.end(); ++it)
+		Capture(*it);
+}
+
+// ---------------------------------------------
+JSON_Value* trSceneSnapshot::ToJson(const char * scene_name) const
+{
+	JSON_Value* root_value = json_value_init_object();
+	JSON_Object* root_obj = json_value_get_object(root_value);
+	json_object_set_string(root_obj, "Name", scene_name);
+
+	JSON_Value* go_value = json_value_init_array();
+	json_object_set_value(root_obj, "GameObjects", go_value);
+	Write(json_value_get_array(go_value));
+
+	return root_value;
+}
+
+void trSceneSnapshot::Write(JSON_Array * array) const
+{
+	for (uint i = 0u; i < gos.size(); ++i)
+	{
+		const GameObjectData& go = gos[i];
+
+		JSON_Value* go_obj_value = json_value_init_object();
+		JSON_Object* go_obj = json_value_get_object(go_obj_value);
+		go.record.Write(go_obj);
+
+		JSON_Value* array_value = json_value_init_array();
+		JSON_Array* components_array = json_value_get_array(array_value);
+		json_object_set_value(go_obj, "Components", array_value);
+
+		for (uint c = go.first_component; c < go.first_component + go.component_count; ++c)
+		{
+			JSON_Value* component_value = json_value_init_object();
+			JSON_Object* component_obj = json_value_get_object(component_value);
+
+			json_object_set_number(component_obj, "Type", components[c].type);
+			components[c].record.Write(component_obj);
+
+			json_array_append_value(components_array, component_value);
+		}
+
+		json_array_append_value(array, go_obj_value);
+	}
+}
+
+uint trSceneSnapshot::GetCount() const
+{
+	return gos.size();
+}
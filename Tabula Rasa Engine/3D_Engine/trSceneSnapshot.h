@@ -0,0 +1,88 @@
+#ifndef __trSCENESNAPSHOT_H__
+#define __trSCENESNAPSHOT_H__
+
+#include "trDefs.h"
+#include "Component.h"
+#include "ParsonJson/parson.h"
+
+#include <string>
+#include <vector>
+
+class GameObject;
+
+// Plain copy of the values an object or a component saves, in save order. Filled by their
+// Capture on the main thread, written as JSON from any thread: the keys only live in Capture.
+class trSnapshotRecord
+{
+private:
+
+	enum field_type
+	{
+		FIELD_NUMBER,
+		FIELD_BOOL,
+		FIELD_STRING,
+		FIELD_ARRAY
+	};
+
+	struct Field
+	{
+		const char* key = nullptr; // literals only
+		field_type type = FIELD_NUMBER;
+		double number = 0.0;
+		std::string text;
+		std::vector<double> numbers;
+	};
+
+public:
+
+	void AddNumber(const char* key, double value);
+	void AddBool(const char* key, bool value);
+	void AddString(const char* key, const char* value);
+	void AddArray(const char* key, const float* values, uint count);
+
+	void Write(JSON_Object* obj) const;
+
+private:
+
+	std::vector<Field> fields;
+};
+
+// Plain copy of what a .trScene keeps of every object, in flat arrays. It is taken on the main
+// thread and owns no pointer to the scene, so the DOM can be built and written on the io thread
+// while the scene keeps changing. GameObject::Save goes through it as well.
+class trSceneSnapshot
+{
+private:
+
+	struct ComponentData
+	{
+		Component::component_type type = Component::COMPONENT_UNKNOWN;
+		trSnapshotRecord record;
+	};
+
+	struct GameObjectData
+	{
+		trSnapshotRecord record;
+		uint first_component = 0u;
+		uint component_count = 0u;
+	};
+
+public:
+
+	// Main thread. The object and its childs, parents before childs.
+	void Capture(const GameObject* go);
+
+	// Any thread, the caller owns the value
+	JSON_Value* ToJson(const char* scene_name) const;
+	// Any thread, one element per object
+	void Write(JSON_Array* array) const;
+
+	uint GetCount() const;
+
+private:
+
+	std::vector<GameObjectData> gos;
+	std::vector<ComponentData> components;
+};
+
+#endif // __trSCENESNAPSHOT_H__
@@ -0,0 +1,642 @@
+// ----------------------------------------------------
+// trSceneStreamer.cpp
+// Cell based scene streaming around the camera
+// ----------------------------------------------------
+
+#include "trSceneStreamer.h"
+#include "trApp.h"
+#include "trMainScene.h"
+#include "trFileSystem.h"
+#include "trProfiler.h"
+#include "GameObject.h"
+#include "ComponentMesh.h"
+#include "ResourceMesh.h"
+#include "ResourceTexture.h"
+
+#include <algorithm>
+#include <math.h>
+#include <memory>
+
+static void SetFloat3(JSON_Object* obj, const char* name, const float3& value)
+{
+	JSON_Value* array_value = json_value_init_array();
+	JSON_Array* array = json_value_get_array(array_value);
+	json_object_set_value(obj, name, array_value);
+	json_array_append_number(array, value.x);
+	json_array_append_number(array, value.y);
+	json_array_append_number(array, value.z);
+}
+
+// The object and its childs
+static uint CountObjects(const GameObject* go)
+{
+	uint count = 1u;
+	for (std::list<GameObject*>::const_iterator it = go->childs.begin(); it != go->childs.end(); it++)
+		count += CountObjects((*it));
+
+	return count;
+}
+
+// Mesh and texture files of the objects of a cell, once each
+static void CollectResourceFiles(const JSON_Value* cell_value, std::vector<std::string>& files)
+{
+	JSON_Array* gos = json_object_get_array(json_value_get_object(cell_value), "GameObjects");
+	uint go_count = gos != nullptr ? json_array_get_count(gos) : 0u;
+
+	for (uint i = 0u; i < go_count; ++i)
+	{
+		JSON_Array* components = json_object_get_array(json_array_get_object(gos, i), "Components");
+		uint component_count = components != nullptr ? json_array_get_count(components) : 0u;
+
+		for (uint c = 0u; c < component_count; ++c)
+		{
+			JSON_Object* component_obj = json_array_get_object(components, c);
+			Component::component_type type = (Component::component_type)(int)json_object_get_number(component_obj, "Type");
+			const char* path = json_object_get_string(component_obj, "path");
+
+			if (path != nullptr && (type == Component::COMPONENT_MESH || type == Component::COMPONENT_MATERIAL))
+				files.push_back(path);
+		}
+	}
+
+	std::sort(files.begin(), files.end());
+	files.erase(std::unique(files.begin(), files.end()), files.end());
+}
+
+static float3 GetFloat3(const JSON_Object* obj, const char* name)
+{
+	JSON_Array* array = json_object_get_array(obj, name);
+	if (array == nullptr || json_array_get_count(array) < 3u)
+		return float3::zero;
+
+	return float3((float)json_array_get_number(array, 0), (float)json_array_get_number(array, 1), (float)json_array_get_number(array, 2));
+}
+
+// Boxes of every mesh in the hierarchy
+static void EncloseHierarchy(GameObject* go, AABB& box, uint& objects)
+{
+	objects++;
+
+	if (go->HasComponent(Component::component_type::COMPONENT_MESH) && go->bounding_box.IsFinite())
+		box.Enclose(go->bounding_box);
+
+	for (std::list<GameObject*>::iterator it = go->childs.begin(); it != go->childs.end(); it++)
+		EncloseHierarchy((*it), box, objects);
+}
+
+trSceneStreamer::trSceneStreamer()
+{}
+
+trSceneStreamer::~trSceneStreamer()
+{
+	for (uint i = 0u; i < cells.size(); ++i)
+	{
+		if (cells[i].data != nullptr)
+			json_value_free(cells[i].data);
+	}
+}
+
+// ---------------------------------------------
+bool trSceneStreamer::Save(const char* scene_name, float cell_size, std::string& output_file)
+{
+	if (scene_name == nullptr || cell_size <= 0.0f)
+		return false;
+
+	struct CellBuild
+	{
+		int x = 0, z = 0;
+		JSON_Value* value = nullptr;
+		JSON_Array* gos = nullptr;
+		AABB bounds;
+		uint64 bytes = 0u;
+		uint objects = 0u;
+	};
+
+	std::vector<CellBuild> builds;
+	std::map<std::pair<int, int>, uint> build_index;
+
+	GameObject* root = App->main_scene->GetRoot();
+
+	// World boxes of every object
+	App->main_scene->UpdateTransforms();
+	root->RecalculateBoundingBox();
+
+	AABB world_bounds;
+	world_bounds.SetNegativeInfinity();
+
+	for (std::list<GameObject*>::const_iterator it = root->childs.begin(); it != root->childs.end(); it++)
+	{
+		GameObject* go = (*it);
+		if (go->to_destroy || go == App->main_scene->main_camera)
+			continue;
+
+		AABB box;
+		box.SetNegativeInfinity();
+		uint objects = 0u;
+		EncloseHierarchy(go, box, objects);
+
+		// Nothing to draw, the position decides
+		if (!box.IsFinite())
+		{
+			float3 position = go->GetTransform()->GetMatrix().TranslatePart();
+			box = AABB(position, position);
+		}
+
+		float3 center = box.CenterPoint();
+		std::pair<int, int> key((int)floorf(center.x / cell_size), (int)floorf(center.z / cell_size));
+
+		std::map<std::pair<int, int>, uint>::iterator found = build_index.find(key);
+		if (found == build_index.end())
+		{
+			CellBuild build;
+			build.x = key.first;
+			build.z = key.second;
+			build.value = json_value_init_object();
+			json_object_set_string(json_value_get_object(build.value), "Name", scene_name);
+
+			JSON_Value* gos_value = json_value_init_array();
+			build.gos = json_value_get_array(gos_value);
+			json_object_set_value(json_value_get_object(build.value), "GameObjects", gos_value);
+			build.bounds.SetNegativeInfinity();
+
+			found = build_index.insert(std::pair<std::pair<int, int>, uint>(key, builds.size())).first;
+			builds.push_back(build);
+		}
+
+		CellBuild& build = builds[found->second];
+		go->Save(build.gos);
+		build.bounds.Enclose(box);
+		build.bytes += EstimateBytes(go);
+		build.objects += objects;
+
+		world_bounds.Enclose(box);
+	}
+
+	// Manifest
+	JSON_Value* manifest_value = json_value_init_object();
+	JSON_Object* manifest_obj = json_value_get_object(manifest_value);
+	json_object_set_string(manifest_obj, "Name", scene_name);
+	json_object_set_number(manifest_obj, "CellSize", cell_size);
+
+	if (builds.empty())
+		world_bounds = AABB(float3::zero, float3::zero);
+	SetFloat3(manifest_obj, "Min", world_bounds.minPoint);
+	SetFloat3(manifest_obj, "Max", world_bounds.maxPoint);
+
+	JSON_Value* cells_value = json_value_init_array();
+	JSON_Array* cells_array = json_value_get_array(cells_value);
+	json_object_set_value(manifest_obj, "Cells", cells_value);
+
+	for (uint i = 0u; i < builds.size(); ++i)
+	{
+		std::string file_name(scene_name);
+		file_name.append("_" + std::to_string(builds[i].x) + "_" + std::to_string(builds[i].z) + ".trCell");
+
+		JSON_Value* cell_value = json_value_init_object();
+		JSON_Object* cell_obj = json_value_get_object(cell_value);
+		json_object_set_string(cell_obj, "File", file_name.c_str());
+		json_object_set_number(cell_obj, "X", builds[i].x);
+		json_object_set_number(cell_obj, "Z", builds[i].z);
+		SetFloat3(cell_obj, "Min", builds[i].bounds.minPoint);
+		SetFloat3(cell_obj, "Max", builds[i].bounds.maxPoint);
+		json_object_set_number(cell_obj, "Bytes", (double)builds[i].bytes);
+		json_object_set_number(cell_obj, "Objects", builds[i].objects);
+		json_array_append_value(cells_array, cell_value);
+
+		std::string cell_path(A_SCENES_DIR);
+		cell_path.append("/");
+		cell_path.append(file_name);
+		App->async_io.WriteJson(builds[i].value, cell_path.c_str());
+	}
+
+	output_file = A_SCENES_DIR;
+	output_file.append("/");
+	output_file.append(scene_name);
+	output_file.append(".trStream");
+
+	App->async_io.WriteJson(manifest_value, output_file.c_str());
+
+	TR_LOG("trSceneStreamer: %s split in %u cells of %.1f units", scene_name, builds.size(), cell_size);
+
+	return true;
+}
+
+bool trSceneStreamer::Open(const char* manifest_path)
+{
+	Close();
+
+	// It may have just been saved
+	App->async_io.WaitIdle();
+
+	JSON_Value* root_value = json_parse_file(manifest_path);
+	if (root_value == nullptr)
+	{
+		TR_LOG("trSceneStreamer: Error reading manifest %s", manifest_path);
+		return false;
+	}
+
+	JSON_Object* root_obj = json_value_get_object(root_value);
+
+	// Cell files are next to the manifest
+	std::string directory(manifest_path);
+	size_t separator = directory.find_last_of("\\/");
+	directory = separator != std::string::npos ? directory.substr(0, separator + 1) : "";
+
+	JSON_Array* cells_array = json_object_get_array(root_obj, "Cells");
+	uint count = cells_array != nullptr ? json_array_get_count(cells_array) : 0u;
+	cells.resize(count);
+
+	for (uint i = 0u; i < count; ++i)
+	{
+		JSON_Object* cell_obj = json_array_get_object(cells_array, i);
+		Cell& cell = cells[i];
+
+		cell.path = directory + json_object_get_string(cell_obj, "File");
+		cell.bounds = AABB(GetFloat3(cell_obj, "Min"), GetFloat3(cell_obj, "Max"));
+		cell.bytes = (uint64)json_object_get_number(cell_obj, "Bytes");
+		cell.objects = (uint)json_object_get_number(cell_obj, "Objects");
+	}
+
+	// The quadtree must hold the whole streamed world
+	if (count > 0u)
+		App->main_scene->SetWorldBounds(AABB(GetFloat3(root_obj, "Min"), GetFloat3(root_obj, "Max")));
+
+	const char* name = json_object_get_string(root_obj, "Name");
+	if (name != nullptr)
+		App->main_scene->scene_name = name;
+
+	json_value_free(root_value);
+
+	manifest = manifest_path;
+	TR_LOG("trSceneStreamer: Streaming %s, %u cells", manifest_path, count);
+
+	return true;
+}
+
+void trSceneStreamer::Close()
+{
+	for (uint i = 0u; i < cells.size(); ++i)
+	{
+		Cell& cell = cells[i];
+
+		// Everything at once, no budget
+		if (cell.state == CELL_LOADED || cell.state == CELL_UNLOADING)
+		{
+			for (uint j = cell.unloaded; j < cell.tops.size(); ++j)
+				App->main_scene->Destroy(App->main_scene->GetGameObject(cell.tops[j]));
+		}
+		else if (cell.state == CELL_SPAWNING)
+		{
+			for (std::map<GameObject*, UID>::iterator it = cell.uuid_relations.begin(); it != cell.uuid_relations.end(); ++it)
+				App->main_scene->Destroy(it->first);
+			for (uint j = 0u; j < cell.links.size(); ++j)
+				App->main_scene->Destroy(cell.links[j].first);
+		}
+
+		if (cell.data != nullptr)
+			json_value_free(cell.data);
+		App->file_system->DropPrefetched(cell.prefetched);
+	}
+
+	// Reads still on the io thread find no cell and free their result
+	cells.clear();
+	manifest.clear();
+	resident_bytes = 0u;
+}
+
+bool trSceneStreamer::IsOpen() const
+{
+	return !manifest.empty();
+}
+
+// ---------------------------------------------
+void trSceneStreamer::Update(const float3& viewer)
+{
+	if (cells.empty())
+		return;
+
+	TR_PROFILE_SCOPE("trSceneStreamer::Update");
+
+	float unload_radius = load_radius + hysteresis;
+	uint loading = 0u;
+
+	FrameVector<uint> candidates(App->frame_allocator);
+
+	for (uint i = 0u; i < cells.size(); ++i)
+	{
+		Cell& cell = cells[i];
+		float distance = cell.bounds.Distance(viewer);
+
+		switch (cell.state)
+		{
+		case CELL_UNLOADED:
+			if (distance <= load_radius)
+				candidates.push_back(i);
+			break;
+		case CELL_LOADING:
+			// Its completion will be dropped
+			if (distance > unload_radius) {
+				cell.state = CELL_UNLOADED;
+				resident_bytes -= cell.bytes;
+			}
+			else
+				loading++;
+			break;
+		case CELL_LOADED:
+			// Its objects go from the budget below
+			if (distance > unload_radius)
+				Unload(cell);
+			break;
+		default:
+			break; // spawning cells finish first, unloading ones are loaded again once done
+		}
+	}
+
+	// Nearest first, so a full budget only leaves out the far ones
+	std::sort(candidates.begin(), candidates.end(), [this, &viewer](uint a, uint b) { return cells[a].bounds.Distance(viewer) < cells[b].bounds.Distance(viewer); });
+
+	for (uint i = 0u; i < candidates.size() && loading < STREAM_MAX_LOADING; ++i)
+	{
+		Cell& cell = cells[candidates[i]];
+
+		// Make room with the farthest cell kept only by the hysteresis
+		while (resident_bytes + cell.bytes > memory_budget)
+		{
+			Cell* farthest = nullptr;
+			float farthest_distance = load_radius;
+
+			for (uint j = 0u; j < cells.size(); ++j)
+			{
+				float distance = cells[j].bounds.Distance(viewer);
+				if (cells[j].state == CELL_LOADED && distance > farthest_distance) {
+					farthest = &cells[j];
+					farthest_distance = distance;
+				}
+			}
+
+			if (farthest == nullptr)
+				break;
+
+			Unload(*farthest);
+		}
+
+		if (resident_bytes + cell.bytes > memory_budget)
+			break;
+
+		RequestLoad(candidates[i]);
+		loading++;
+	}
+
+	// Destroying first frees memory sooner
+	uint budget = objects_per_frame;
+	for (uint i = 0u; i < cells.size() && budget > 0u; ++i)
+	{
+		if (cells[i].state == CELL_UNLOADING)
+			Despawn(cells[i], budget);
+	}
+
+	for (uint i = 0u; i < cells.size() && budget > 0u; ++i)
+	{
+		if (cells[i].state == CELL_SPAWNING)
+			Spawn(cells[i], budget);
+	}
+}
+
+// ---------------------------------------------
+void trSceneStreamer::RequestLoad(uint index)
+{
+	Cell& cell = cells[index];
+	cell.state = CELL_LOADING;
+	cell.request = ++next_request;
+	resident_bytes += cell.bytes;
+
+	uint request = cell.request;
+	std::string path = cell.path;
+	std::shared_ptr<JSON_Value*> result = std::make_shared<JSON_Value*>(nullptr);
+	std::shared_ptr<std::vector<std::string>> files = std::make_shared<std::vector<std::string>>();
+
+	// Read and parsed on the io thread. The files of its meshes and textures are read there too,
+	// the importers take them from the file system instead of reading them while spawning.
+	// Resources already loaded read theirs for nothing, they are dropped once the cell is spawned.
+	App->async_io.Submit([result, files, path]()
+	{
+		*result = json_parse_file(path.c_str());
+		if (*result == nullptr)
+			return false;
+
+		CollectResourceFiles(*result, *files);
+		for (uint i = 0u; i < files->size(); ++i)
+			App->file_system->Prefetch((*files)[i].c_str());
+
+		return true;
+	},
+	[this, index, request, result, files, path](bool success)
+	{
+		// Abandoned or closed meanwhile
+		if (index >= cells.size() || cells[index].request != request || cells[index].state != CELL_LOADING)
+		{
+			if (*result != nullptr)
+				json_value_free(*result);
+			App->file_system->DropPrefetched(*files);
+			return;
+		}
+
+		Cell& cell = cells[index];
+
+		// Not retried, it stays loaded and empty until it is out of range
+		if (!success)
+		{
+			TR_LOG("trSceneStreamer: Error reading cell %s", path.c_str());
+			cell.state = CELL_LOADED;
+			return;
+		}
+
+		cell.data = *result;
+		cell.prefetched.swap(*files);
+		cell.spawned = 0u;
+		cell.state = CELL_SPAWNING;
+	});
+}
+
+void trSceneStreamer::Spawn(Cell& cell, uint& budget)
+{
+	// Created from the parsed file
+	if (cell.data != nullptr)
+	{
+		JSON_Array* array = json_object_get_array(json_value_get_object(cell.data), "GameObjects");
+		uint count = array != nullptr ? json_array_get_count(array) : 0u;
+
+		if (cell.spawned == 0u)
+			App->main_scene->ReserveGameObjects(count);
+
+		for (; cell.spawned < count && budget > 0u; ++cell.spawned, --budget)
+		{
+			GameObject* go = App->main_scene->CreateGameObject("unnamed for now");
+			go->Load(json_array_get_object(array, cell.spawned), cell.uuid_relations);
+		}
+
+		if (cell.spawned < count)
+			return;
+
+		json_value_free(cell.data);
+		cell.data = nullptr;
+		App->file_system->DropPrefetched(cell.prefetched);
+		cell.prefetched.clear();
+
+		cell.links.assign(cell.uuid_relations.begin(), cell.uuid_relations.end());
+		cell.uuid_relations.clear();
+		cell.linked = cell.set_up = 0u;
+	}
+
+	// Every object is there, the hierarchy is rebuilt like in DeSerializeScene
+	for (; cell.linked < cell.links.size() && budget > 0u; ++cell.linked, --budget)
+	{
+		const std::pair<GameObject*, UID>& link = cell.links[cell.linked];
+		if (link.second > 0u)
+		{
+			GameObject* parent = App->main_scene->FindGoByUUID(link.second);
+			if (parent != nullptr)
+				link.first->SetParent(parent);
+		}
+	}
+
+	if (cell.linked < cell.links.size())
+		return;
+
+	// The top ones are set up with their whole hierarchy
+	for (; cell.set_up < cell.links.size() && budget > 0u; ++cell.set_up)
+	{
+		GameObject* go = cell.links[cell.set_up].first;
+		if (go->GetParent() != App->main_scene->GetRoot())
+			continue;
+
+		go->RecalculateBoundingBox();
+		go->is_static = true;
+
+		App->main_scene->InsertGoInQuadtree(go);
+		if (go->HasComponent(Component::component_type::COMPONENT_MESH))
+			go->FindComponentByType(Component::component_type::COMPONENT_MESH)->Start();
+
+		App->main_scene->RecursiveSetupGo(go);
+		cell.tops.push_back(go->GetHandle());
+
+		budget -= MIN(budget, CountObjects(go));
+	}
+
+	if (cell.set_up < cell.links.size())
+		return;
+
+	cell.links.clear();
+	cell.unloaded = 0u;
+	cell.state = CELL_LOADED;
+}
+
+void trSceneStreamer::Despawn(Cell& cell, uint& budget)
+{
+	// Handles, the objects may have been deleted from the editor
+	for (; cell.unloaded < cell.tops.size() && budget > 0u; ++cell.unloaded)
+	{
+		GameObject* go = App->main_scene->GetGameObject(cell.tops[cell.unloaded]);
+		if (go == nullptr)
+			continue;
+
+		budget -= MIN(budget, CountObjects(go));
+		App->main_scene->Destroy(go);
+	}
+
+	if (cell.unloaded < cell.tops.size())
+		return;
+
+	cell.tops.clear();
+	cell.state = CELL_UNLOADED;
+}
+
+void trSceneStreamer::Unload(Cell& cell)
+{
+	// Its objects go a few per frame from Update
+	cell.unloaded = 0u;
+	cell.state = CELL_UNLOADING;
+	resident_bytes -= cell.bytes;
+}
+
+uint64 trSceneStreamer::EstimateBytes(GameObject* go) const
+{
+	uint64 bytes = 0u;
+
+	const Component* mesh = go->FindComponentByType(Component::component_type::COMPONENT_MESH);
+	if (mesh != nullptr && mesh->GetResource() != nullptr)
+	{
+		const ResourceMesh* res = (const ResourceMesh*)mesh->GetResource();
+		bytes += (uint64)(res->vertex_size + res->normal_size + res->size_uv) * sizeof(float) + (uint64)res->index_size * sizeof(uint);
+	}
+
+	const Component* material = go->FindComponentByType(Component::component_type::COMPONENT_MATERIAL);
+	if (material != nullptr && material->GetResource() != nullptr)
+	{
+		const ResourceTexture* res = (const ResourceTexture*)material->GetResource();
+		bytes += res->bytes > 0u ? res->bytes : (uint64)res->width * res->height * 4u;
+	}
+
+	for (std::list<GameObject*>::iterator it = go->childs.begin(); it != go->childs.end(); it++)
+		bytes += EstimateBytes((*it));
+
+	return bytes;
+}
+
+// ---------------------------------------------
+void trSceneStreamer::SetLoadRadius(float radius)
+{
+	load_radius = MAX(0.0f, radius);
+}
+
+void trSceneStreamer::SetHysteresis(float hysteresis)
+{
+	this->hysteresis = MAX(0.0f, hysteresis);
+}
+
+void trSceneStreamer::SetMemoryBudget(uint64 bytes)
+{
+	memory_budget = bytes;
+}
+
+void trSceneStreamer::SetObjectsPerFrame(uint objects)
+{
+	objects_per_frame = MAX(1u, objects);
+}
+
+float trSceneStreamer::GetLoadRadius() const
+{
+	return load_radius;
+}
+
+float trSceneStreamer::GetHysteresis() const
+{
+	return hysteresis;
+}
+
+uint64 trSceneStreamer::GetMemoryBudget() const
+{
+	return memory_budget;
+}
+
+uint64 trSceneStreamer::GetResidentBytes() const
+{
+	return resident_bytes;
+}
+
+uint trSceneStreamer::GetCellCount() const
+{
+	return cells.size();
+}
+
+uint trSceneStreamer::GetLoadedCellCount() const
+{
+	uint count = 0u;
+	for (uint i = 0u; i < cells.size(); ++i)
+	{
+		if (cells[i].state == CELL_LOADED)
+			count++;
+	}
+
+	return count;
+}
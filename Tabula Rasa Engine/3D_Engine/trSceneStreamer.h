@@ -0,0 +1,119 @@
+#ifndef __trSCENESTREAMER_H__
+#define __trSCENESTREAMER_H__
+
+#include "trDefs.h"
+#include "GameObjectHandle.h"
+#include "MathGeoLib/MathGeoLib.h"
+#include "ParsonJson/parson.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+#define STREAM_CELL_SIZE 100.0f
+#define STREAM_LOAD_RADIUS 150.0f
+#define STREAM_HYSTERESIS 25.0f					// cells unload this much farther than they load
+#define STREAM_MEMORY_BUDGET (512u * 1024u * 1024u)	// bytes of mesh and texture data
+#define STREAM_OBJECTS_PER_FRAME 64u			// spawned, linked, set up or destroyed each frame
+#define STREAM_MAX_LOADING 2u					// cells being read at the same time
+
+class GameObject;
+
+// Streamed scenes are split at save time in square cells on the XZ plane: a .trStream manifest
+// with the bounds and estimated memory of every cell, and one .trCell file per cell in the
+// .trScene format. A root child and its whole hierarchy go to the cell containing its box center.
+// Cells are read and parsed on the io thread, along with the mesh and texture files they use.
+// Their objects are spawned, linked and set up a few per frame, and destroyed a few per frame
+// through the scene destroy queue.
+class trSceneStreamer
+{
+public:
+
+	enum cell_state {
+		CELL_UNLOADED,
+		CELL_LOADING,	// on the io thread
+		CELL_SPAWNING,	// parsed, objects being created, linked and set up
+		CELL_LOADED,
+		CELL_UNLOADING	// objects being destroyed, its memory is already counted as free
+	};
+
+private:
+
+	struct Cell
+	{
+		std::string path;
+		AABB bounds;
+		uint64 bytes = 0u;
+		uint objects = 0u;
+
+		cell_state state = CELL_UNLOADED;
+		uint request = 0u; // id of the last read, stale completions are dropped
+
+		JSON_Value* data = nullptr;
+		std::vector<std::string> prefetched;	// mesh and texture files read on the io thread
+		uint spawned = 0u;
+		std::map<GameObject*, UID> uuid_relations;
+
+		// Once every object is created
+		std::vector<std::pair<GameObject*, UID>> links;
+		uint linked = 0u;
+		uint set_up = 0u;
+
+		std::vector<GameObjectHandle> tops;
+		uint unloaded = 0u;
+	};
+
+public:
+
+	trSceneStreamer();
+	~trSceneStreamer();
+
+	// Splits the current scene in cells of cell_size, the main camera is left out
+	bool Save(const char* scene_name, float cell_size, std::string& output_file);
+
+	// Reads the manifest, cells are loaded from Update. Resizes the quadtree to the streamed world.
+	bool Open(const char* manifest_path);
+
+	// Unloads every cell and forgets the manifest
+	void Close();
+	bool IsOpen() const;
+
+	// Main thread, once per frame
+	void Update(const float3& viewer);
+
+	void SetLoadRadius(float radius);
+	void SetHysteresis(float hysteresis);
+	void SetMemoryBudget(uint64 bytes);
+	void SetObjectsPerFrame(uint objects);
+
+	float GetLoadRadius() const;
+	float GetHysteresis() const;
+	uint64 GetMemoryBudget() const;
+	uint64 GetResidentBytes() const;
+	uint GetCellCount() const;
+	uint GetLoadedCellCount() const;
+
+private:
+
+	void RequestLoad(uint index);
+	// Both spend the objects per frame budget
+	void Spawn(Cell& cell, uint& budget);
+	void Despawn(Cell& cell, uint& budget);
+	void Unload(Cell& cell);
+
+	uint64 EstimateBytes(GameObject* go) const;
+
+private:
+
+	std::string manifest;
+	std::vector<Cell> cells;
+	uint next_request = 0u;
+
+	float load_radius = STREAM_LOAD_RADIUS;
+	float hysteresis = STREAM_HYSTERESIS;
+	uint64 memory_budget = STREAM_MEMORY_BUDGET;
+	uint objects_per_frame = STREAM_OBJECTS_PER_FRAME;
+	uint64 resident_bytes = 0u; // cells loading, spawning or loaded
+};
+
+#endif // __trSCENESTREAMER_H__
@@ -1,7 +1,7 @@
 #include "trTimeManager.h"
 
 
-trTimeManager::trTimeManager() { this->name = "TimeManager"; }
+trTimeManager::trTimeManager() { this->name = "TimeManager"; phases = PHASE_NONE; }
 
 trTimeManager::~trTimeManager() { }
 
@@ -0,0 +1,466 @@
+// ----------------------------------------------------
+// trTransformSystem.cpp
+// SoA transform storage and batched world matrix pass
+// ----------------------------------------------------
+
+#include "trTransformSystem.h"
+#include "trApp.h"
+#include "trJobSystem.h"
+
+#include <xmmintrin.h>
+
+trTransformSystem::trTransformSystem()
+{}
+
+trTransformSystem::~trTransformSystem()
+{
+	Clear();
+}
+
+// ---------------------------------------------
+// out = a * b, row major like MathGeoLib: every row of out is a combination of the rows of b
+void trTransformSystem::MultiplyMatrices(const float4x4& a, const float4x4& b, float4x4& out)
+{
+	const float* pa = a.ptr();
+	const float* pb = b.ptr();
+	float* po = out.ptr();
+
+	__m128 b0 = _mm_loadu_ps(pb);
+	__m128 b1 = _mm_loadu_ps(pb + 4);
+	__m128 b2 = _mm_loadu_ps(pb + 8);
+	__m128 b3 = _mm_loadu_ps(pb + 12);
+
+	for (uint r = 0u; r < 4u; ++r)
+	{
+		__m128 row = _mm_mul_ps(_mm_set1_ps(pa[r * 4]), b0);
+		row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(pa[r * 4 + 1]), b1));
+		row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(pa[r * 4 + 2]), b2));
+		row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(pa[r * 4 + 3]), b3));
+		_mm_storeu_ps(po + r * 4, row);
+	}
+}
+
+// ---------------------------------------------
+TransformHandle trTransformSystem::Create(TransformHandle parent, const float3& position, const Quat& rotation, const float3& scale)
+{
+	TransformHandle handle = INVALID_TRANSFORM;
+	if (!free_handles.empty())
+	{
+		handle = free_handles.back();
+		free_handles.pop_back();
+	}
+	else
+	{
+		handle = nodes.size();
+		nodes.push_back(Node());
+	}
+
+	// Appended: the parent is already before it
+	nodes[handle] = Node();
+	nodes[handle].index = positions.size();
+
+	positions.push_back(position);
+	rotations.push_back(rotation);
+	scales.push_back(scale);
+	locals.push_back(float4x4::FromTRS(position, rotation, scale));
+	worlds.push_back(float4x4::identity);
+	previous_worlds.push_back(float4x4::identity);
+	moved_ticks.push_back(0u);
+	parent_indices.push_back(parent != INVALID_TRANSFORM ? nodes[parent].index : INVALID_TRANSFORM);
+	dirty.push_back(1u);
+	handles.push_back(handle);
+
+	Link(handle, parent);
+
+	levels_dirty = true;
+	any_dirty = true;
+
+	return handle;
+}
+
+void trTransformSystem::Destroy(TransformHandle handle)
+{
+	// Childs are kept as roots until they are destroyed as well
+	TransformHandle child = nodes[handle].first_child;
+	while (child != INVALID_TRANSFORM)
+	{
+		TransformHandle next = nodes[child].next_sibling;
+		nodes[child].parent = INVALID_TRANSFORM;
+		nodes[child].next_sibling = nodes[child].prev_sibling = INVALID_TRANSFORM;
+		parent_indices[nodes[child].index] = INVALID_TRANSFORM;
+		MarkDirty(child);
+		child = next;
+	}
+	nodes[handle].first_child = INVALID_TRANSFORM;
+
+	Unlink(handle);
+
+	// Swap with the last one, it may end up before its parent
+	uint index = nodes[handle].index;
+	uint last = positions.size() - 1u;
+
+	if (index != last)
+	{
+		positions[index] = positions[last];
+		rotations[index] = rotations[last];
+		scales[index] = scales[last];
+		locals[index] = locals[last];
+		worlds[index] = worlds[last];
+		previous_worlds[index] = previous_worlds[last];
+		moved_ticks[index] = moved_ticks[last];
+		parent_indices[index] = parent_indices[last];
+		dirty[index] = dirty[last];
+		handles[index] = handles[last];
+
+		TransformHandle moved = handles[index];
+		nodes[moved].index = index;
+		for (child = nodes[moved].first_child; child != INVALID_TRANSFORM; child = nodes[child].next_sibling)
+			parent_indices[nodes[child].index] = index;
+
+		order_dirty = true;
+	}
+
+	positions.pop_back();
+	rotations.pop_back();
+	scales.pop_back();
+	locals.pop_back();
+	worlds.pop_back();
+	previous_worlds.pop_back();
+	moved_ticks.pop_back();
+	parent_indices.pop_back();
+	dirty.pop_back();
+	handles.pop_back();
+
+	nodes[handle] = Node();
+	free_handles.push_back(handle);
+	levels_dirty = true;
+}
+
+void trTransformSystem::Clear()
+{
+	nodes.clear();
+	free_handles.clear();
+	positions.clear();
+	rotations.clear();
+	scales.clear();
+	locals.clear();
+	worlds.clear();
+	previous_worlds.clear();
+	moved_ticks.clear();
+	parent_indices.clear();
+	dirty.clear();
+	handles.clear();
+	level_begin.clear();
+
+	order_dirty = levels_dirty = any_dirty = false;
+}
+
+// ---------------------------------------------
+void trTransformSystem::SetParent(TransformHandle handle, TransformHandle parent)
+{
+	if (nodes[handle].parent == parent)
+		return;
+
+	Unlink(handle);
+	Link(handle, parent);
+
+	uint index = nodes[handle].index;
+	parent_indices[index] = parent != INVALID_TRANSFORM ? nodes[parent].index : INVALID_TRANSFORM;
+
+	if (parent_indices[index] != INVALID_TRANSFORM && parent_indices[index] > index)
+		order_dirty = true;
+	levels_dirty = true;
+
+	MarkDirty(handle);
+}
+
+TransformHandle trTransformSystem::GetParent(TransformHandle handle) const
+{
+	return nodes[handle].parent;
+}
+
+// ---------------------------------------------
+void trTransformSystem::SetLocal(TransformHandle handle, const float3& position, const Quat& rotation, const float3& scale)
+{
+	uint index = nodes[handle].index;
+
+	positions[index] = position;
+	rotations[index] = rotation;
+	scales[index] = scale;
+	locals[index] = float4x4::FromTRS(position, rotation, scale);
+
+	MarkDirty(handle);
+}
+
+const float3& trTransformSystem::GetPosition(TransformHandle handle) const
+{
+	return positions[nodes[handle].index];
+}
+
+const Quat& trTransformSystem::GetRotation(TransformHandle handle) const
+{
+	return rotations[nodes[handle].index];
+}
+
+const float3& trTransformSystem::GetScale(TransformHandle handle) const
+{
+	return scales[nodes[handle].index];
+}
+
+const float4x4& trTransformSystem::GetLocalMatrix(TransformHandle handle) const
+{
+	return locals[nodes[handle].index];
+}
+
+const float4x4& trTransformSystem::GetWorldMatrix(TransformHandle handle)
+{
+	uint index = nodes[handle].index;
+
+	if (dirty[index])
+	{
+		uint parent = parent_indices[index];
+
+		if (parent != INVALID_TRANSFORM)
+		{
+			GetWorldMatrix(handles[parent]);
+			MultiplyMatrices(worlds[parent], locals[index], worlds[index]);
+		}
+		else
+			worlds[index] = locals[index];
+
+		dirty[index] = 0u;
+	}
+
+	return worlds[index];
+}
+
+// ---------------------------------------------
+void trTransformSystem::MarkDirty(TransformHandle handle)
+{
+	uint index = nodes[handle].index;
+
+	// A dirty transform always has dirty childs
+	if (dirty[index])
+		return;
+
+	dirty[index] = 1u;
+	any_dirty = true;
+
+	// Clean until now, so worlds still holds the state at the end of the last tick
+	if (!in_tick)
+		moved_ticks[index] = 0u;
+	else if (moved_ticks[index] != tick)
+	{
+		previous_worlds[index] = worlds[index];
+		moved_ticks[index] = tick;
+	}
+
+	for (TransformHandle child = nodes[handle].first_child; child != INVALID_TRANSFORM; child = nodes[child].next_sibling)
+		MarkDirty(child);
+}
+
+bool trTransformSystem::IsDirty(TransformHandle handle) const
+{
+	return dirty[nodes[handle].index] != 0u;
+}
+
+// ---------------------------------------------
+void trTransformSystem::BeginTick(uint64 tick)
+{
+	// Catching up several ticks in a frame: the previous tick must be in worlds before this one saves it
+	UpdateWorldMatrices();
+
+	this->tick = tick;
+	in_tick = true;
+}
+
+void trTransformSystem::EndTick()
+{
+	in_tick = false;
+}
+
+float4x4 trTransformSystem::GetInterpolatedWorldMatrix(TransformHandle handle, float alpha)
+{
+	const float4x4& current = GetWorldMatrix(handle);
+	uint index = nodes[handle].index;
+
+	// Only what moved during the last tick has a previous state to blend from
+	if (moved_ticks[index] == 0u || moved_ticks[index] != tick)
+		return current;
+
+	float3 previous_position, previous_scale, position, scale;
+	Quat previous_rotation, rotation;
+	previous_worlds[index].Decompose(previous_position, previous_rotation, previous_scale);
+	current.Decompose(position, rotation, scale);
+
+	return float4x4::FromTRS(previous_position.Lerp(position, alpha), previous_rotation.Slerp(rotation, alpha), previous_scale.Lerp(scale, alpha));
+}
+
+// ---------------------------------------------
+void trTransformSystem::UpdateWorldMatrices(bool parallel)
+{
+	if (order_dirty || levels_dirty)
+		SortByDepth();
+
+	if (!any_dirty)
+		return;
+
+	// Every level only reads the previous one
+	for (uint level = 0u; level + 1u < level_begin.size(); ++level)
+	{
+		uint begin = level_begin[level];
+		uint end = level_begin[level + 1u];
+
+		if (parallel && App->job_system != nullptr && end - begin >= TRANSFORM_PARALLEL_GRAIN * 2u)
+			App->job_system->ParallelFor(begin, end, TRANSFORM_PARALLEL_GRAIN, [this](uint chunk_begin, uint chunk_end) { SweepRange(chunk_begin, chunk_end); });
+		else
+			SweepRange(begin, end);
+	}
+
+	any_dirty = false;
+}
+
+void trTransformSystem::SweepRange(uint begin, uint end)
+{
+	for (uint i = begin; i < end; ++i)
+	{
+		if (!dirty[i])
+			continue;
+
+		uint parent = parent_indices[i];
+
+		if (parent != INVALID_TRANSFORM)
+			MultiplyMatrices(worlds[parent], locals[i], worlds[i]);
+		else
+			worlds[i] = locals[i];
+
+		dirty[i] = 0u;
+	}
+}
+
+// ---------------------------------------------
+uint trTransformSystem::GetCount() const
+{
+	return positions.size();
+}
+
+uint trTransformSystem::GetLevelCount() const
+{
+	return level_begin.empty() ? 0u : level_begin.size() - 1u;
+}
+
+// ---------------------------------------------
+void trTransformSystem::SortByDepth()
+{
+	uint count = positions.size();
+
+	// Breadth first from the roots gives the new order, level by level
+	std::vector<TransformHandle> order;
+	order.reserve(count);
+
+	for (uint i = 0u; i < count; ++i)
+	{
+		if (nodes[handles[i]].parent == INVALID_TRANSFORM)
+			order.push_back(handles[i]);
+	}
+
+	level_begin.clear();
+	level_begin.push_back(0u);
+
+	uint begin = 0u;
+	while (begin < order.size())
+	{
+		uint end = order.size();
+		for (uint i = begin; i < end; ++i)
+		{
+			for (TransformHandle child = nodes[order[i]].first_child; child != INVALID_TRANSFORM; child = nodes[child].next_sibling)
+				order.push_back(child);
+		}
+
+		level_begin.push_back(end);
+		begin = end;
+	}
+
+	// Already sorted, nothing to move
+	bool sorted = true;
+	for (uint i = 0u; i < count && sorted; ++i)
+		sorted = order[i] == handles[i];
+
+	if (!sorted)
+	{
+		std::vector<float3> new_positions(count);
+		std::vector<Quat> new_rotations(count);
+		std::vector<float3> new_scales(count);
+		std::vector<float4x4> new_locals(count);
+		std::vector<float4x4> new_worlds(count);
+		std::vector<float4x4> new_previous_worlds(count);
+		std::vector<uint64> new_moved_ticks(count);
+		std::vector<uchar> new_dirty(count);
+
+		for (uint i = 0u; i < count; ++i)
+		{
+			uint old_index = nodes[order[i]].index;
+			new_positions[i] = positions[old_index];
+			new_rotations[i] = rotations[old_index];
+			new_scales[i] = scales[old_index];
+			new_locals[i] = locals[old_index];
+			new_worlds[i] = worlds[old_index];
+			new_previous_worlds[i] = previous_worlds[old_index];
+			new_moved_ticks[i] = moved_ticks[old_index];
+			new_dirty[i] = dirty[old_index];
+		}
+
+		positions.swap(new_positions);
+		rotations.swap(new_rotations);
+		scales.swap(new_scales);
+		locals.swap(new_locals);
+		worlds.swap(new_worlds);
+		previous_worlds.swap(new_previous_worlds);
+		moved_ticks.swap(new_moved_ticks);
+		dirty.swap(new_dirty);
+		handles.swap(order);
+
+		for (uint i = 0u; i < count; ++i)
+			nodes[handles[i]].index = i;
+
+		for (uint i = 0u; i < count; ++i)
+		{
+			TransformHandle parent = nodes[handles[i]].parent;
+			parent_indices[i] = parent != INVALID_TRANSFORM ? nodes[parent].index : INVALID_TRANSFORM;
+		}
+	}
+
+	order_dirty = false;
+	levels_dirty = false;
+}
+
+void trTransformSystem::Link(TransformHandle handle, TransformHandle parent)
+{
+	nodes[handle].parent = parent;
+	nodes[handle].prev_sibling = INVALID_TRANSFORM;
+	nodes[handle].next_sibling = INVALID_TRANSFORM;
+
+	if (parent == INVALID_TRANSFORM)
+		return;
+
+	TransformHandle first = nodes[parent].first_child;
+	nodes[handle].next_sibling = first;
+	if (first != INVALID_TRANSFORM)
+		nodes[first].prev_sibling = handle;
+	nodes[parent].first_child = handle;
+}
+
+void trTransformSystem::Unlink(TransformHandle handle)
+{
+	Node& node = nodes[handle];
+
+	if (node.prev_sibling != INVALID_TRANSFORM)
+		nodes[node.prev_sibling].next_sibling = node.next_sibling;
+	else if (node.parent != INVALID_TRANSFORM)
+		nodes[node.parent].first_child = node.next_sibling;
+
+	if (node.next_sibling != INVALID_TRANSFORM)
+		nodes[node.next_sibling].prev_sibling = node.prev_sibling;
+
+	node.parent = node.prev_sibling = node.next_sibling = INVALID_TRANSFORM;
+}
@@ -0,0 +1,108 @@
+#ifndef __trTRANSFORMSYSTEM_H__
+#define __trTRANSFORMSYSTEM_H__
+
+#include "trDefs.h"
+#include "MathGeoLib/MathGeoLib.h"
+
+#include <vector>
+
+#define INVALID_TRANSFORM 0xFFFFFFFF
+#define TRANSFORM_PARALLEL_GRAIN 2048 // levels with less transforms than this are swept on one thread
+
+typedef uint TransformHandle;
+
+// Local TRS and world matrices of every transform in contiguous arrays (SoA).
+// The arrays are sorted by hierarchy depth, so parents always come before their childs
+// and every level is a contiguous range: the world pass is a linear sweep, one level at a time,
+// and a level can be split across threads.
+// Handles stay valid while the arrays are sorted or compacted.
+class trTransformSystem
+{
+private:
+
+	// Per handle, stable
+	struct Node
+	{
+		uint index = INVALID_TRANSFORM; // into the arrays
+		TransformHandle parent = INVALID_TRANSFORM;
+		TransformHandle first_child = INVALID_TRANSFORM;
+		TransformHandle next_sibling = INVALID_TRANSFORM;
+		TransformHandle prev_sibling = INVALID_TRANSFORM;
+	};
+
+public:
+
+	trTransformSystem();
+	~trTransformSystem();
+
+	TransformHandle Create(TransformHandle parent, const float3& position = float3::zero, const Quat& rotation = Quat::identity, const float3& scale = float3::one);
+	void Destroy(TransformHandle handle); // childs become roots
+	void Clear();
+
+	void SetParent(TransformHandle handle, TransformHandle parent);
+	TransformHandle GetParent(TransformHandle handle) const;
+
+	void SetLocal(TransformHandle handle, const float3& position, const Quat& rotation, const float3& scale);
+	const float3& GetPosition(TransformHandle handle) const;
+	const Quat& GetRotation(TransformHandle handle) const;
+	const float3& GetScale(TransformHandle handle) const;
+	const float4x4& GetLocalMatrix(TransformHandle handle) const;
+
+	// O(1) once the frame pass has run, otherwise only the dirty parents are recalculated
+	const float4x4& GetWorldMatrix(TransformHandle handle);
+
+	void MarkDirty(TransformHandle handle);
+	bool IsDirty(TransformHandle handle) const;
+
+	// Fixed timestep interpolation. Transforms dirtied during a tick keep the world matrix they had
+	// when it began, changes outside ticks snap. BeginTick sweeps what is still dirty first.
+	void BeginTick(uint64 tick);
+	void EndTick();
+
+	// World matrix between the one before the last tick and the current one, O(1)
+	float4x4 GetInterpolatedWorldMatrix(TransformHandle handle, float alpha);
+
+	// Sorts the arrays if the hierarchy changed and recalculates every dirty world matrix
+	void UpdateWorldMatrices(bool parallel = true);
+
+	uint GetCount() const;
+	uint GetLevelCount() const;
+
+	// out = a * b with SSE, one row of out per 4-wide multiply-add chain. The sweeps are linear but
+	// the parents are not, so the matrices stay whole instead of being split in lanes across transforms.
+	static void MultiplyMatrices(const float4x4& a, const float4x4& b, float4x4& out);
+
+private:
+
+	void SortByDepth();
+	void SweepRange(uint begin, uint end);
+	void Link(TransformHandle handle, TransformHandle parent);
+	void Unlink(TransformHandle handle);
+
+private:
+
+	std::vector<Node> nodes;
+	std::vector<TransformHandle> free_handles;
+
+	// SoA, sorted by depth
+	std::vector<float3> positions;
+	std::vector<Quat> rotations;
+	std::vector<float3> scales;
+	std::vector<float4x4> locals;
+	std::vector<float4x4> worlds;
+	std::vector<float4x4> previous_worlds; // before the tick in moved_ticks
+	std::vector<uint64> moved_ticks; // 0 if the last change was outside ticks
+	std::vector<uint> parent_indices; // INVALID_TRANSFORM for roots
+	std::vector<uchar> dirty;
+	std::vector<TransformHandle> handles; // index to handle
+
+	std::vector<uint> level_begin; // first index of every level plus the end
+	bool order_dirty = false; // a child may be before its parent
+	bool levels_dirty = false; // the level ranges are outdated
+	bool any_dirty = false;
+
+	uint64 tick = 0u; // last tick begun
+	bool in_tick = false;
+};
+
+#endif // __trTRANSFORMSYSTEM_H__
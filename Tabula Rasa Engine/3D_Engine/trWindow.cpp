@@ -6,6 +6,7 @@
 trWindow::trWindow() : trModule()
 {
 	name = "Window";
+	phases = PHASE_NONE;
 	window = NULL;
 	screen_surface = NULL;
 }
@@ -21,7 +22,10 @@ bool trWindow::Awake(JSON_Object* config)
 	TR_LOG("trWindow: Init SDL window & surface");
 	bool ret = true;
 
-	if (SDL_Init(SDL_INIT_VIDEO) < 0)
+	// Headless keeps SDL for timers and quit events only
+	Uint32 sdl_flags = App->IsHeadless() ? (SDL_INIT_TIMER | SDL_INIT_EVENTS) : SDL_INIT_VIDEO;
+
+	if (SDL_Init(sdl_flags) < 0)
 	{
 		TR_LOG("trWindow: SDL_VIDEO could not initialize! SDL_Error: %s\n", SDL_GetError());
 		ret = false;
@@ -46,6 +50,11 @@ bool trWindow::Awake(JSON_Object* config)
 			this->SetBorderless(W_BORDERLESS);
 			this->SetFullscreenWindowed(W_FULLSCREEN_DESKTOP);
 		}
+
+		if (App->IsHeadless()) {
+			TR_LOG("trWindow: Headless mode, no window created");
+			return ret;
+		}
 		
 		//Create window
 		Uint32 flags = SDL_WINDOW_OPENGL | SDL_WINDOW_SHOWN;